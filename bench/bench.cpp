@@ -0,0 +1,939 @@
+/*
+ * bench.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ *
+ * Micro benchmarks of the hashing and work preparation paths on fixed inputs.
+ * Every case runs in growing batches until it has taken at least --min-time
+ * seconds, so the numbers are comparable between builds and machines. The
+ * getwork cases time new blocks of a mock node on loopback instead, and the
+ * failover case runs stratum clients against mock pools going down. The
+ * SHA-256 code is checked before anything is timed, a wrong hash fails the run.
+ */
+
+#include "common/utilstrencodings.h"
+#include "nrghash/nrghash.h"
+#include "primitives/block.h"
+#include "primitives/merkle.h"
+#include "primitives/sha256.h"
+#include "primitives/solution.h"
+#include "primitives/templatecache.h"
+#include "primitives/transaction.h"
+#include "primitives/work.h"
+#include "protocol/getwork/GetworkClient.h"
+#include "protocol/stratum/StratumClient.h"
+#include "protocol/stratum/StratumParser.h"
+#include "protocol/testing/MockGetworkServer.h"
+#include "protocol/testing/MockStratumServer.h"
+
+#include <json/json.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef BENCH_GBT_FILE
+#define BENCH_GBT_FILE "getblocktemplate.json"
+#endif
+#ifndef BENCH_STRATUM_FILE
+#define BENCH_STRATUM_FILE "stratum.log"
+#endif
+
+using namespace energi;
+
+// Heap allocations through operator new, for the allocs/op column. Scripts
+// allocate with malloc and are not counted.
+static std::atomic<uint64_t> g_allocations(0);
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+namespace {
+
+// Any well formed address, the benchmark only needs its key id
+const char* const c_coinbaseAddress = "EURyS6MZVykjwV9YpfpxqXqZWyx4fV8UHM";
+
+struct Options
+{
+    std::string filter;
+    std::string dagFile;
+    std::string gbtFile = BENCH_GBT_FILE;
+    std::string stratumFile = BENCH_STRATUM_FILE;
+    bool check = false;
+    double minTime = 0.5;
+    uint64_t epoch = 0;
+    unsigned blocks = 20;
+    unsigned recheckMs = 500;
+    unsigned outages = 3;
+};
+
+//! Keeps the compiler from dropping a computation whose result is unused
+template <typename T>
+inline void doNotOptimize(T const& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+class Harness
+{
+public:
+    explicit Harness(const Options& options)
+        : m_options(options)
+    {
+        std::cout << "sha256: " << SHA256AutoDetect() << std::endl;
+        std::cout << std::left << std::setw(36) << "benchmark" << std::right
+                  << std::setw(12) << "iterations" << std::setw(16) << "ns/op"
+                  << std::setw(12) << "allocs/op" << std::setw(14) << "MB/s" << std::endl;
+    }
+
+    bool enabled(const std::string& name) const
+    {
+        return m_options.filter.empty() || name.find(m_options.filter) != std::string::npos;
+    }
+
+    /**
+     * @brief Runs body in batches, doubling the batch until the run took
+     *        --min-time. bytes is the input processed by one call, for a
+     *        throughput column. Returns the nanoseconds per call.
+     */
+    double run(const std::string& name, uint64_t bytes, const std::function<void()>& body)
+    {
+        if (!enabled(name)) {
+            return 0;
+        }
+        using clock = std::chrono::steady_clock;
+        uint64_t iterations = 0;
+        uint64_t batch = 1;
+        double seconds = 0;
+        const uint64_t allocations = g_allocations.load(std::memory_order_relaxed);
+        while (seconds < m_options.minTime) {
+            auto const start = clock::now();
+            for (uint64_t i = 0; i < batch; ++i) {
+                body();
+            }
+            seconds += std::chrono::duration<double>(clock::now() - start).count();
+            iterations += batch;
+            batch *= 2;
+        }
+        const double ns = seconds * 1e9 / iterations;
+        const double allocs = double(g_allocations.load(std::memory_order_relaxed) - allocations) / iterations;
+        std::cout << std::left << std::setw(36) << name << std::right
+                  << std::setw(12) << iterations
+                  << std::setw(16) << std::fixed << std::setprecision(1) << ns
+                  << std::setw(12) << allocs;
+        if (bytes) {
+            std::cout << std::setw(14) << std::setprecision(2) << bytes * 1e3 / ns;
+        }
+        std::cout << std::endl;
+        return ns;
+    }
+
+private:
+    const Options& m_options;
+};
+
+void keccak(Harness& harness)
+{
+    std::vector<uint8_t> input(4096);
+    std::mt19937 rng(1);
+    for (auto& b : input) {
+        b = static_cast<uint8_t>(rng());
+    }
+    // header hash input, truncated header, full header and a large transaction
+    for (size_t size : { 40, 146, 219, 4096 }) {
+        harness.run("keccak256/" + std::to_string(size), size, [&] {
+            nrghash::h256_t hash(input.data(), size);
+            doNotOptimize(hash);
+        });
+    }
+    // dataset item and seed sizes
+    for (size_t size : { 64, 72, 4096 }) {
+        harness.run("keccak512/" + std::to_string(size), size, [&] {
+            nrghash::h512_t hash(input.data(), size);
+            doNotOptimize(hash);
+        });
+    }
+}
+
+void nrghashCases(Harness& harness, const Options& options)
+{
+    const uint64_t block = options.epoch * nrghash::constants::EPOCH_LENGTH;
+    const uint64_t dagSize = nrghash::dag_t::get_full_size(block + 1);
+
+    if (!harness.enabled("mkcache") && !harness.enabled("calc_dataset_item")
+        && !harness.enabled("light::hash") && !harness.enabled("full::hash")) {
+        return;
+    }
+
+    // Every construction below is a full mkcache, the epoch is evicted from nrghash's cache of caches
+    std::unique_ptr<nrghash::cache_t> cache;
+    harness.run("mkcache/epoch" + std::to_string(options.epoch), nrghash::cache_t::get_cache_size(block + 1), [&] {
+        cache.reset(new nrghash::cache_t(block));
+        cache->unload();
+    });
+    if (!cache) {
+        cache.reset(new nrghash::cache_t(block));
+    }
+
+    uint32_t index = 0;
+    const uint32_t items = static_cast<uint32_t>(dagSize / nrghash::constants::HASH_BYTES);
+    const double ns = harness.run("calc_dataset_item", nrghash::constants::HASH_BYTES, [&] {
+        auto item = nrghash::light::calc_dataset_item(*cache, index);
+        doNotOptimize(item);
+        index = (index + 1) % items;
+    });
+    if (ns > 0) {
+        std::cout << "  DAG of epoch " << options.epoch << " (" << dagSize / (1024 * 1024)
+                  << " MB) takes " << std::setprecision(1) << ns * items / 1e9 << " s per generating thread" << std::endl;
+    }
+
+    nrghash::h256_t header("energiminer bench", 17);
+    uint64_t nonce = 0;
+    harness.run("light::hash", 0, [&] {
+        auto result = nrghash::light::hash(*cache, header, nonce++);
+        doNotOptimize(result);
+    });
+
+    if (!harness.enabled("full::hash")) {
+        return;
+    }
+    if (options.dagFile.empty()) {
+        std::cout << "  full::hash skipped, pass --dag <file> with a DAG of the epoch" << std::endl;
+        return;
+    }
+    try {
+        nrghash::dag_t dag(options.dagFile);
+        nonce = 0;
+        harness.run("full::hash", 0, [&] {
+            auto result = nrghash::full::hash(dag, header, nonce++);
+            doNotOptimize(result);
+        });
+        dag.unload();
+    } catch (nrghash::hash_exception const& e) {
+        std::cout << "  full::hash skipped, " << options.dagFile << ": " << e.what() << std::endl;
+    }
+}
+
+/**
+ * @brief Checks the selected SHA-256 code, whichever SHA256AutoDetect()
+ *        settled on, against the FIPS 180-2 test vectors, and SHA256D64
+ *        against two CSHA256 passes for batch sizes around the 8-way width,
+ *        in place as the merkle code calls it. Returns false on a mismatch.
+ */
+bool sha256(Harness& harness)
+{
+    if (!harness.enabled("sha256")) {
+        return true;
+    }
+    struct Vector
+    {
+        std::string message;
+        size_t repeat;
+        const char* digest;
+    };
+    const Vector vectors[] = {
+        { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { std::string(1000, 'a'), 1000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    };
+    unsigned failures = 0;
+    for (const auto& vector : vectors) {
+        CSHA256 hasher;
+        for (size_t i = 0; i < vector.repeat; ++i) {
+            hasher.Write(reinterpret_cast<const unsigned char*>(vector.message.data()), vector.message.size());
+        }
+        std::vector<unsigned char> digest(CSHA256::OUTPUT_SIZE);
+        hasher.Finalize(digest.data());
+        if (HexStr(digest) != vector.digest) {
+            std::cout << "  sha256 of " << vector.message.size() * vector.repeat << " bytes is " << HexStr(digest)
+                      << ", not " << vector.digest << std::endl;
+            ++failures;
+        }
+    }
+
+    std::mt19937 rng(43);
+    for (size_t blocks = 1; blocks <= 17; ++blocks) {
+        std::vector<unsigned char> data(64 * blocks);
+        for (auto& byte : data) {
+            byte = static_cast<unsigned char>(rng());
+        }
+        std::vector<unsigned char> expected(32 * blocks);
+        for (size_t i = 0; i < blocks; ++i) {
+            unsigned char once[CSHA256::OUTPUT_SIZE];
+            CSHA256().Write(data.data() + 64 * i, 64).Finalize(once);
+            CSHA256().Write(once, sizeof(once)).Finalize(expected.data() + 32 * i);
+        }
+        SHA256D64(data.data(), data.data(), blocks);
+        if (!std::equal(expected.begin(), expected.end(), data.begin())) {
+            std::cout << "  SHA256D64 of " << blocks << " inputs differs from CSHA256" << std::endl;
+            ++failures;
+        }
+    }
+    std::cout << "  sha256: " << (failures ? std::to_string(failures) + " mismatches" : std::string("no mismatches"))
+              << " against the test vectors and 17 SHA256D64 batches" << std::endl;
+    return !failures;
+}
+
+void merkle(Harness& harness)
+{
+    Block block;
+    block.vtx.reserve(1000);
+    for (uint32_t i = 0; i < 1000; ++i) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(ArithToUint256(arith_uint256(i + 1)), i % 4);
+        tx.vout.resize(2);
+        tx.vout[0].nValue = 1000 + i;
+        tx.vout[1].nValue = 2000 + i;
+        block.vtx.push_back(MakeTransactionRef(std::move(tx)));
+    }
+    std::vector<uint8_t> pairs(64 * 1000);
+    harness.run("SHA256D64/1000", pairs.size(), [&] {
+        SHA256D64(pairs.data(), pairs.data(), 1000);
+        doNotOptimize(pairs);
+    });
+    harness.run("BlockMerkleRoot/1000", 0, [&] {
+        auto root = BlockMerkleRoot(block);
+        doNotOptimize(root);
+    });
+}
+
+void hex(Harness& harness)
+{
+    // a large transaction of a template, and the hashes printed into every header
+    std::vector<unsigned char> bytes(4096);
+    std::mt19937 rng(3);
+    for (auto& b : bytes) {
+        b = static_cast<unsigned char>(rng());
+    }
+    std::string digits(2 * bytes.size(), '0');
+    harness.run("HexEncode/4096", bytes.size(), [&] {
+        HexEncode(bytes.data(), bytes.size(), &digits[0]);
+        doNotOptimize(digits);
+    });
+    harness.run("HexDecode/4096", bytes.size(), [&] {
+        size_t decoded = HexDecode(digits.data(), digits.size(), bytes.data());
+        doNotOptimize(decoded);
+    });
+    harness.run("ParseHex/4096", bytes.size(), [&] {
+        auto parsed = ParseHex(digits);
+        doNotOptimize(parsed);
+    });
+
+    uint256 value;
+    memcpy(value.begin(), bytes.data(), value.size());
+    const std::string valueHex = value.GetHex();
+    harness.run("uint256::GetHex", value.size(), [&] {
+        auto str = value.GetHex();
+        doNotOptimize(str);
+    });
+    harness.run("uint256::SetHex", value.size(), [&] {
+        value.SetHex(valueHex);
+        doNotOptimize(value);
+    });
+}
+
+void work(Harness& harness, const Options& options)
+{
+    std::ifstream file(options.gbtFile);
+    Json::Value gbt;
+    Json::Reader reader;
+    if (!file || !reader.parse(file, gbt)) {
+        std::cout << "  Work cases skipped, cannot read " << options.gbtFile << std::endl;
+        return;
+    }
+    harness.run("Work/getblocktemplate", 0, [&] {
+        Work work(gbt, c_coinbaseAddress);
+        doNotOptimize(work);
+    });
+
+    // A poll repeating the previous template, and one whose transactions were all seen before
+    harness.run("TemplateCache/fingerprint", 0, [&] {
+        auto fingerprint = TemplateCache::fingerprint(gbt);
+        doNotOptimize(fingerprint);
+    });
+    TemplateCache cache;
+    harness.run("Work/getblocktemplate/cached", 0, [&] {
+        Work work(gbt, c_coinbaseAddress, &cache);
+        cache.sweep();
+        doNotOptimize(work);
+    });
+
+    Work work(gbt, c_coinbaseAddress);
+    // What handing a template to every miner and to a solution costs
+    harness.run("Work/copy", 0, [&] {
+        Work copy(work);
+        doNotOptimize(copy);
+    });
+    harness.run("Work/incrementExtraNonce", 0, [&] {
+        work.incrementExtraNonce();
+        doNotOptimize(work);
+    });
+    // Per nonce share check of the CPU miner and the verifier, at a pool difficulty target
+    std::vector<uint256> hashes(1024);
+    std::mt19937 rng(2);
+    for (auto& hash : hashes) {
+        for (auto it = hash.begin(); it != hash.end(); ++it) {
+            *it = static_cast<uint8_t>(rng());
+        }
+    }
+    work.setTarget(~arith_uint256(0) / arith_uint256(1000000));
+    size_t next = 0;
+    harness.run("target/UintToArith256", 0, [&] {
+        bool meets = UintToArith256(hashes[next++ & 1023]) <= work.hashTarget;
+        doNotOptimize(meets);
+    });
+    harness.run("target/meetsTarget", 0, [&] {
+        bool meets = work.meetsTarget(hashes[next++ & 1023]);
+        doNotOptimize(meets);
+    });
+    harness.run("CBlockHeaderTruncatedLE", sizeof(CBlockHeaderTruncatedLE), [&] {
+        CBlockHeaderTruncatedLE header(work);
+        doNotOptimize(header);
+    });
+    // Submit of a found block, the template's transactions are encoded by the first run only
+    Solution solution(work, 0);
+    harness.run("Solution/getSubmitBlockData", 0, [&] {
+        std::string data = solution.getSubmitBlockData();
+        doNotOptimize(data);
+    });
+    harness.run("Work/getBlockTransaction", 0, [&] {
+        std::string data = work.getBlockTransaction();
+        doNotOptimize(data);
+    });
+}
+
+/**
+ * @brief Times the getwork client from a new block on a local mock node to
+ *        its m_onWorkReceived, once with the longpoll held open and once
+ *        with the poll every --recheck ms it falls back to. The mock node
+ *        serves the template fixture with a new tip for every block.
+ */
+void getwork(Harness& harness, const Options& options)
+{
+    using namespace std::chrono;
+    std::ifstream file(options.gbtFile);
+    Json::Value gbt;
+    Json::Reader reader;
+    if (!file || !reader.parse(file, gbt)) {
+        gbt = Json::Value();
+    }
+    std::mt19937 rng(5);
+    for (bool longpoll : { true, false }) {
+        const std::string name = longpoll ? "getwork/longpoll" : "getwork/poll";
+        if (!harness.enabled(name)) {
+            continue;
+        }
+        boost::asio::io_service io_service;
+        std::unique_ptr<boost::asio::io_service::work> busy(new boost::asio::io_service::work(io_service));
+        std::thread io([&io_service] { io_service.run(); });
+
+        MockGetworkServer::Options nodeOptions;
+        nodeOptions.longpoll = longpoll;
+        MockGetworkServer node(io_service, nodeOptions, gbt);
+        std::vector<double> latencies;
+        double shutdownMs = 0;
+        // The client notes every template, only the summary is wanted here
+        const int verbosity = g_logVerbosity;
+        g_logVerbosity = 0;
+        if (node.start()) {
+            std::mutex x_work;
+            std::condition_variable workReceived;
+            uint32_t height = 0;
+            steady_clock::time_point received;
+            URI uri("http://bench:x@127.0.0.1:" + std::to_string(node.port()));
+            std::unique_ptr<GetworkClient> client(new GetworkClient(options.recheckMs, c_coinbaseAddress));
+            client->setConnection(uri);
+            client->onWorkReceived([&](const Work& work) {
+                std::lock_guard<std::mutex> lock(x_work);
+                height = work.nHeight;
+                received = steady_clock::now();
+                workReceived.notify_all();
+            });
+            client->connect();
+
+            std::unique_lock<std::mutex> lock(x_work);
+            workReceived.wait_for(lock, seconds(5), [&] { return height != 0; });
+            // New blocks land at any point of the poll period, and after the longpoll is back in place
+            std::uniform_int_distribution<unsigned> pause(options.recheckMs, 2 * options.recheckMs);
+            for (unsigned i = 0; height && i < options.blocks; ++i) {
+                lock.unlock();
+                std::this_thread::sleep_for(milliseconds(pause(rng)));
+                lock.lock();
+                const uint32_t expected = height + 1;
+                const auto announced = steady_clock::now();
+                node.newBlock();
+                if (!workReceived.wait_for(lock, seconds(5), [&] { return height >= expected; })) {
+                    break;
+                }
+                latencies.push_back(duration<double, std::milli>(received - announced).count());
+            }
+            lock.unlock();
+            // With the longpoll still held by the node
+            const auto closing = steady_clock::now();
+            client->disconnect();
+            client.reset();
+            shutdownMs = duration<double, std::milli>(steady_clock::now() - closing).count();
+            node.stop();
+        }
+        g_logVerbosity = verbosity;
+        busy.reset();
+        io.join();
+
+        if (latencies.size() < options.blocks) {
+            std::cout << "  " << name << " got work for " << latencies.size() << " of " << options.blocks
+                      << " blocks from the mock node" << std::endl;
+            continue;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        double mean = 0;
+        for (double ms : latencies) {
+            mean += ms / latencies.size();
+        }
+        std::cout << std::left << std::setw(36) << name << std::right << std::setw(12) << latencies.size()
+                  << std::fixed << std::setprecision(2) << "  new block to work ms: min " << latencies.front()
+                  << ", median " << latencies[latencies.size() / 2] << ", mean " << mean
+                  << ", max " << latencies.back() << ", shut down in " << shutdownMs << " ms" << std::endl;
+    }
+}
+
+/**
+ * @brief Keeps a standby stratum client next to the primary one, the way the
+ *        pool manager keeps its failover pools, while the primary's mock
+ *        pool goes down every other second. Times how long the primary's
+ *        client takes to see each outage and to get a job again once the
+ *        pool is back, and counts the outages the standby had a job to
+ *        switch to.
+ */
+void failover(Harness& harness, const Options& options)
+{
+    using namespace std::chrono;
+    const std::string name = "failover/stratum";
+    if (!harness.enabled(name)) {
+        return;
+    }
+    boost::asio::io_service io_service;
+    boost::asio::io_service::work busy(io_service);
+    std::thread io([&io_service] { io_service.run(); });
+
+    std::mutex x_state;
+    std::condition_variable changed;
+    steady_clock::time_point down;      // of the latest outage
+    steady_clock::time_point lost;      // the primary's client saw it
+    steady_clock::time_point working;   // latest job of the primary
+    bool primaryWork = false;
+    bool standbyWork = false;
+    bool standbyAtLoss = false;         // the standby had a job when the primary was lost
+    unsigned standbyReady = 0;
+
+    MockStratumServer::Options primaryOptions;
+    primaryOptions.latencyMs = 5;
+    primaryOptions.outageSeconds = 1;
+    MockStratumServer::Options standbyOptions;
+    standbyOptions.latencyMs = 50;
+    MockStratumServer primaryPool(io_service, primaryOptions);
+    MockStratumServer standbyPool(io_service, standbyOptions);
+    primaryPool.onOutage([&](bool up) {
+        if (!up) {
+            std::lock_guard<std::mutex> lock(x_state);
+            down = steady_clock::now();
+        }
+    });
+
+    std::vector<double> detected;
+    std::vector<double> recovered;
+    const int verbosity = g_logVerbosity;
+    g_logVerbosity = 0;
+    if (primaryPool.start() && standbyPool.start()) {
+        URI primaryUri("stratum://bench.rig@127.0.0.1:" + std::to_string(primaryPool.port()));
+        URI standbyUri("stratum://bench.rig@127.0.0.1:" + std::to_string(standbyPool.port()));
+        StratumClient primary(io_service, 180, 3, false);
+        StratumClient standby(io_service, 180, 3, false);
+        primary.setConnection(primaryUri);
+        standby.setConnection(standbyUri);
+        primary.onWorkReceived([&](const Work&) {
+            std::lock_guard<std::mutex> lock(x_state);
+            primaryWork = true;
+            working = steady_clock::now();
+            changed.notify_all();
+        });
+        primary.onDisconnected([&]() {
+            std::lock_guard<std::mutex> lock(x_state);
+            if (primaryWork) {
+                primaryWork = false;
+                lost = steady_clock::now();
+                standbyAtLoss = standbyWork;
+                changed.notify_all();
+            }
+        });
+        standby.onWorkReceived([&](const Work&) {
+            std::lock_guard<std::mutex> lock(x_state);
+            standbyWork = true;
+        });
+        standby.onDisconnected([&]() {
+            std::lock_guard<std::mutex> lock(x_state);
+            standbyWork = false;
+        });
+        standby.connect();
+        primary.connect();
+
+        const auto patience = seconds(4 * primaryOptions.outageSeconds);
+        std::unique_lock<std::mutex> lock(x_state);
+        for (unsigned i = 0; i < options.outages; ++i) {
+            if (!changed.wait_for(lock, patience, [&] { return primaryWork; })
+                || !changed.wait_for(lock, patience, [&] { return !primaryWork; })) {
+                break;
+            }
+            detected.push_back(duration<double, std::milli>(lost - down).count());
+            standbyReady += standbyAtLoss ? 1 : 0;
+            // Reconnect the way the pool manager retries a lost primary
+            const auto deadline = steady_clock::now() + patience;
+            while (!primaryWork && steady_clock::now() < deadline) {
+                lock.unlock();
+                if (!primary.isConnected() && !primary.isPendingState()) {
+                    primary.connect();
+                }
+                std::this_thread::sleep_for(milliseconds(100));
+                lock.lock();
+            }
+            if (!primaryWork) {
+                break;
+            }
+            recovered.push_back(duration<double, std::milli>(working - lost).count());
+        }
+        lock.unlock();
+        primary.disconnect();
+        standby.disconnect();
+        primaryPool.stop();
+        standbyPool.stop();
+        std::this_thread::sleep_for(milliseconds(100));
+        // Before the clients go, their timers never run out
+        io_service.stop();
+        io.join();
+    }
+    if (io.joinable()) {
+        io_service.stop();
+        io.join();
+    }
+    g_logVerbosity = verbosity;
+
+    if (recovered.size() < options.outages) {
+        std::cout << "  " << name << " got through " << recovered.size() << " of " << options.outages
+                  << " outages of the mock pool" << std::endl;
+        return;
+    }
+    std::sort(detected.begin(), detected.end());
+    std::sort(recovered.begin(), recovered.end());
+    std::cout << std::left << std::setw(36) << name << std::right << std::setw(12) << detected.size()
+              << std::fixed << std::setprecision(2) << "  outage to disconnect ms: min " << detected.front()
+              << ", median " << detected[detected.size() / 2] << ", max " << detected.back()
+              << ", back at work in median " << recovered[recovered.size() / 2] << " ms, standby had a job for "
+              << standbyReady << " of " << detected.size() << std::endl;
+}
+
+//! What the generic Json::Reader path of the stratum client makes of a line, in the parser's terms
+bool referenceParse(const std::string& line, StratumMessage& message)
+{
+    message = StratumMessage();
+    Json::Value json;
+    Json::Reader reader;
+    if (!reader.parse(line, json, false) || !json.isObject()) {
+        return false;
+    }
+    try {
+        const Json::Value& id = json.get("id", Json::Value::null);
+        message.id = id.isNull() ? 0 : id.asUInt();
+        const std::string method = json.get("method", "").asString();
+        const Json::Value& params = json.get("params", Json::Value::null);
+        if (method == "mining.notify") {
+            message.job = StratumJob::fromJson(params);
+            message.kind = StratumMessage::Kind::Notify;
+        } else if (method == "mining.set_difficulty") {
+            message.difficulty = params.get((Json::Value::ArrayIndex)0, 0).asDouble();
+            message.kind = StratumMessage::Kind::SetDifficulty;
+        } else if (method.empty() && message.id == 4 && json.get("error", Json::Value::null).isNull()) {
+            const Json::Value& result = json.get("result", Json::Value::null);
+            message.result = result.isBool() ? result.asBool() : true;
+            message.kind = StratumMessage::Kind::SubmitResponse;
+        }
+    } catch (std::exception const&) {
+        // e.g. a notify whose hex fields do not convert
+        return false;
+    }
+    return true;
+}
+
+//! True if the fields the stratum client reads agree
+bool sameFields(const StratumMessage& fast, const StratumMessage& reference)
+{
+    if (fast.kind != reference.kind) {
+        return false;
+    }
+    switch (fast.kind) {
+    case StratumMessage::Kind::Notify: {
+        const StratumJob& a = fast.job;
+        const StratumJob& b = reference.job;
+        return a.jobName == b.jobName && a.prevHash == b.prevHash && a.coinbase1 == b.coinbase1
+               && a.coinbase2 == b.coinbase2 && a.transactions == b.transactions && a.version == b.version
+               && a.bits == b.bits && a.time == b.time && a.height == b.height && a.clean == b.clean;
+    }
+    case StratumMessage::Kind::SetDifficulty:
+        return fast.difficulty == reference.difficulty;
+    case StratumMessage::Kind::SubmitResponse:
+        return fast.id == reference.id && fast.result == reference.result;
+    default:
+        return true;
+    }
+}
+
+/**
+ * @brief Every line the parser takes must come out as the Json::Reader path
+ *        reads it, and every clean line the Json path would hand to a job,
+ *        difficulty or share handler must take the parser. Counts the lines
+ *        the parser took in taken, returns the number of disagreements.
+ */
+unsigned checkLine(const char* begin, const char* end, bool clean, uint64_t& taken)
+{
+    StratumMessage fast;
+    const bool parsed = StratumParser::parse(begin, end, fast);
+    taken += parsed;
+    const std::string line(begin, end);
+    StratumMessage reference;
+    const bool referenceParsed = referenceParse(line, reference);
+    if (parsed && (!referenceParsed || !sameFields(fast, reference))) {
+        std::cout << "  stratum parser disagrees with Json::Reader on: " << line.substr(0, 160) << std::endl;
+        return 1;
+    }
+    if (clean && !parsed && reference.kind != StratumMessage::Kind::Other) {
+        std::cout << "  stratum parser misses a line Json::Reader reads: " << line.substr(0, 160) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Truncates every line at every length and flips random bytes of it
+ *        to JSON punctuation, digits and hex, none of which may make the
+ *        parser read past the line or disagree with Json::Reader. Meant to
+ *        run in a build with -DBENCH_SANITIZE=ON.
+ */
+unsigned corrupt(const std::vector<std::string>& lines)
+{
+    static const char alphabet[] = "{}[],:\"\\ .-+eE0123456789abcdeftrunl\r\n";
+    std::mt19937 rng(4);
+    unsigned mismatches = 0;
+    uint64_t variants = 0;
+    uint64_t taken = 0;
+    for (const auto& line : lines) {
+        // a copy of exactly the prefix, so a read past its end is caught
+        const size_t step = std::max<size_t>(1, line.size() / 512);
+        for (size_t size = 0; size < line.size(); size += step) {
+            std::unique_ptr<char[]> prefix(new char[size ? size : 1]);
+            std::memcpy(prefix.get(), line.data(), size);
+            mismatches += checkLine(prefix.get(), prefix.get() + size, false, taken);
+            ++variants;
+        }
+        for (unsigned i = 0; i < 64; ++i) {
+            std::string mutated = line;
+            const unsigned flips = 1 + rng() % 4;
+            for (unsigned f = 0; f < flips; ++f) {
+                mutated[rng() % mutated.size()] = alphabet[rng() % (sizeof(alphabet) - 1)];
+            }
+            mismatches += checkLine(mutated.data(), mutated.data() + mutated.size(), false, taken);
+            ++variants;
+        }
+    }
+    std::cout << "  " << variants << " truncated or corrupted lines, " << taken << " taken by the parser, "
+              << mismatches << " disagreements" << std::endl;
+    return mismatches;
+}
+
+//! Replays the lines a pool sent in a recorded session, returns false if the two parsers disagree
+bool stratum(Harness& harness, const Options& options)
+{
+    std::ifstream file(options.stratumFile);
+    if (!file) {
+        std::cout << "  Stratum cases skipped, cannot read " << options.stratumFile << std::endl;
+        return true;
+    }
+    // <microseconds since the previous line> <'<' from the pool | '>' to the pool> <json>
+    std::vector<std::string> lines;
+    std::string record;
+    while (std::getline(file, record)) {
+        const size_t direction = record.find(' ');
+        if (record.empty() || record[0] == '#' || direction == std::string::npos
+            || record.compare(direction, 3, " < ") != 0) {
+            continue;
+        }
+        lines.push_back(record.substr(direction + 3));
+    }
+
+    // The recorded pool sends jobs without transactions, add one carrying the template's
+    std::ifstream gbtFile(options.gbtFile);
+    Json::Value gbt;
+    Json::Reader reader;
+    std::string notify;
+    if (gbtFile && reader.parse(gbtFile, gbt)) {
+        Json::Value params(Json::arrayValue);
+        params.append("0000341700000002");
+        params.append(gbt["previousblockhash"]);
+        params.append("01000000010000000000000000000000000000000000000000000000000000000000000000ffffffff0c03");
+        params.append("ffffffff0100000000000000001976a914000000000000000000000000000000000000000088ac00000000");
+        params.append(gbt["transactions"]);
+        params.append("20000000");
+        params.append(gbt["bits"]);
+        params.append("5f1e3c2d");
+        params.append(true);
+        params.append(gbt["height"]);
+        Json::Value message;
+        message["id"] = Json::Value::null;
+        message["method"] = "mining.notify";
+        message["params"] = params;
+        Json::FastWriter writer;
+        notify = writer.write(message);
+        notify.pop_back();
+        lines.push_back(notify);
+    }
+
+    unsigned mismatches = 0;
+    uint64_t taken = 0;
+    uint64_t bytes = 0;
+    for (const auto& line : lines) {
+        mismatches += checkLine(line.data(), line.data() + line.size(), true, taken);
+        bytes += line.size() + 1;
+    }
+    std::cout << "  " << options.stratumFile << ": " << lines.size() << " lines from the pool, " << taken
+              << " taken by the parser, " << mismatches << " disagreements" << std::endl;
+    if (options.check) {
+        mismatches += corrupt(lines);
+    }
+
+    // The whole session as it arrives in the receive buffer
+    boost::asio::streambuf received;
+    std::ostream out(&received);
+    for (const auto& line : lines) {
+        out << line << '\n';
+    }
+    StratumMessage message;
+    harness.run("StratumLineFramer+parse/session", bytes, [&] {
+        StratumLineFramer framer(received);
+        const char *begin, *end;
+        while (framer.next(begin, end)) {
+            bool parsed = StratumParser::parse(begin, end, message);
+            doNotOptimize(parsed);
+        }
+    });
+    harness.run("Json::Reader/session", bytes, [&] {
+        for (const auto& line : lines) {
+            bool parsed = referenceParse(line, message);
+            doNotOptimize(parsed);
+        }
+    });
+    if (!notify.empty()) {
+        harness.run("StratumParser/notify", notify.size(), [&] {
+            bool parsed = StratumParser::parse(notify.data(), notify.data() + notify.size(), message);
+            doNotOptimize(parsed);
+        });
+        harness.run("Json::Reader/notify", notify.size(), [&] {
+            bool parsed = referenceParse(notify, message);
+            doNotOptimize(parsed);
+        });
+    }
+    return mismatches == 0;
+}
+
+void usage(const char* name)
+{
+    std::cout << "Usage: " << name << " [options]" << std::endl
+              << "    --filter <text>    Only run the benchmarks whose name contains text" << std::endl
+              << "    --min-time <s>     Minimum run time of every benchmark. Default 0.5" << std::endl
+              << "    --epoch <n>        Epoch of the nrghash benchmarks. Default 0" << std::endl
+              << "    --dag <file>       DAG file of the epoch, enables full::hash" << std::endl
+              << "    --gbt <file>       getblocktemplate result used for the Work benchmarks" << std::endl
+              << "    --blocks <n>       Blocks the mock node announces to the getwork client. Default 20" << std::endl
+              << "    --recheck <ms>     Poll period of the getwork client. Default 500" << std::endl
+              << "    --outages <n>      Outages of the mock pool in the failover benchmark. Default 3" << std::endl
+              << "    --stratum <file>   Recorded stratum session replayed through the parsers" << std::endl
+              << "    --check            Also feed the stratum parser truncated and corrupted lines," << std::endl
+              << "                       exits with 1 if it disagrees with Json::Reader" << std::endl;
+}
+
+} //! anonymous namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) {
+            options.filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            options.minTime = std::atof(argv[++i]);
+        } else if (arg == "--epoch" && hasValue) {
+            options.epoch = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--dag" && hasValue) {
+            options.dagFile = argv[++i];
+        } else if (arg == "--gbt" && hasValue) {
+            options.gbtFile = argv[++i];
+        } else if (arg == "--blocks" && hasValue) {
+            options.blocks = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--recheck" && hasValue) {
+            options.recheckMs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--outages" && hasValue) {
+            options.outages = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--stratum" && hasValue) {
+            options.stratumFile = argv[++i];
+        } else if (arg == "--check") {
+            options.check = true;
+        } else {
+            usage(argv[0]);
+            return arg == "-h" || arg == "--help" ? 0 : 1;
+        }
+    }
+
+    Harness harness(options);
+    const bool hashesRight = sha256(harness);
+    keccak(harness);
+    nrghashCases(harness, options);
+    merkle(harness);
+    hex(harness);
+    work(harness, options);
+    getwork(harness, options);
+    failover(harness, options);
+    return stratum(harness, options) && hashesRight ? 0 : 1;
+}
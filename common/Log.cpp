@@ -22,8 +22,13 @@
 #include "Log.h"
 #include "common.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <mutex>
 
 #include <thread>
@@ -55,24 +60,328 @@ const char* NoteChannel::name()
     return EthBlue " i";
 }
 
+namespace {
+
+/// Entries up to this size are formatted and queued without touching the heap
+const size_t c_logRecordText = 248;
+/// Entries the log thread may fall behind by before new ones are dropped
+const size_t c_logRecords = 2048;
+
+/// Formats into a fixed buffer, moving to a string only for long entries
+class LogLineBuf : public std::streambuf
+{
+public:
+    LogLineBuf() { reset(); }
+
+    void reset()
+    {
+        setp(m_fixed, m_fixed + sizeof(m_fixed));
+        m_spilled = false;
+        m_spill.clear();
+    }
+
+    const char* data() const { return m_spilled ? m_spill.data() : m_fixed; }
+    size_t size() const { return m_spilled ? m_spill.size() : pptr() - m_fixed; }
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        spill();
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+            m_spill.push_back(traits_type::to_char_type(c));
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        if (!m_spilled && epptr() - pptr() >= n) {
+            std::memcpy(pptr(), s, n);
+            pbump(static_cast<int>(n));
+            return n;
+        }
+        spill();
+        m_spill.append(s, n);
+        return n;
+    }
+
+private:
+    void spill()
+    {
+        if (m_spilled)
+            return;
+        m_spill.assign(m_fixed, pptr() - m_fixed);
+        setp(nullptr, nullptr);
+        m_spilled = true;
+    }
+
+    char m_fixed[c_logRecordText];
+    bool m_spilled = false;
+    std::string m_spill;
+};
+
+/// Per thread name and second of the last entry, so formatting an entry makes no system calls
+struct LogThreadCache
+{
+    char name[16] = { 0 };
+    bool named = false;
+    time_t second = -1;
+    char time[24] = { 0 };
+};
+
+thread_local LogThreadCache t_logCache;
+
+const char* cachedThreadName()
+{
+    if (!t_logCache.named) {
+        std::string name = getThreadName();
+        std::strncpy(t_logCache.name, name.c_str(), sizeof(t_logCache.name) - 1);
+        t_logCache.named = true;
+    }
+    return t_logCache.name;
+}
+
+const char* cachedTime()
+{
+    time_t rawTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    if (rawTime != t_logCache.second) {
+        struct tm local;
+#ifdef _WIN32
+        localtime_s(&local, &rawTime);
+#else
+        localtime_r(&rawTime, &local);
+#endif
+        if (strftime(t_logCache.time, sizeof(t_logCache.time), "%X", &local) == 0)
+            t_logCache.time[0] = '\0';  // empty if case strftime fails
+        t_logCache.second = rawTime;
+    }
+    return t_logCache.time;
+}
+
+/// One formatted entry in the queue, entries too long for text are carried in spill
+struct LogRecord
+{
+    std::atomic<size_t> sequence;
+    uint32_t size;
+    std::string* spill;
+    char text[c_logRecordText];
+};
+
+/**
+ * Bounded queue of formatted entries from any thread to the log thread, see
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ * Writers never wait, an entry that does not fit is counted and dropped.
+ */
+class LogSink
+{
+public:
+    static LogSink& instance()
+    {
+        // Never destroyed, entries may still be logged while statics go away
+        static LogSink* sink = new LogSink();
+        return *sink;
+    }
+
+    void post(const char* data, size_t size)
+    {
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        LogRecord* record;
+        for (;;) {
+            record = &m_records[pos % c_logRecords];
+            size_t sequence = record->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+        if (size <= sizeof(record->text)) {
+            std::memcpy(record->text, data, size);
+            record->spill = nullptr;
+        } else {
+            record->spill = new std::string(data, size);
+        }
+        record->size = static_cast<uint32_t>(size);
+        record->sequence.store(pos + 1, std::memory_order_release);
+
+        if (m_idle.load(std::memory_order_relaxed) && m_idle.exchange(false))
+            m_wake.notify_one();
+    }
+
+    void drain()
+    {
+        std::lock_guard<std::mutex> lock(x_drain);
+        m_batch.clear();
+        for (;;) {
+            LogRecord& record = m_records[m_dequeue % c_logRecords];
+            if (record.sequence.load(std::memory_order_acquire) != m_dequeue + 1)
+                break;
+            if (record.spill) {
+                append(record.spill->data(), record.size);
+                delete record.spill;
+            } else {
+                append(record.text, record.size);
+            }
+            record.sequence.store(m_dequeue + c_logRecords, std::memory_order_release);
+            ++m_dequeue;
+        }
+        uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (dropped != m_reportedDropped) {
+            std::stringstream ss;
+            ss << WarnChannel::name() << " " EthReset << dropped - m_reportedDropped
+               << " log entries dropped, the log thread fell behind";
+            std::string note = ss.str();
+            append(note.data(), note.size());
+            m_reportedDropped = dropped;
+        }
+        if (!m_batch.empty()) {
+            try {
+                std::cerr.write(m_batch.data(), m_batch.size());
+                std::cerr.flush();
+            } catch (...) {
+            }
+        }
+    }
+
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    LogSink() : m_records(new LogRecord[c_logRecords])
+    {
+        for (size_t i = 0; i < c_logRecords; ++i)
+            m_records[i].sequence.store(i, std::memory_order_relaxed);
+        std::atexit([] { LogSink::instance().drain(); });
+        std::thread(&LogSink::run, this).detach();
+    }
+
+    void run()
+    {
+        setThreadName("log");
+        for (;;) {
+            drain();
+            std::unique_lock<std::mutex> lock(x_wake);
+            m_idle.store(true);
+            // A wakeup lost between the drain and here costs at most one timeout
+            m_wake.wait_for(lock, std::chrono::milliseconds(50));
+            m_idle.store(false);
+        }
+    }
+
+    void append(const char* data, size_t size)
+    {
+        if (!g_logNoColor) {
+            m_batch.append(data, size);
+        } else {
+            bool skip = false;
+            for (size_t i = 0; i < size; ++i) {
+                char c = data[i];
+                if (!skip && c == '\x1b')
+                    skip = true;
+                else if (skip && c == 'm')
+                    skip = false;
+                else if (!skip)
+                    m_batch.push_back(c);
+            }
+        }
+        m_batch.push_back('\n');
+    }
+
+    std::unique_ptr<LogRecord[]> m_records;
+    std::atomic<size_t> m_enqueue = { 0 };
+    std::atomic<uint64_t> m_dropped = { 0 };
+
+    std::mutex x_drain;            ///< the log thread and flushLog() take turns draining
+    size_t m_dequeue = 0;
+    uint64_t m_reportedDropped = 0;
+    std::string m_batch;
+
+    std::mutex x_wake;
+    std::condition_variable m_wake;
+    std::atomic<bool> m_idle = { false };
+};
+
+}  // namespace
+
+/// The formatting buffer of a thread, entries logged while formatting another get their own
+struct energi::LogLine
+{
+    LogLine()
+        : os(&buf)
+    {
+        static std::locale logLocl = std::locale("");
+        os.imbue(logLocl);
+        flags = os.flags();
+    }
+
+    void reset()
+    {
+        buf.reset();
+        os.clear();
+        os.flags(flags);
+        os.precision(6);
+        os.width(0);
+        os.fill(' ');
+    }
+
+    LogLineBuf buf;
+    std::ostream os;
+    std::ios_base::fmtflags flags;
+    bool busy = false;
+};
+
+thread_local LogLine t_logLine;
+
 LogOutputStreamBase::LogOutputStreamBase(char const* _id, unsigned _v) : m_verbosity(_v)
 {
-    static std::locale logLocl = std::locale("");
     if ((int)_v <= g_logVerbosity) {
-        m_sstr.imbue(logLocl);
+        m_line = t_logLine.busy ? new LogLine() : &t_logLine;
+        m_line->busy = true;
+        m_line->reset();
+        std::ostream& os = m_line->os;
         if (g_logSyslog)
-            m_sstr << std::left << std::setw(8) << getThreadName() << " " EthReset;
+            os << std::left << std::setw(8) << cachedThreadName() << " " EthReset;
         else {
-            time_t rawTime = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
-            char buf[24];
-            if (strftime(buf, 24, "%X", localtime(&rawTime)) == 0)
-                buf[0] = '\0';  // empty if case strftime fails
-            m_sstr << _id << " " EthViolet << buf << " " EthBlue << std::left << std::setw(8)
-                   << getThreadName() << " " EthReset;
+            os << _id << " " EthViolet << cachedTime() << " " EthBlue << std::left << std::setw(8)
+               << cachedThreadName() << " " EthReset;
         }
     }
 }
 
+LogOutputStreamBase::~LogOutputStreamBase()
+{
+    if (!m_line)
+        return;
+    if (m_line == &t_logLine)
+        m_line->busy = false;
+    else
+        delete m_line;
+}
+
+std::ostream& LogOutputStreamBase::stream()
+{
+    return m_line->os;
+}
+
+void LogOutputStreamBase::post()
+{
+    if (m_line)
+        LogSink::instance().post(m_line->buf.data(), m_line->buf.size());
+}
+
+void energi::flushLog()
+{
+    LogSink::instance().drain();
+}
+
+uint64_t energi::droppedLogEntries()
+{
+    return LogSink::instance().dropped();
+}
+
 
 /// Associate a name with each thread for nice logging.
 struct ThreadLocalLogName
@@ -106,6 +415,9 @@ void energi::setThreadName(char const* _n)
 #else
     ThreadLocalLogName::name = _n;
 #endif
+    // Log entries pick the name up from here, without asking the system each time
+    std::strncpy(t_logCache.name, _n, sizeof(t_logCache.name) - 1);
+    t_logCache.named = true;
 }
 
 void energi::simpleDebugOut(std::string const& _s)
@@ -25,6 +25,7 @@
 
 #include "Terminal.h"
 
+#include <cstdint>
 #include <string>
 #include <ctime>
 #include <chrono>
@@ -45,6 +46,12 @@ namespace energi {
 /// A simple log-output function that prints log messages to stdout.
 void simpleDebugOut(std::string const&);
 
+/// Writes out every queued log entry from the calling thread, done at exit as well.
+void flushLog();
+
+/// Number of log entries lost because the queue to the log thread was full.
+uint64_t droppedLogEntries();
+
 /// Set the current thread's log name.
 void setThreadName(char const* _n);
 
@@ -68,20 +75,33 @@ struct NoteChannel : public LogChannel
     static const char* name();
 };
 
+struct LogLine;
+
+/// Formats an entry into a buffer of the calling thread and hands it to the log thread,
+/// which does the actual writing. No allocation unless the entry is long or nested.
 class LogOutputStreamBase
 {
 public:
     LogOutputStreamBase(char const* _id, unsigned _v);
+    ~LogOutputStreamBase();
+
+    LogOutputStreamBase(LogOutputStreamBase const&) = delete;
+    LogOutputStreamBase& operator=(LogOutputStreamBase const&) = delete;
 
     template <class T>
     void append(T const& _t)
     {
-        m_sstr << _t;
+        if (m_line)
+            stream() << _t;
     }
 
 protected:
+    std::ostream& stream();
+    /// Queues the accrued entry for the log thread.
+    void post();
+
     unsigned m_verbosity = 0;
-    std::stringstream m_sstr;  ///< The accrued log entry.
+    LogLine* m_line = nullptr;  ///< The accrued log entry.
 };
 
 /// Logging class, iostream-like, that can be shifted to.
@@ -94,11 +114,11 @@ public:
     /// with a '|' character.
     LogOutputStream() : LogOutputStreamBase(Id::name(), Id::verbosity) {}
 
-    /// Destructor. Posts the accrued log entry to the g_logPost function.
+    /// Destructor. Posts the accrued log entry to the log thread.
     ~LogOutputStream()
     {
         if (Id::verbosity <= g_logVerbosity)
-            simpleDebugOut(m_sstr.str());
+            post();
     }
 
     /// Shift arbitrary data to the log. Spaces will be added between items as required.
@@ -10,6 +10,7 @@
 
 #include "Log.h"
 #include "portable_endian.h"
+#include "utilstrencodings.h"
 #include <cstdint>
 #include <cstring>
 #include <iomanip>
@@ -183,15 +184,9 @@ inline void setBuffer(const uint8_t* ptr, uint32_t value)
 
 inline std::string strToHex(const std::string& str)
 {
-    std::ostringstream result;
-    for (const auto& item : str) {
-        result << std::hex
-              << std::setfill('0')
-              << std::setw(2)
-              << std::nouppercase
-              << static_cast<unsigned int>(static_cast<unsigned char>(item));
-    }
-    return result.str();
+    std::string result;
+    HexEncode(reinterpret_cast<const unsigned char*>(str.data()), str.size(), result);
+    return result;
 }
 
 inline bool setenv(const char name[], const char value[], bool over = false)
@@ -263,6 +258,7 @@ struct WorkingProgress
     std::map<std::string, float> minersHashRates; // maps a miner's device name to it's hash count
     std::map<std::string, bool> miningIsPaused;
     std::map<std::string, HwMonitor> minerMonitors;
+    std::map<std::string, uint64_t> minerInvalids;  // candidates rejected by CPU verification
 
 };
 
@@ -281,6 +277,10 @@ inline std::ostream& operator<<(std::ostream& _out, WorkingProgress _p)
         }
         mh = _p.minersHashRates[i.first] / 1000000.0f;
         _out << i.first << " " << EthTeal << std::fixed << std::setprecision(2) << mh << EthReset << "  ";
+        auto invalid = _p.minerInvalids.find(i.first);
+        if (invalid != _p.minerInvalids.end()) {
+            _out << EthRed << "!" << invalid->second << EthReset << "  ";
+        }
         auto iter = _p.minerMonitors.find(i.first);
         if (iter != _p.minerMonitors.end()) {
             _out << " " << EthTeal << _p.minerMonitors[i.first] << EthReset << "  ";
@@ -12,6 +12,10 @@
 #include <errno.h>
 #include <limits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
 static const string CHARS_ALPHA_NUM = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
@@ -22,6 +26,141 @@ static const string SAFE_CHARS[] =
     CHARS_ALPHA_NUM + " .,;-_?@" // SAFE_CHARS_UA_COMMENT
 };
 
+namespace {
+
+/** Both hex digits of every byte value, so a byte is encoded with one lookup. */
+struct HexDigits
+{
+    char digits[256][2];
+
+    HexDigits()
+    {
+        static const char hexmap[16] = { '0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f' };
+        for (int i = 0; i < 256; ++i) {
+            digits[i][0] = hexmap[i >> 4];
+            digits[i][1] = hexmap[i & 15];
+        }
+    }
+};
+
+const HexDigits& hexDigits()
+{
+    static const HexDigits table;
+    return table;
+}
+
+#if defined(__SSE2__)
+/** Turns 16 nibbles into their hex digits, '0' + n plus the gap up to 'a' for n > 9. */
+inline __m128i NibblesToHex(__m128i nibbles)
+{
+    const __m128i above9 = _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9));
+    const __m128i digits = _mm_add_epi8(nibbles, _mm_set1_epi8('0'));
+    return _mm_add_epi8(digits, _mm_and_si128(above9, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+/**
+ * Values of 16 hex digits, one per byte. Returns false, leaving nibbles
+ * undefined, if any of the characters is not a hex digit.
+ */
+inline bool HexToNibbles(__m128i chars, __m128i& nibbles)
+{
+    // Non ASCII characters are negative and fail both ranges
+    const __m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)),
+                                        _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+    const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                        _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+    if (_mm_movemask_epi8(_mm_or_si128(digit, alpha)) != 0xffff) {
+        return false;
+    }
+    nibbles = _mm_or_si128(_mm_and_si128(digit, _mm_sub_epi8(chars, _mm_set1_epi8('0'))),
+                           _mm_and_si128(alpha, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    return true;
+}
+
+/** Joins the nibble pairs of 16 digits into the low bytes of 8 16-bit lanes. */
+inline __m128i NibblePairs(__m128i nibbles)
+{
+    // A lane holds the first digit of a pair in its low byte
+    const __m128i high = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00ff)), 4);
+    return _mm_or_si128(high, _mm_srli_epi16(nibbles, 8));
+}
+#endif
+
+} // namespace
+
+void HexEncode(const unsigned char* data, size_t size, char* out)
+{
+#if defined(__SSE2__)
+    const __m128i low = _mm_set1_epi8(0x0f);
+    while (size >= 16) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), low);
+        const __m128i lo = _mm_and_si128(bytes, low);
+        // The high nibble's digit comes first
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), NibblesToHex(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), NibblesToHex(_mm_unpackhi_epi8(hi, lo)));
+        data += 16;
+        out += 32;
+        size -= 16;
+    }
+#endif
+    const HexDigits& table = hexDigits();
+    for (size_t i = 0; i < size; ++i) {
+        memcpy(out + 2 * i, table.digits[data[i]], 2);
+    }
+}
+
+void HexEncode(const unsigned char* data, size_t size, std::string& str)
+{
+    const size_t offset = str.size();
+    str.resize(offset + 2 * size);
+    HexEncode(data, size, &str[offset]);
+}
+
+void HexEncodeReversed(const unsigned char* data, size_t size, char* out)
+{
+    unsigned char reversed[64];
+    while (size > 0) {
+        // Blocks from the end of data, each reversed
+        const size_t block = std::min(size, sizeof(reversed));
+        for (size_t i = 0; i < block; ++i) {
+            reversed[i] = data[size - 1 - i];
+        }
+        HexEncode(reversed, block, out);
+        out += 2 * block;
+        size -= block;
+    }
+}
+
+size_t HexDecode(const char* hex, size_t size, unsigned char* out)
+{
+    const unsigned char* const begin = out;
+#if defined(__SSE2__)
+    while (size >= 32) {
+        __m128i first, second;
+        if (!HexToNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex)), first) ||
+            !HexToNibbles(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hex + 16)), second)) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(NibblePairs(first), NibblePairs(second)));
+        hex += 32;
+        out += 16;
+        size -= 32;
+    }
+#endif
+    for (; size >= 2; hex += 2, size -= 2) {
+        const signed char high = HexDigit(hex[0]);
+        const signed char low = HexDigit(hex[1]);
+        if (high < 0 || low < 0) {
+            break;
+        }
+        *out++ = static_cast<unsigned char>((high << 4) | low);
+    }
+    return out - begin;
+}
+
 string SanitizeString(const string& str, int rule)
 {
     string strResult;
@@ -68,8 +207,11 @@ bool IsHex(const string& str)
 
 vector<unsigned char> ParseHex(const char* psz)
 {
-    // convert hex dump to vector
-    vector<unsigned char> vch;
+    // convert hex dump to vector, the digits up to the first space or invalid pair in bulk
+    const size_t size = strlen(psz);
+    vector<unsigned char> vch(size / 2);
+    vch.resize(HexDecode(psz, size, vch.data()));
+    psz += 2 * vch.size();
     while (true)
     {
         while (isspace(*psz))
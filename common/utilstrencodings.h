@@ -77,6 +77,29 @@ bool ParseInt64(const std::string& str, int64_t *out);
  */
 bool ParseDouble(const std::string& str, double *out);
 
+/**
+ * Writes the 2 * size lowercase hex digits of data to out, 16 bytes at a time
+ * where SSE2 is available. out is not terminated.
+ */
+void HexEncode(const unsigned char* data, size_t size, char* out);
+
+/** Appends the hex digits of data to str, growing it once. */
+void HexEncode(const unsigned char* data, size_t size, std::string& str);
+
+/**
+ * Like HexEncode, but of the bytes of data in reverse order, which is how
+ * uint256 and the other little endian blobs are printed.
+ */
+void HexEncodeReversed(const unsigned char* data, size_t size, char* out);
+
+/**
+ * Decodes the pairs of hex digits at the start of the size characters at hex
+ * into out, which has room for size / 2 bytes. Either case is accepted.
+ * @returns the number of bytes written, decoding stops at the first pair that
+ *   is not two hex digits.
+ */
+size_t HexDecode(const char* hex, size_t size, unsigned char* out);
+
 template<typename T>
 std::string HexStr(const T itbegin, const T itend, bool fSpaces=false)
 {
@@ -11,11 +11,31 @@
 
 using namespace energi;
 
+CpuAffinityPolicy CpuMiner::s_affinityPolicy = CpuAffinityPolicy::kNone;
+std::vector<unsigned> CpuMiner::s_cores;
+
 CpuMiner::CpuMiner(const Plant &plant, int index)
     :Miner("CPU/", plant, index)
 {
 }
 
+void CpuMiner::configureCPU(CpuAffinityPolicy policy, const std::vector<unsigned>& cores)
+{
+    s_affinityPolicy = policy;
+    s_cores = cores;
+}
+
+std::vector<int> CpuMiner::placement()
+{
+    const auto& topology = CpuTopology::get();
+    auto result = topology.placement(s_affinityPolicy, s_cores);
+    cnote << "CPU placement " << to_string(s_affinityPolicy) << ": "
+          << result.size() << " threads on "
+          << topology.physicalCores() << " cores / "
+          << topology.cpus().size() << " logical cpus";
+    return result;
+}
+
 void CpuMiner::trun()
 {
     uint64_t startNonce = 0;
@@ -50,7 +70,7 @@ void CpuMiner::trun()
             // we dont use mixHash part to calculate hash but fill it later (below)
             do {
                 auto hash = GetPOWHash(work);
-                if (UintToArith256(hash) < work.hashTarget) {
+                if (work.meetsTarget(hash)) {
                     updateHashRate(work.nNonce + 1 - lastNonce);
                     Solution sol = Solution(work, work.getSecondaryExtraNonce());
                     cnote << name() << "Submitting block blockhash: " << work.GetHash().ToString() << " height: " << work.nHeight << "nonce: " << work.nNonce;
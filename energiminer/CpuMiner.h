@@ -9,6 +9,9 @@
 #define ENERGIMINER_CPUMINER_H_
 
 #include "nrgcore/miner.h"
+#include "nrgcore/cputopology.h"
+
+#include <vector>
 
 namespace energi
 {
@@ -19,8 +22,16 @@ namespace energi
 
     virtual ~CpuMiner() {stopWorking();}
 
+    static void configureCPU(CpuAffinityPolicy policy, const std::vector<unsigned>& cores);
+    //! Logical cpu of every CPU miner thread, -1 for unpinned threads
+    static std::vector<int> placement();
+
   protected:
     void trun() override;
+
+  private:
+    static CpuAffinityPolicy s_affinityPolicy;
+    static std::vector<unsigned> s_cores;
   };
 
 } /* namespace energi */
@@ -5,6 +5,10 @@
 #include <protocol/PoolManager.h>
 #include <protocol/stratum/StratumClient.h>
 #include <protocol/getwork/GetworkClient.h>
+#include <protocol/replay/ReplayClient.h>
+#include <protocol/replay/SessionRecorder.h>
+#include <protocol/testing/SimulateClient.h>
+#include <primitives/sha256.h>
 
 #include <CLI/CLI.hpp>
 
@@ -23,6 +27,7 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
 {
 
     const char* CommonGroup = "Common Options";
+    const char* CPUGroup =    "CPU Options";
 #if NRGHASHCL
     const char* OpenCLGroup = "OpenCL Options";
 #endif
@@ -83,6 +88,11 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
     hwmon_opt->group(CommonGroup)
         ->check(CLI::Range(1));
 
+    app.add_option("--hwmon-interval", m_hwmonInterval,
+            "Read the GPU sensors every this many milliseconds", true)
+        ->group(CommonGroup)
+        ->check(CLI::Range(100, 60000));
+
     app.add_flag("--exit", m_exit,
             "Stops the miner whenever an error is encountered")
         ->group(CommonGroup);
@@ -97,6 +107,11 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
         ->group(CommonGroup)
         ->check(CLI::Range(0, 999));
 
+    app.add_option("--standby", m_standbyPools,
+            "Keep this many failover pools connected and authorized, so a switch needs no handshake. 0 connects only on failover", true)
+        ->group(CommonGroup)
+        ->check(CLI::Range(0, 16));
+
     app.add_flag("--nocolor", g_logNoColor, "Display monochrome log")->group(CommonGroup);
 
     app.add_flag("--syslog", g_logSyslog,
@@ -130,6 +145,11 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
             "Set the local work size", true)
         ->group(OpenCLGroup)
         ->check(CLI::Range(32, 99999));
+
+    app.add_flag("--cl-autotune", m_openclAutoTune,
+            "Sweep the local work size and global work multiplier per device once per epoch, "
+            "the best ones are kept in cltune.json in the data directory and override --cl-local-work and --cl-global-work")
+        ->group(OpenCLGroup);
 #endif
 #if NRGHASHCUDA
     app.add_option("--cuda-grid-size", m_cudaGridSize,
@@ -167,18 +187,33 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
         ->group(CUDAGroup)
         ->check(CLI::Range(1, 99));
 #endif
+    string cpuAffinity = "none";
+    app.add_set("--cpu-affinity", cpuAffinity, {"none", "core", "thread", "list"},
+            "Set the CPU miner thread placement."
+            "  none    - let the scheduler place hardware threads - 1 miner threads"
+            "  core    - pin one miner thread to each physical core, SMT siblings are left idle"
+            "  thread  - pin one miner thread to each logical cpu"
+            "  list    - pin one miner thread to each cpu given with --cpu-cores"
+            "  ", true)
+        ->group(CPUGroup);
+
+    app.add_option("--cpu-cores", m_cpuCores,
+            "Select list of logical cpus to mine on. Implies --cpu-affinity list")
+        ->group(CPUGroup);
+
     app.add_flag("--noeval", m_noEval,
             "Bypass host software re-evaluation of GPU solutions")
         ->group(CommonGroup);
 
     app.add_option("-L,--dag-load-mode", m_dagLoadMode,
-            "Set the DAG load mode. 0=parallel, 1=sequential, 2=single."
+            "Set the DAG load mode. 0=parallel, 1=sequential, 2=single, 3=host."
             "  parallel    - load DAG on all GPUs at the same time"
             "  sequential  - load DAG on GPUs one after another. Use this when the miner crashes during DAG generation"
             "  single      - generate DAG on device, then copy to other devices. Implies --dag-single-dev"
+            "  host        - map the DAG file once and upload it to all OpenCL devices at the same time"
             "  ", true)
         ->group(CommonGroup)
-        ->check(CLI::Range(2));
+        ->check(CLI::Range(3));
 
     app.add_option("--dag-single-dev", m_dagCreateDevice,
             "Set the DAG creation device in single mode", true)
@@ -189,10 +224,28 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
         ->group(CommonGroup);
 
     app.add_option("--benchmark-trial", m_benchmarkTrial,
+            "Set the duration in seconds of each benchmark trial", true)
+        ->group(CommonGroup)
+        ->check(CLI::Range(1, 99));
+
+    app.add_option("--benchmark-trials", m_benchmarkTrials,
             "Set the number of benchmark trials to run", true)
         ->group(CommonGroup)
         ->check(CLI::Range(1, 99));
 
+    app.add_option("--benchmark-json", m_benchmarkJson,
+            "Write the benchmark report to this file instead of stdout")
+        ->group(CommonGroup);
+
+    app.add_flag("--benchmark-test", m_benchmarkTest,
+            "Benchmark the test engine, which reports a fixed hashrate, to check the harness itself")
+        ->group(CommonGroup);
+
+    bool cpu_miner = false;
+    app.add_flag("-C,--cpu", cpu_miner,
+            "When mining use the CPU")
+        ->group(CommonGroup);
+
     bool cl_miner = false;
     app.add_flag("-G,--opencl", cl_miner,
             "When mining use the GPU via OpenCL")
@@ -216,6 +269,24 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
             "Mining test. Used to validate kernel optimizations. Specify block number", true);
     sim_opt->group(CommonGroup);
 
+    app.add_option("--simulation-interval", m_simulationInterval,
+            "Set the seconds between shares the simulated pool retargets its difficulty to", true)
+        ->group(CommonGroup)
+        ->check(CLI::Range(1, 3600));
+
+    app.add_option("--record", m_recordFile,
+            "Record every message exchanged with the pool, with timestamps, to this file")
+        ->group(CommonGroup);
+
+    auto replay_opt = app.add_option("--replay", m_replayFile,
+            "Mine a session recorded with --record instead of a pool and report job switch latency, stale shares and round trips");
+    replay_opt->group(CommonGroup);
+
+    app.add_option("--replay-speed", m_replaySpeed,
+            "Play the recorded session this many times faster", true)
+        ->group(CommonGroup)
+        ->check(CLI::Range(0.01, 1000.0));
+
     app.add_option("--tstop", m_tstop,
             "Stop mining on a GPU if temperature exceeds value. 0 is disabled, valid: 30..100", true)
         ->group(CommonGroup)
@@ -288,13 +359,15 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
     }
 
     if (m_minerExecutionMode != MinerExecutionMode::kCPU) {
-        if (!cl_miner && !cuda_miner && !mixed_miner && !bench_opt->count() && !sim_opt->count()) {
-            cerr << endl << "One of -G, -U, -X, -M, or -Z must be specified" << "\n\n";
+        if (!cpu_miner && !cl_miner && !cuda_miner && !mixed_miner && !bench_opt->count() && !sim_opt->count()) {
+            cerr << endl << "One of -C, -G, -U, -X, -M, or -Z must be specified" << "\n\n";
             exit(-1);
         }
     }
 
-    if (cl_miner) {
+    if (cpu_miner) {
+        m_minerExecutionMode = MinerExecutionMode::kCPU;
+    } else if (cl_miner) {
         m_minerExecutionMode = MinerExecutionMode::kCL;
     } else if (cuda_miner) {
         m_minerExecutionMode = MinerExecutionMode::kCUDA;
@@ -335,6 +408,9 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
         //}
         m_mode = mode;
     }
+    if (replay_opt->count()) {
+        m_mode = OperationMode::Replay;
+    }
 
     if ((m_mode == OperationMode::None) && !m_shouldListDevices) {
         cerr << endl << "At least one pool URL must be specified" << "\n\n";
@@ -358,6 +434,14 @@ void MinerCLI::ParseCommandLine(int argc, char** argv)
     }
 #endif
 
+    m_cpuAffinityPolicy = cpuAffinityPolicyFromString(cpuAffinity);
+    if (!m_cpuCores.empty()) {
+        m_cpuAffinityPolicy = CpuAffinityPolicy::kList;
+    } else if (m_cpuAffinityPolicy == CpuAffinityPolicy::kList) {
+        cerr << endl << "--cpu-affinity list requires --cpu-cores" << "\n\n";
+        exit(-1);
+    }
+
     if (m_tstop && (m_tstop <= m_tstart)) {
         cerr << endl << "tstop must be greater than tstart" << "\n\n";
         exit(-1);
@@ -386,6 +470,10 @@ void MinerCLI::execute()
         return;
     }
 
+    if (m_minerExecutionMode == MinerExecutionMode::kCPU) {
+        CpuMiner::configureCPU(m_cpuAffinityPolicy, m_cpuCores);
+    }
+
     if (m_minerExecutionMode == MinerExecutionMode::kCL ||
             m_minerExecutionMode == MinerExecutionMode::kMixed) {
 # if NRGHASHCL
@@ -394,11 +482,12 @@ void MinerCLI::execute()
             m_miningThreads = m_openclDeviceCount;
         }
         OpenCLMiner::setThreadsPerHash(m_openclThreadsPerHash);
+        OpenCLMiner::setAutoTune(m_openclAutoTune);
         if (!OpenCLMiner::configureGPU(
                     m_localWorkSize,
                     m_globalWorkSizeMultiplier,
                     m_openclPlatform,
-                    0,
+                    m_benchmarkBlock,
                     m_dagLoadMode,
                     m_dagCreateDevice,
                     m_noEval,
@@ -457,11 +546,12 @@ void MinerCLI::execute()
 
     switch (m_mode) {
         case OperationMode::Benchmark:
-            //doBenchmark(m_minerExecutionMode, m_benchmarkWarmup, m_benchmarkTrial, m_benchmarkTrials);
+            doBenchmark();
             break;
         case OperationMode::GBT:
         case OperationMode::Stratum:
         case OperationMode::Simulation:
+        case OperationMode::Replay:
             doMiner();
             break;
         default:
@@ -472,34 +562,63 @@ void MinerCLI::execute()
 
 void MinerCLI::doMiner()
 {
-    PoolClient* client = nullptr;
+    if (!m_recordFile.empty() && (m_mode == OperationMode::GBT || m_mode == OperationMode::Stratum)) {
+        const bool gbt = m_mode == OperationMode::GBT;
+        SessionRecorder::open(m_recordFile, gbt ? "getwork" : "stratum", gbt ? m_coinbase_addr : std::string());
+    }
+
+    // Every pool gets its own client, the replay has a single one
+    PoolManager::ClientFactory factory;
+    unsigned standby = 0;
     if (m_mode == OperationMode::GBT) {
-			client = new GetworkClient(m_farmRecheckPeriod, m_coinbase_addr);
+        factory = [this]() -> PoolClient* { return new GetworkClient(m_farmRecheckPeriod, m_coinbase_addr); };
+        standby = m_standbyPools;
     } else if (m_mode == OperationMode::Stratum) {
-        client = new StratumClient(m_io_service, m_worktimeout, m_responsetimeout, m_report_stratum_hashrate);
+        factory = [this]() -> PoolClient* {
+            return new StratumClient(m_io_service, m_worktimeout, m_responsetimeout, m_report_stratum_hashrate);
+        };
+        standby = m_standbyPools;
     } else if (m_mode == OperationMode::Simulation) {
-        //client = new SimulationClient(20, m_benchmarkBlock);
-        std::cout << "Selected simulation mode" << std::endl;
-        return;
+        factory = [this]() -> PoolClient* { return new SimulateClient(m_benchmarkBlock, m_simulationInterval); };
+    } else if (m_mode == OperationMode::Replay) {
+        auto replay = new ReplayClient(m_replayFile, m_replaySpeed);
+        if (!replay->load()) {
+            delete replay;
+            stop_io_service();
+            std::exit(1);
+        }
+        factory = [replay]() mutable -> PoolClient* {
+            PoolClient* client = replay;
+            replay = nullptr;
+            return client;
+        };
     } else {
         cwarn << "Inwalid OperationMode";
         std::exit(1);
     }
-    if (client == nullptr) {
-        stop_io_service();
-        //! This should not happen
-        std::cerr << "Client is not contsructed normally" << std::endl;
-        std::exit(1);
+    // A recording is of one pool, standbys would interleave their messages with it
+    if (SessionRecorder::active()) {
+        standby = 0;
     }
     cnote << "Engines started!";
+    cnote << "Using SHA256 implementation: " << SHA256AutoDetect();
     energi::MinePlant plant(m_io_service, m_show_hwmonitors, m_show_power);
-    PoolManager mgr(m_io_service, client, plant, m_minerExecutionMode, m_maxFarmRetries, m_failovertimeout);
+    plant.setHwmonInterval(m_hwmonInterval);
+    plant.setTStartTStop(m_tstart, m_tstop);
+    PoolManager mgr(m_io_service, factory, plant, m_minerExecutionMode, m_maxFarmRetries, m_failovertimeout, standby);
 
     // If we are in simulation mode we add a fake connection
     if (m_mode == OperationMode::Simulation) {
         URI con(URI("http://-:0"));
         mgr.clearConnections();
         mgr.addConnection(con);
+    } else if (m_mode == OperationMode::Replay) {
+        // The replay gives up its connection at the end of the log, the manager then exits
+        URI con(URI("http://-:0"));
+        URI exit(URI("stratum+tcp://-:x@exit:0"));
+        mgr.clearConnections();
+        mgr.addConnection(con);
+        mgr.addConnection(exit);
     } else {
         for (auto conn : m_endpoints) {
             cnote << "Configured pool " << conn.Host() + ":" + to_string(conn.Port());
@@ -522,13 +641,137 @@ void MinerCLI::doMiner()
         }
         if (mgr.isConnected()) {
             auto mp = plant.miningProgress();
-            minelog << mp << ' ' << plant.getSolutionStats() << ' ' << plant.farmLaunchedFormatted();
+            minelog << mp << ' ' << plant.getSolutionStats() << plant.getSubmitStats() << ' ' << plant.farmLaunchedFormatted();
         } else {
             minelog << "not-connected";
         }
         interval = m_displayInterval;
     }
     mgr.stop();
+    SessionRecorder::close();
+    stop_io_service();
+    exit(0);
+}
+
+void MinerCLI::doBenchmark()
+{
+    using namespace std::chrono;
+
+    const uint32_t height = std::max(1u, m_benchmarkBlock);
+    const uint64_t epoch = height / nrghash::constants::EPOCH_LENGTH;
+
+    // Nothing is expected to meet the target, the upper 64 bits are still non zero as the kernels require
+    std::mt19937_64 rng(std::random_device{}());
+    const Work work = SimulateClient::makeWork(height, uint64_t(1) << 63, rng);
+
+    const std::vector<EnumMinerEngine> engines = m_benchmarkTest
+        ? std::vector<EnumMinerEngine>{ EnumMinerEngine::kTest }
+        : getEngineModes(m_minerExecutionMode);
+
+    auto* bi = energiminer_get_buildinfo();
+    Json::Value report(Json::objectValue);
+    report["version"] = bi->project_version;
+    report["system"] = std::string(bi->system_name) + "/" + bi->build_type + "/" + bi->compiler_id;
+    report["block"] = height;
+    report["epoch"] = Json::UInt64(epoch);
+    report["warmup"] = m_benchmarkWarmup;
+    report["trial"] = m_benchmarkTrial;
+    report["engines"] = Json::Value(Json::arrayValue);
+
+    for (auto engine : engines) {
+        if (!g_running) {
+            break;
+        }
+        Json::Value result(Json::objectValue);
+        result["engine"] = to_string(engine);
+
+        energi::MinePlant plant(m_io_service, false, false);
+        plant.start({ engine });
+        plant.setWork(work);
+
+        // The first work builds the DAG, the warmup only starts once every miner hashes
+        auto const started = steady_clock::now();
+        std::vector<float> rates = plant.minerHashRates();
+        while (g_running && !rates.empty()
+               && std::any_of(rates.begin(), rates.end(), [](float rate) { return rate <= 0; })) {
+            this_thread::sleep_for(milliseconds(250));
+            rates = plant.minerHashRates();
+        }
+        if (rates.empty()) {
+            cwarn << "Benchmark: no " << to_string(engine) << " miner could be started";
+            result["error"] = "no miners";
+            report["engines"].append(result);
+            continue;
+        }
+        result["miners"] = Json::UInt(rates.size());
+        result["startup_ms"] = Json::Int64(duration_cast<milliseconds>(steady_clock::now() - started).count());
+        minelog << "Benchmarking " << to_string(engine) << " on " << rates.size() << " miners at block "
+                << height << ", warmup " << m_benchmarkWarmup << " s";
+        for (auto deadline = steady_clock::now() + seconds(m_benchmarkWarmup);
+             g_running && steady_clock::now() < deadline;) {
+            this_thread::sleep_for(milliseconds(250));
+        }
+
+        // A trial is the mean of the hashrates sampled over its duration
+        std::vector<double> trials;
+        for (unsigned i = 0; g_running && i < m_benchmarkTrials; ++i) {
+            double sum = 0;
+            unsigned samples = 0;
+            for (auto deadline = steady_clock::now() + seconds(m_benchmarkTrial);
+                 g_running && steady_clock::now() < deadline; ++samples) {
+                this_thread::sleep_for(milliseconds(250));
+                for (float rate : plant.minerHashRates()) {
+                    sum += rate;
+                }
+            }
+            if (!samples) {
+                break;
+            }
+            trials.push_back(sum / samples);
+            minelog << "Trial " << i + 1 << "/" << m_benchmarkTrials << ": " << std::fixed
+                    << std::setprecision(2) << trials.back() / 1000000.0 << " Mh/s";
+        }
+        plant.stop();
+
+        result["trials"] = Json::Value(Json::arrayValue);
+        for (double trial : trials) {
+            result["trials"].append(trial);
+        }
+        if (!trials.empty()) {
+            double mean = 0;
+            for (double trial : trials) {
+                mean += trial;
+            }
+            mean /= trials.size();
+            double variance = 0;
+            for (double trial : trials) {
+                variance += (trial - mean) * (trial - mean);
+            }
+            if (trials.size() > 1) {
+                variance /= trials.size() - 1;
+            }
+            result["mean"] = mean;
+            result["stddev"] = std::sqrt(variance);
+            result["min"] = *std::min_element(trials.begin(), trials.end());
+            result["max"] = *std::max_element(trials.begin(), trials.end());
+            minelog << to_string(engine) << " " << std::fixed << std::setprecision(2)
+                    << mean / 1000000.0 << " Mh/s mean, " << std::sqrt(variance) / 1000000.0 << " stddev, "
+                    << result["min"].asDouble() / 1000000.0 << " min, "
+                    << result["max"].asDouble() / 1000000.0 << " max";
+        }
+        report["engines"].append(result);
+    }
+
+    const std::string json = Json::StyledWriter().write(report);
+    if (m_benchmarkJson.empty()) {
+        std::cout << json << std::flush;
+    } else {
+        std::ofstream out(m_benchmarkJson, std::ios::trunc);
+        out << json;
+        if (!out) {
+            cwarn << "Could not write benchmark report " << m_benchmarkJson;
+        }
+    }
     stop_io_service();
     exit(0);
 }
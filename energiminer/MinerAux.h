@@ -29,9 +29,14 @@
 #include "primitives/solution.h"
 #include "primitives/work.h"
 #include "nrgcore/mineplant.h"
+#include "nrgcore/cputopology.h"
+#include "energiminer/CpuMiner.h"
 #include <protocol/PoolURI.h>
 
 
+#include <algorithm>
+#include <cmath>
+#include <ctime>
 #include <memory>
 #include <sstream>
 #include <iomanip>
@@ -81,6 +86,7 @@ public:
 		None,
 		Benchmark,
 		Simulation,
+		Replay,
 		GBT,
 		Stratum
 	};
@@ -143,6 +149,12 @@ private:
 
     */
     void doMiner();
+    /*
+       doBenchmark mines a synthetic Work at m_benchmarkBlock on each selected engine, without a pool.
+       Once every miner hashes it waits out the warmup, then samples the hashrate over each trial
+       and reports mean, stddev, min and max per engine as JSON.
+    */
+    void doBenchmark();
 
 private:
 	/// Operating mode.
@@ -167,6 +179,7 @@ private:
 	unsigned m_openclDeviceCount = 0;
     std::vector<unsigned> m_openclDevices = std::vector<unsigned>(MAX_MINERS, -1);
 	unsigned m_openclThreadsPerHash = 8;
+	bool m_openclAutoTune = false;
 
     int m_globalWorkSizeMultiplier = energi::OpenCLMiner::c_defaultGlobalWorkSizeMultiplier;
 	unsigned m_localWorkSize = energi::OpenCLMiner::c_defaultLocalWorkSize;
@@ -181,6 +194,9 @@ private:
 	unsigned m_cudaParallelHash    = 4;
 #endif
 
+	CpuAffinityPolicy m_cpuAffinityPolicy = CpuAffinityPolicy::kNone;
+	std::vector<unsigned> m_cpuCores;
+
 	unsigned m_dagLoadMode = 0; // parallel
 	bool m_noEval = false;
 	unsigned m_dagCreateDevice = 0;
@@ -191,6 +207,12 @@ private:
 	unsigned m_benchmarkTrial = 3;
 	unsigned m_benchmarkTrials = 5;
 	unsigned m_benchmarkBlock = 0;
+	bool m_benchmarkTest = false;
+	unsigned m_simulationInterval = 15;
+	std::string m_recordFile;
+	std::string m_replayFile;
+	double m_replaySpeed = 1.0;
+	std::string m_benchmarkJson;
     std::vector<URI> m_endpoints;
 
 
@@ -200,9 +222,12 @@ private:
 	int m_responsetimeout = 3;
     // Number of minutes to wait on a failover pool before trying to go back to primary. In minutes !!
     unsigned m_failovertimeout = 0;
+    // Failover pools kept connected and authorized next to the primary
+    unsigned m_standbyPools = 1;
 
 	bool m_show_hwmonitors = false;
 	bool m_show_power = false;
+	unsigned m_hwmonInterval = energi::HwSampler::c_defaultIntervalMs;
 
     unsigned m_tstop = 0;
     unsigned m_tstart = 40;
@@ -0,0 +1,145 @@
+/*
+ * CLProgramCache.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "libegihash-cl/CLProgramCache.h"
+
+#include "common/Log.h"
+#include "nrghash/nrghash.h"
+
+#include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+using namespace energi;
+
+const size_t CLProgramCache::c_maxEntries;
+
+namespace
+{
+
+// Cache files are named <device>-<driver>-<key>.bin, by hex digests of 8, 8 and 64 digits
+const size_t c_tagDigits = 8;
+const size_t c_keyDigits = 64;
+
+std::string tag(const std::string& text)
+{
+    return nrghash::h256_t(text.data(), text.size()).to_hex().substr(0, c_tagDigits);
+}
+
+bool isCacheName(const std::string& name)
+{
+    return name.size() == 2 * (c_tagDigits + 1) + c_keyDigits + 4 && name[c_tagDigits] == '-'
+        && name[2 * c_tagDigits + 1] == '-' && name.compare(name.size() - 4, 4, ".bin") == 0;
+}
+
+} //! anonymous namespace
+
+boost::filesystem::path CLProgramCache::file(const boost::filesystem::path& dir, const std::string& device,
+                                             const std::string& driver, const std::string& options,
+                                             const std::string& source)
+{
+    // Separators keep "ab" + "c" and "a" + "bc" apart
+    std::string key;
+    key.reserve(device.size() + driver.size() + options.size() + source.size() + 3);
+    key.append(device).push_back('\0');
+    key.append(driver).push_back('\0');
+    key.append(options).push_back('\0');
+    key.append(source);
+    return dir / (tag(device) + "-" + tag(driver) + "-" + nrghash::h256_t(key.data(), key.size()).to_hex() + ".bin");
+}
+
+bool CLProgramCache::load(const boost::filesystem::path& file, std::vector<unsigned char>& binary)
+{
+    std::ifstream in(file.string(), std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    binary.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (binary.empty()) {
+        return false;
+    }
+    // Eviction goes by the modification time, so a loaded binary counts as recently used
+    boost::system::error_code ec;
+    boost::filesystem::last_write_time(file, std::time(nullptr), ec);
+    return true;
+}
+
+void CLProgramCache::store(const boost::filesystem::path& file, const std::vector<unsigned char>& binary)
+{
+    if (binary.empty()) {
+        return;
+    }
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(file.parent_path(), ec);
+    // Written aside and renamed, identical devices may store the same binary at once
+    const size_t writer = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const boost::filesystem::path temp = file.string() + "." + std::to_string(writer) + ".tmp";
+    {
+        std::ofstream out(temp.string(), std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+        if (!out) {
+            cwarn << "Could not write program binary " << temp.string();
+            return;
+        }
+    }
+    boost::filesystem::rename(temp, file, ec);
+    if (ec) {
+        cwarn << "Could not write program binary " << file.string() << ": " << ec.message();
+        boost::filesystem::remove(temp, ec);
+        return;
+    }
+    evict(file);
+}
+
+void CLProgramCache::discard(const boost::filesystem::path& file)
+{
+    boost::system::error_code ec;
+    boost::filesystem::remove(file, ec);
+}
+
+void CLProgramCache::evict(const boost::filesystem::path& stored)
+{
+    // Another device may be evicting at the same time, every failure is ignored
+    const std::string name = stored.filename().string();
+    const std::string device = name.substr(0, c_tagDigits);
+    const std::string driver = name.substr(c_tagDigits + 1, c_tagDigits);
+
+    std::vector<std::pair<std::time_t, boost::filesystem::path>> kept;
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(stored.parent_path(), ec), end; !ec && it != end; it.increment(ec)) {
+        const boost::filesystem::path path = it->path();
+        const std::string entry = path.filename().string();
+        if (entry == name || path.extension() != ".bin") {
+            continue;
+        }
+        boost::system::error_code ignored;
+        // Binaries of an earlier driver of the device, or named by an earlier miner, are never loaded again
+        if (!isCacheName(entry) || (entry.compare(0, c_tagDigits, device) == 0
+                                    && entry.compare(c_tagDigits + 1, c_tagDigits, driver) != 0)) {
+            cnote << "Evicting program binary " << entry;
+            boost::filesystem::remove(path, ignored);
+            continue;
+        }
+        const std::time_t used = boost::filesystem::last_write_time(path, ignored);
+        if (!ignored) {
+            kept.emplace_back(used, path);
+        }
+    }
+    if (kept.size() < c_maxEntries) {
+        return;
+    }
+    // The stored binary counts as one of the entries
+    std::sort(kept.begin(), kept.end());
+    for (size_t i = 0; i + c_maxEntries <= kept.size(); ++i) {
+        cnote << "Evicting program binary " << kept[i].second.filename().string();
+        boost::system::error_code ignored;
+        boost::filesystem::remove(kept[i].second, ignored);
+    }
+}
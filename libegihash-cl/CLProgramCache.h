@@ -0,0 +1,44 @@
+/*
+ * CLProgramCache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+#pragma once
+
+#include <boost/filesystem.hpp>
+
+#include <string>
+#include <vector>
+
+namespace energi
+{
+
+  /**
+   * @brief Compiled search programs kept on disk, one file per device, driver,
+   *        build options and patched kernel source. The source carries the
+   *        DAG_SIZE, LIGHT_SIZE, GROUP_SIZE... definitions, so each epoch and
+   *        work group size gets its own binary. Storing a binary evicts the
+   *        ones of the device's earlier drivers, and the least recently used
+   *        beyond c_maxEntries, so past epochs do not pile up.
+   */
+  class CLProgramCache
+  {
+  public:
+    static boost::filesystem::path file(const boost::filesystem::path& dir, const std::string& device,
+                                        const std::string& driver, const std::string& options,
+                                        const std::string& source);
+
+    static bool load(const boost::filesystem::path& file, std::vector<unsigned char>& binary);
+    static void store(const boost::filesystem::path& file, const std::vector<unsigned char>& binary);
+    //! Drops a binary the driver refused to load
+    static void discard(const boost::filesystem::path& file);
+
+  private:
+    static void evict(const boost::filesystem::path& stored);
+
+    /// Current and next epoch of a few device models, each at a couple of work group sizes
+    static const size_t c_maxEntries = 32;
+  };
+
+} /* namespace energi */
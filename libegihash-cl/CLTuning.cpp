@@ -0,0 +1,85 @@
+/*
+ * CLTuning.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "libegihash-cl/CLTuning.h"
+
+#include "common/Log.h"
+
+#include <json/json.h>
+
+#include <fstream>
+#include <mutex>
+
+using namespace energi;
+
+namespace {
+
+std::mutex x_tuning;
+
+Json::Value load(const boost::filesystem::path& file)
+{
+    Json::Value root;
+    std::ifstream in(file.string());
+    if (in) {
+        Json::Reader reader;
+        if (!reader.parse(in, root, false) || !root.isObject()) {
+            cwarn << "Ignoring malformed tuning file " << file.string();
+            root = Json::Value(Json::objectValue);
+        }
+    }
+    return root;
+}
+
+}
+
+std::string CLTuningCache::key(const std::string& device, const std::string& driver, uint64_t epoch)
+{
+    return device + "/" + driver + "/" + std::to_string(epoch);
+}
+
+bool CLTuningCache::find(const boost::filesystem::path& file, const std::string& key, CLTuning& tuning)
+{
+    std::lock_guard<std::mutex> lock(x_tuning);
+    const Json::Value entry = load(file)["devices"][key];
+    if (!entry.isObject() || !entry["local_work"].isUInt() || !entry["global_work"].isUInt()) {
+        return false;
+    }
+    tuning.localWorkSize = entry["local_work"].asUInt();
+    tuning.globalWorkSizeMultiplier = entry["global_work"].asUInt();
+    tuning.threadsPerHash = entry.get("threads_per_hash", 8).asUInt();
+    tuning.hashRate = entry.get("hashrate", 0).asDouble();
+    return tuning.localWorkSize && tuning.globalWorkSizeMultiplier;
+}
+
+void CLTuningCache::store(const boost::filesystem::path& file, const std::string& key, const CLTuning& tuning)
+{
+    std::lock_guard<std::mutex> lock(x_tuning);
+    Json::Value root = load(file);
+    root["version"] = 1;
+    Json::Value& entry = root["devices"][key];
+    entry["local_work"] = tuning.localWorkSize;
+    entry["global_work"] = tuning.globalWorkSizeMultiplier;
+    entry["threads_per_hash"] = tuning.threadsPerHash;
+    entry["hashrate"] = tuning.hashRate;
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(file.parent_path(), ec);
+    // Written aside and renamed, a concurrent reader never sees half a file
+    const boost::filesystem::path temp = file.string() + ".tmp";
+    {
+        std::ofstream out(temp.string(), std::ios::trunc);
+        out << Json::StyledWriter().write(root);
+        if (!out) {
+            cwarn << "Could not write tuning file " << temp.string();
+            return;
+        }
+    }
+    boost::filesystem::rename(temp, file, ec);
+    if (ec) {
+        cwarn << "Could not write tuning file " << file.string() << ": " << ec.message();
+    }
+}
@@ -0,0 +1,39 @@
+/*
+ * CLTuning.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+#pragma once
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace energi
+{
+
+  /// Best search configuration found for one device, driver and epoch
+  struct CLTuning
+  {
+    unsigned localWorkSize = 0;
+    unsigned globalWorkSizeMultiplier = 0;
+    unsigned threadsPerHash = 8;
+    double   hashRate = 0;
+  };
+
+  /**
+   * @brief Auto-tune results kept as JSON, shared by all OpenCL miners of the
+   *        process. Every store rewrites the file so results survive a crash.
+   */
+  class CLTuningCache
+  {
+  public:
+    static std::string key(const std::string& device, const std::string& driver, uint64_t epoch);
+
+    static bool find(const boost::filesystem::path& file, const std::string& key, CLTuning& tuning);
+    static void store(const boost::filesystem::path& file, const std::string& key, const CLTuning& tuning);
+  };
+
+} /* namespace energi */
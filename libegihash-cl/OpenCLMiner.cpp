@@ -6,6 +6,8 @@
  */
 
 #include "libegihash-cl/OpenCLMiner.h"
+#include "libegihash-cl/CLTuning.h"
+#include "libegihash-cl/CLProgramCache.h"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wignored-attributes"
@@ -17,6 +19,8 @@
 #include "common/Log.h"
 
 #include <algorithm>
+#include <cstring>
+#include <iomanip>
 #include <vector>
 #include <iostream>
 
@@ -219,6 +223,18 @@ std::vector<cl::Device> getDevices(std::vector<cl::Platform> const& _platforms,
         if (err.err() != CL_DEVICE_NOT_FOUND)
             throw err;
     }
+    if (devices.empty()) {
+        // CPU runtimes such as pocl, only used when the platform has nothing better
+        try
+        {
+            _platforms[platform_num].getDevices(CL_DEVICE_TYPE_CPU, &devices);
+        }
+        catch (cl::Error const& err)
+        {
+            if (err.err() != CL_DEVICE_NOT_FOUND)
+                throw err;
+        }
+    }
     return devices;
 }
 
@@ -234,7 +250,14 @@ unsigned OpenCLMiner::s_workgroupSize = OpenCLMiner::c_defaultLocalWorkSize;
 unsigned OpenCLMiner::s_initialGlobalWorkSize = OpenCLMiner::c_defaultGlobalWorkSizeMultiplier * OpenCLMiner::c_defaultLocalWorkSize;
 unsigned OpenCLMiner::s_threadsPerHash = 8;
 bool OpenCLMiner::s_adjustWorkSize = false;
-constexpr size_t c_maxSearchResults = 1;
+bool OpenCLMiner::s_autoTune = false;
+std::mutex OpenCLMiner::x_dagSwitch;
+uint32_t OpenCLMiner::s_dagSwitchEpoch = ~0u;
+unsigned OpenCLMiner::s_dagSwitchPending = 0;
+unsigned OpenCLMiner::s_dagSwitchFailed = 0;
+std::chrono::steady_clock::time_point OpenCLMiner::s_dagSwitchStart;
+// Result slots of ethash_search, the batch size is kept so that a quarter of them is expected to fill
+constexpr size_t c_maxSearchResults = 15;
 
 unsigned OpenCLMiner::s_platformId = 0;
 unsigned OpenCLMiner::s_numInstances = 0;
@@ -255,6 +278,20 @@ struct CLChannel: public LogChannel
 #define cllog clog(CLChannel)
 #define ETHCL_LOG(_contents) cllog << _contents
 
+/// Per pass timing of the search ring, -v 6 to see it
+struct CLPassChannel: public LogChannel
+{
+    static const char* name()
+    {
+        return EthOrange "cl";
+    }
+
+    static const int verbosity = 6;
+    static const bool debug = false;
+};
+
+#define clpasslog clog(CLPassChannel)
+
 struct OpenCLMiner::clInfo
 {
     static std::tuple<bool, cl::Device, int, int, std::string> getDeviceInfo(int index, OpenCLMiner* clMiner);
@@ -267,7 +304,6 @@ struct OpenCLMiner::clInfo
     cl::Buffer              bufferDag_;
     cl::Buffer              bufferLight_;
     cl::Buffer              bufferHeader_;
-    cl::Buffer              searchBuffer_;
 };
 
 OpenCLMiner::OpenCLMiner(const Plant& plant, unsigned index)
@@ -278,6 +314,9 @@ OpenCLMiner::OpenCLMiner(const Plant& plant, unsigned index)
 OpenCLMiner::~OpenCLMiner()
 {
     stopWorking();
+    if (m_prebuild.joinable()) {
+        m_prebuild.join();
+    }
 }
 
 unsigned OpenCLMiner::getNumDevices()
@@ -393,25 +432,162 @@ bool OpenCLMiner::configureGPU(
 }
 
 
+void CL_CALLBACK OpenCLMiner::onSearchComplete(cl_event, cl_int, void* data)
+{
+    // Runs on a runtime thread, only stamps the slot and wakes the miner.
+    // A failed command is reported by the miner when it checks the event.
+    auto& slot = *static_cast<SearchSlot*>(data);
+    OpenCLMiner& miner = *slot.owner;
+    {
+        std::lock_guard<std::mutex> lock(miner.x_searchSlots);
+        slot.completed = std::chrono::steady_clock::now();
+        slot.ready = true;
+    }
+    miner.m_searchReady.notify_all();
+}
+
+void OpenCLMiner::createSearchBuffers()
+{
+    const size_t size = (c_maxSearchResults + 1) * sizeof(uint32_t);
+    for (unsigned i = 0; i < c_searchDepth; ++i) {
+        auto& slot = m_searchSlots[i];
+        slot.owner   = this;
+        slot.index   = i;
+        slot.output  = cl::Buffer(m_context, CL_MEM_WRITE_ONLY, size);
+        slot.pinned  = cl::Buffer(m_context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size);
+        // Mapped for the lifetime of the buffer, reads go straight to page locked memory
+        slot.results = static_cast<uint32_t*>(m_queue.enqueueMapBuffer(slot.pinned, CL_TRUE,
+                                                                       CL_MAP_READ | CL_MAP_WRITE, 0, size));
+        slot.pending = false;
+        slot.ready   = false;
+        slot.work.reset();
+    }
+    m_nextSlot = 0;
+}
+
+void OpenCLMiner::releaseSearchBuffers()
+{
+    for (auto& slot : m_searchSlots) {
+        if (slot.results) {
+            m_queue.enqueueUnmapMemObject(slot.pinned, slot.results);
+            slot.results = nullptr;
+        }
+    }
+    m_queue.finish();
+}
+
+void OpenCLMiner::enqueueSearch(SearchSlot& slot, uint64_t startNonce)
+{
+    slot.work       = m_searchWork;
+    slot.startNonce = startNonce;
+    slot.size       = globalWorkSize_;
+    slot.pending    = true;
+    slot.ready      = false;
+    slot.enqueued   = std::chrono::steady_clock::now();
+
+    m_queue.enqueueWriteBuffer(slot.output, CL_FALSE, 0, sizeof(m_zero), &m_zero);
+    m_searchKernel.setArg(0, slot.output);
+    m_searchKernel.setArg(3, startNonce);
+    m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, globalWorkSize_, workgroupSize_);
+    m_queue.enqueueReadBuffer(slot.output, CL_FALSE, 0, (c_maxSearchResults + 1) * sizeof(uint32_t),
+                              slot.results, nullptr, &slot.done);
+    slot.done.setCallback(CL_COMPLETE, &OpenCLMiner::onSearchComplete, &slot);
+    // Hand the batch to the device now rather than when the host next blocks
+    m_queue.flush();
+}
+
+void OpenCLMiner::collectSearch(SearchSlot& slot)
+{
+    {
+        std::unique_lock<std::mutex> lock(x_searchSlots);
+        m_searchReady.wait(lock, [&] { return slot.ready.load(); });
+    }
+    slot.pending = false;
+    if (slot.done.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() < 0) {
+        throw cl::Error(slot.done.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>(), "ethash_search");
+    }
+
+    // The device sat idle when this batch was queued after the previous one finished
+    using ms = std::chrono::duration<double, std::milli>;
+    const double batch = ms(slot.completed - slot.enqueued).count();
+    const double idle  = m_totalPasses ? std::max(0.0, ms(slot.enqueued - m_lastCompleted).count()) : 0.0;
+    m_lastCompleted = slot.completed;
+    ++m_totalPasses;
+
+    // The kernel keeps counting past the last slot, which it then overwrites
+    const uint32_t reported = slot.results[0];
+    const uint32_t found = std::min<uint32_t>(reported, c_maxSearchResults);
+    if (slot.work) {
+        // Re-evaluated on the plant's verifier threads, the next batch is not held up
+        for (uint32_t i = 1; i <= found; ++i) {
+            verifyNonce(slot.work, slot.startNonce + slot.results[i]);
+        }
+    }
+    slot.work.reset();
+    if (reported > c_maxSearchResults) {
+        ++m_searchOverflows;
+        unsigned smaller = std::max(workgroupSize_, (globalWorkSize_ / 2) / workgroupSize_ * workgroupSize_);
+        cwarn << name() << " " << reported << " candidates in one batch, " << reported - found
+              << " lost (overflow #" << m_searchOverflows << "). Batch size " << globalWorkSize_ << " -> " << smaller;
+        globalWorkSize_ = smaller;
+    }
+
+    clpasslog << name() << " pass " << m_totalPasses << " slot " << slot.index
+              << std::fixed << std::setprecision(2)
+              << " batch " << batch << " ms"
+              << " host " << ms(std::chrono::steady_clock::now() - slot.completed).count() << " ms"
+              << " idle " << idle << " ms";
+
+    const uint8_t kIntervalPasses = 4;  // must be a power of 2 passes
+    m_hashCount += slot.size;
+    if ((++m_searchPasses & (kIntervalPasses - 1)) == 0) {
+        updateHashRate(m_hashCount);
+        m_hashCount = 0;
+    }
+}
+
+void OpenCLMiner::adaptWorkSize(uint64_t target)
+{
+    if (target == m_searchTarget) {
+        return;
+    }
+    m_searchTarget = target;
+    uint64_t limit = std::min<uint64_t>(m_maxGlobalWorkSize, maxBatchForTarget(target, c_maxSearchResults));
+    unsigned size = std::max<unsigned>(workgroupSize_, limit / workgroupSize_ * workgroupSize_);
+    if (size != globalWorkSize_) {
+        cllog << name() << " Batch size " << globalWorkSize_ << " -> " << size << " for the current target";
+        globalWorkSize_ = size;
+    }
+}
+
+void OpenCLMiner::drainSearches()
+{
+    for (unsigned i = 0; i < c_searchDepth; ++i) {
+        auto& slot = m_searchSlots[(m_nextSlot + i) % c_searchDepth];
+        if (slot.pending) {
+            collectSearch(slot);
+        }
+    }
+}
+
 void OpenCLMiner::trun()
 {
     setThreadName("OpenCL");
-    // Memory for zero-ing buffers. Cannot be static because crashes on macOS.
-    uint32_t const c_zero = 0;
     uint64_t startNonce = 0;
 
-    const uint8_t kIntervalPasses = 4;  // must be a power of 2 passes
     // this gives each miner a pretty big range of nonces, supporting up to 16 miners.
     // TODO: get smarter about how many miners we support.
     //uint64_t const nonceSegment = static_cast<uint64_t>(m_index) << (64 - 4);
     try {
         while (!shouldStop()) {
             if (is_mining_paused()) {
+                drainSearches();
                 std::this_thread::sleep_for(std::chrono::seconds(3));
                 continue;
             }
             const Work& work = this->getWork(); // This work is a copy of last assigned work the worker was provided by plant
             if ( !work.isValid() ) {
+                drainSearches();
                 cnote << "No work received. Pause for 1 s.";
                 std::this_thread::sleep_for(std::chrono::seconds(1));
                 if ( this->shouldStop() ) {
@@ -423,6 +599,11 @@ void OpenCLMiner::trun()
             }
             if (m_current != work) {
                 if (!m_dagLoaded || ((work.nHeight / nrghash::constants::EPOCH_LENGTH) != (m_lastHeight / nrghash::constants::EPOCH_LENGTH))) {
+                    // The queue and its buffers are replaced along with the DAG
+                    if (m_dagLoaded) {
+                        drainSearches();
+                        releaseSearchBuffers();
+                    }
                     if (s_dagLoadMode == DAG_LOAD_MODE_SEQUENTIAL) {
                         while (s_dagLoadIndex < m_index)
                             std::this_thread::sleep_for(std::chrono::seconds(1));
@@ -433,68 +614,48 @@ void OpenCLMiner::trun()
                 }
                 m_lastHeight = work.nHeight;
                 m_current = work;
+                m_searchWork = std::make_shared<const Work>(m_current);
                 energi::CBlockHeaderTruncatedLE truncatedBlockHeader(m_current);
                 nrghash::h256_t hash_header(&truncatedBlockHeader, sizeof(truncatedBlockHeader));
 
                 // Upper 64 bits of the boundary.
-                const uint64_t target = *reinterpret_cast<uint64_t const *>((m_current.hashTarget >> 192).data());
+                const uint64_t target = m_current.upper64OfBoundary;
                 assert(target > 0);
 
-                // Update header constant buffer.
-                m_queue.enqueueWriteBuffer(m_header, CL_FALSE, 0, hash_header.hash_size, &hash_header.b[0]);
-                m_queue.enqueueWriteBuffer(m_searchBuffer, CL_FALSE, 0, sizeof(c_zero), &c_zero);
-
-                m_searchKernel.setArg(0, m_searchBuffer);  // Supply output buffer to kernel.
+                // Update header constant buffer. Blocking as the source is a local, this waits
+                // for the batches already queued but those searched the old header anyway.
+                m_queue.enqueueWriteBuffer(m_header, CL_TRUE, 0, hash_header.hash_size, &hash_header.b[0]);
                 m_searchKernel.setArg(4, target);
+                adaptWorkSize(target);
 
                 startNonce = m_plant.getStartNonce(m_current, m_index);
             }
 
-            // Run the kernel.
-            m_searchKernel.setArg(3, startNonce);
-            m_queue.enqueueNDRangeKernel(m_searchKernel, cl::NullRange, globalWorkSize_, workgroupSize_);
-
-            // Read results.
-            // TODO: could use pinned host pointer instead.
-            uint32_t results[c_maxSearchResults + 1] = { 0 };
-            m_queue.enqueueReadBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(results), &results);
-
-            uint64_t nonce = 0;
-            if (results[0] > 0) {
-                // Ignore results except the first one.
-                nonce = startNonce + results[1];
-                // Reset search buffer if any solution found.
-                m_queue.enqueueWriteBuffer(m_searchBuffer, CL_TRUE, 0, sizeof(c_zero), &c_zero);
+            // Retire the oldest batch while the newer ones keep the device busy,
+            // then reuse its slot for the next range.
+            auto& slot = m_searchSlots[m_nextSlot];
+            if (slot.pending) {
+                collectSearch(slot);
             }
+            enqueueSearch(slot, startNonce);
+            m_nextSlot = (m_nextSlot + 1) % c_searchDepth;
 
-            // Report results while the kernel is running.
-            // It takes some time because proof of work must be re-evaluated on CPU.
-            if (nonce != 0) {
-                m_current.nNonce = nonce;
-                auto const powHash = GetPOWHash(m_current);
-                if (UintToArith256(powHash) <= m_current.hashTarget) {
-                    cllog << name() << " Submitting block blockhash: " << m_current.GetHash().ToString() << " height: " << m_current.nHeight << " nonce: " << nonce;
-                    Solution solution(m_current, m_current.getSecondaryExtraNonce());
-                    m_plant.submitProof(solution);
-                } else {
-                    cwarn << name() << " CL Miner proposed invalid solution: " << m_current.GetHash().ToString() << " nonce: " << nonce;
-                }
-            }
             // Increase start nonce for following kernel execution.
             startNonce += globalWorkSize_;
-            m_hashCount += globalWorkSize_;
-            if ((++m_searchPasses & (kIntervalPasses - 1)) == 0) {
-                updateHashRate(m_hashCount);
-                m_hashCount = 0;
-            }
-
-            // Make sure the last buffer write has finished --
-            // it reads local variable.
-            m_queue.finish();
         }
+        drainSearches();
         m_queue.finish();
     } catch (cl::Error const& _e) {
         cwarn << name() << " OpenCL Error: " << CLErrorHelper(_e);
+        try {
+            // Callbacks still reference the slots
+            m_queue.finish();
+        } catch (cl::Error const&) {
+        }
+        for (auto& slot : m_searchSlots) {
+            slot.pending = false;
+            slot.work.reset();
+        }
     }
 }
 
@@ -569,12 +730,258 @@ std::tuple<bool, cl::Device, int, int, std::string> OpenCLMiner::getDeviceInfo(i
     return std::make_tuple(true, device, platformId, computeCapability, std::string(options));
 }
 
+std::string OpenCLMiner::kernelSource(const DeviceInfo& deviceResult, unsigned groupSize,
+                                      uint32_t dagSize128, uint32_t lightSize64)
+{
+    // patch source code
+    // note: CLMiner_kernel is simply ethash_cl_miner_kernel.cl compiled
+    // into a byte array by bin2h.cmake. There is no need to load the file by hand in runtime
+    // TODO: Just use C++ raw string literal.
+    std::string code(CLMiner_kernel, CLMiner_kernel + sizeof(CLMiner_kernel));
+
+    addDefinition(code, "GROUP_SIZE", groupSize);
+    addDefinition(code, "DAG_SIZE", dagSize128);
+    addDefinition(code, "LIGHT_SIZE", lightSize64);
+    addDefinition(code, "ACCESSES", nrghash::constants::ACCESSES);
+    addDefinition(code, "MAX_OUTPUTS", c_maxSearchResults);
+    addDefinition(code, "PLATFORM", std::get<2>(deviceResult));
+    addDefinition(code, "COMPUTE", std::get<3>(deviceResult));
+    addDefinition(code, "THREADS_PER_HASH", 8); // going to be set to 8 by the kernel either way , kernel only supports 8
+    return code;
+}
+
+bool OpenCLMiner::buildProgram(const cl::Device& device, const DeviceInfo& deviceResult, unsigned groupSize,
+                               uint32_t dagSize128, uint32_t lightSize64, cl::Program& program)
+{
+    const std::string code = kernelSource(deviceResult, groupSize, dagSize128, lightSize64);
+    const std::string& options = std::get<4>(deviceResult);
+    const boost::filesystem::path file = CLProgramCache::file(GetDataDir() / "clcache",
+        device.getInfo<CL_DEVICE_NAME>(), device.getInfo<CL_DRIVER_VERSION>(), options, code);
+
+    std::vector<unsigned char> binary;
+    if (CLProgramCache::load(file, binary)) {
+        try {
+            program = cl::Program(m_context, {device}, cl::Program::Binaries{binary});
+            program.build({device}, options.c_str());
+            cllog << name() << " Loaded program " << file.filename().string();
+            return true;
+        } catch (cl::Error const& err) {
+            // Usually a driver update the version string did not reflect
+            cwarn << name() << " Cached program " << file.string() << " rejected: " << CLErrorHelper(err);
+            CLProgramCache::discard(file);
+        }
+    }
+
+    auto const start = std::chrono::steady_clock::now();
+    cl::Program::Sources sources{{code.data(), code.size()}};
+    program = cl::Program(m_context, sources);
+    try {
+        program.build({device}, options.c_str());
+    } catch (cl::Error const&) {
+        cwarn << name() << " Build info: " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
+        cwarn << name() << " Failed" ;
+        return false;
+    }
+    cllog << name() << " Built program in " << std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count() << " ms";
+
+    auto const binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+    if (!binaries.empty()) {
+        CLProgramCache::store(file, binaries.front());
+    }
+    return true;
+}
+
+void OpenCLMiner::prebuildProgram(const cl::Device& device, const DeviceInfo& deviceResult, uint32_t epoch)
+{
+    uint64_t const height = uint64_t(epoch + 1) * nrghash::constants::EPOCH_LENGTH;
+    uint32_t const dagSize128 = (uint32_t)(nrghash::dag_t::get_full_size(height) / nrghash::constants::MIX_BYTES);
+    uint32_t const lightSize64 = (uint32_t)(nrghash::cache_t::get_cache_size(height) / nrghash::constants::HASH_BYTES);
+    unsigned const groupSize = workgroupSize_;
+
+    if (m_prebuild.joinable()) {
+        m_prebuild.join();
+    }
+    // Built against the current context, it only ends up in the binary cache
+    m_prebuild = std::thread([this, device, deviceResult, groupSize, dagSize128, lightSize64, epoch]() {
+        try {
+            cl::Program program;
+            if (buildProgram(device, deviceResult, groupSize, dagSize128, lightSize64, program)) {
+                cllog << name() << " Program for epoch #" << epoch + 1 << " is ready";
+            }
+        } catch (cl::Error const& err) {
+            cwarn << name() << " Building the program for epoch #" << epoch + 1 << " failed: " << CLErrorHelper(err);
+        }
+    });
+}
+
+void OpenCLMiner::autoTune(const cl::Device& device, const DeviceInfo& deviceResult, uint32_t epoch,
+                           uint32_t dagSize128, uint32_t lightSize64)
+{
+    const boost::filesystem::path file = GetDataDir() / "cltune.json";
+    const std::string key = CLTuningCache::key(device.getInfo<CL_DEVICE_NAME>(),
+                                               device.getInfo<CL_DRIVER_VERSION>(), epoch);
+    CLTuning best;
+    if (CLTuningCache::find(file, key, best)) {
+        cllog << name() << " Using tuned local work " << best.localWorkSize
+              << ", global work " << best.globalWorkSizeMultiplier << " from " << file.string();
+    } else {
+        cllog << name() << " Auto-tuning " << key;
+        const size_t maxGroupSize = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+        for (unsigned groupSize : { 64u, 128u, 256u }) {
+            cl::Program program;
+            if (groupSize > maxGroupSize || !buildProgram(device, deviceResult, groupSize, dagSize128, lightSize64, program)) {
+                continue;
+            }
+            cl::Kernel kernel(program, "ethash_search");
+            kernel.setArg(0, m_searchSlots[0].output);
+            kernel.setArg(1, m_header);
+            kernel.setArg(2, m_dag);
+            kernel.setArg(3, uint64_t(0));
+            kernel.setArg(4, uint64_t(1));  // nothing will be found
+            kernel.setArg(5, ~0u);
+            for (unsigned multiplier = c_tuneMinMultiplier; multiplier <= c_tuneMaxMultiplier; multiplier *= 2) {
+                const unsigned size = groupSize * multiplier;
+                // The first pass pays for the kernel warmup and is not timed
+                m_queue.enqueueNDRangeKernel(kernel, cl::NullRange, size, groupSize);
+                m_queue.finish();
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned pass = 0; pass < c_tunePasses; ++pass) {
+                    m_queue.enqueueNDRangeKernel(kernel, cl::NullRange, size, groupSize);
+                }
+                m_queue.finish();
+                const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                const double rate = seconds > 0 ? double(size) * c_tunePasses / seconds : 0;
+                cllog << name() << " local " << groupSize << " global " << multiplier << ": "
+                      << std::fixed << std::setprecision(2) << rate / 1000000.0 << " Mh/s";
+                if (rate > best.hashRate) {
+                    best.localWorkSize = groupSize;
+                    best.globalWorkSizeMultiplier = multiplier;
+                    best.hashRate = rate;
+                }
+                // Larger batches only make the miner slower to react to new work
+                if (seconds / c_tunePasses > c_tuneMaxPassSeconds) {
+                    break;
+                }
+            }
+        }
+        if (!best.localWorkSize) {
+            cwarn << name() << " Auto-tuning failed, keeping local work " << workgroupSize_;
+            return;
+        }
+        cllog << name() << " Tuned local work " << best.localWorkSize << ", global work "
+              << best.globalWorkSizeMultiplier << ", saved to " << file.string();
+        CLTuningCache::store(file, key, best);
+    }
+
+    if (best.localWorkSize != workgroupSize_) {
+        cl::Program program;
+        if (!buildProgram(device, deviceResult, best.localWorkSize, dagSize128, lightSize64, program)) {
+            return;
+        }
+        m_searchKernel = cl::Kernel(program, "ethash_search");
+        m_searchKernel.setArg(1, m_header);
+        m_searchKernel.setArg(2, m_dag);
+        m_searchKernel.setArg(5, ~0u);
+        workgroupSize_ = best.localWorkSize;
+    }
+    globalWorkSize_ = m_maxGlobalWorkSize = best.localWorkSize * best.globalWorkSizeMultiplier;
+}
+
+void OpenCLMiner::dagSwitchBegin(uint32_t epoch)
+{
+    std::lock_guard<std::mutex> lock(x_dagSwitch);
+    if (epoch != s_dagSwitchEpoch) {
+        s_dagSwitchEpoch = epoch;
+        s_dagSwitchPending = instances();
+        s_dagSwitchFailed = 0;
+        s_dagSwitchStart = std::chrono::steady_clock::now();
+    }
+}
+
+void OpenCLMiner::dagSwitchEnd(uint32_t epoch, bool loaded)
+{
+    static const char* const modes[] = { "parallel", "sequential", "single", "host" };
+
+    std::lock_guard<std::mutex> lock(x_dagSwitch);
+    if (epoch != s_dagSwitchEpoch || !s_dagSwitchPending) {
+        return;
+    }
+    if (!loaded) {
+        ++s_dagSwitchFailed;
+    }
+    if (--s_dagSwitchPending == 0) {
+        auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - s_dagSwitchStart).count();
+        cnote << "DAG for epoch #" << epoch << " ready on " << instances() - s_dagSwitchFailed << "/"
+              << instances() << " devices in " << ms << " ms ("
+              << (s_dagLoadMode < sizeof(modes) / sizeof(modes[0]) ? modes[s_dagLoadMode] : "unknown")
+              << " load mode)";
+    }
+}
+
+void OpenCLMiner::uploadHostDAG(const HostDAG& host)
+{
+    auto const start = std::chrono::steady_clock::now();
+    uint64_t const dagSize = host.dagSize();
+    size_t const chunk = static_cast<size_t>(std::min<uint64_t>(c_dagUploadChunk, dagSize));
+
+    // The copy out of the mapping into one staging buffer overlaps the DMA out of the other
+    cl::Buffer staging[2];
+    void* pinned[2];
+    cl::Event written[2];
+    for (unsigned i = 0; i < 2; ++i) {
+        staging[i] = cl::Buffer(m_context, CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR, chunk);
+        pinned[i] = m_queue.enqueueMapBuffer(staging[i], CL_TRUE, CL_MAP_WRITE, 0, chunk);
+    }
+    unsigned current = 0;
+    for (uint64_t offset = 0; offset < dagSize; offset += chunk) {
+        size_t const bytes = static_cast<size_t>(std::min<uint64_t>(chunk, dagSize - offset));
+        if (written[current]()) {
+            written[current].wait();
+        }
+        std::memcpy(pinned[current], host.dag() + offset, bytes);
+        m_queue.enqueueWriteBuffer(m_dag, CL_FALSE, offset, bytes, pinned[current], nullptr, &written[current]);
+        m_queue.flush();
+        current ^= 1;
+    }
+    for (unsigned i = 0; i < 2; ++i) {
+        m_queue.enqueueUnmapMemObject(staging[i], pinned[i]);
+    }
+    m_queue.finish();
+
+    auto const ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    cllog << name() << " Uploaded " << FormattedMemSize(dagSize) << " of DAG in " << ms << " ms ("
+          << std::fixed << std::setprecision(2) << (ms ? dagSize / (ms * 1.0e6) : 0.0) << " GB/s)";
+}
+
 bool OpenCLMiner::init_dag(uint32_t height)
 {
+    uint32_t const epoch = height / nrghash::constants::EPOCH_LENGTH;
+    dagSwitchBegin(epoch);
+    bool const loaded = createDag(height);
+    dagSwitchEnd(epoch, loaded);
+    return loaded;
+}
+
+bool OpenCLMiner::createDag(uint32_t height)
+{
+    // The context is about to be replaced, and the program built ahead is likely the one needed
+    if (m_prebuild.joinable()) {
+        m_prebuild.join();
+    }
     // get all platforms
     try {
         uint32_t const epoch = height / nrghash::constants::EPOCH_LENGTH;
-        cllog << name() << " Generating DAG for epoch #" << epoch;
+        std::shared_ptr<const HostDAG> host;
+        if (s_dagLoadMode == DAG_LOAD_MODE_HOST) {
+            host = HostDAG::acquire(epoch);
+            if (!host) {
+                cwarn << name() << " No host DAG for epoch #" << epoch << ", generating it on the device";
+            }
+        }
+        cllog << name() << (host ? " Loading" : " Generating") << " DAG for epoch #" << epoch;
         auto deviceResult = getDeviceInfo(m_index);
         // create context
         auto device = std::get<1>(deviceResult);
@@ -600,44 +1007,30 @@ bool OpenCLMiner::init_dag(uint32_t height)
                     << " Adjusted work multiplier: " << globalWorkSize_ / workgroupSize_;
             }
         }
-        nrghash::cache_t  cache = nrghash::cache_t(height);
+        // The light cache comes straight out of the host mapping when there is one
+        std::vector<uint32_t> vData;
+        if (!host) {
+            nrghash::cache_t  cache = nrghash::cache_t(height);
+            for (auto &d : cache.data()) {
+                for ( auto &dv : d) {
+                    vData.push_back(dv.hword);
+                }
+            }
+        }
+        uint32_t const* lightData = host ? reinterpret_cast<uint32_t const*>(host->cache()) : vData.data();
+        size_t const lightBytes = host ? host->cacheSize() : sizeof(uint32_t) * vData.size();
         uint64_t dagSize = nrghash::dag_t::get_full_size(height);//dag->size();
         uint32_t dagSize128 = (unsigned)(dagSize / nrghash::constants::MIX_BYTES);
-        uint32_t lightSize64 = (unsigned)(cache.data().size()); //dag->get_cache().data().size();
-        // patch source code
-        // note: CLMiner_kernel is simply ethash_cl_miner_kernel.cl compiled
-        // into a byte array by bin2h.cmake. There is no need to load the file by hand in runtime
-        // TODO: Just use C++ raw string literal.
-        std::string code(CLMiner_kernel, CLMiner_kernel + sizeof(CLMiner_kernel));
-
-        addDefinition(code, "GROUP_SIZE", workgroupSize_);
-        addDefinition(code, "DAG_SIZE", dagSize128);
-        addDefinition(code, "LIGHT_SIZE", lightSize64);
-        addDefinition(code, "ACCESSES", nrghash::constants::ACCESSES);
-        addDefinition(code, "MAX_OUTPUTS", c_maxSearchResults);
-        addDefinition(code, "PLATFORM", std::get<2>(deviceResult));
-        addDefinition(code, "COMPUTE", std::get<3>(deviceResult));
-        addDefinition(code, "THREADS_PER_HASH", 8); // going to be set to 8 by the kernel either way , kernel only supports 8
+        uint32_t lightSize64 = (unsigned)(lightBytes / nrghash::constants::HASH_BYTES);
+        m_maxGlobalWorkSize = globalWorkSize_;
+        m_searchTarget = 0;
 
         // create miner OpenCL program
-        cl::Program::Sources sources{{code.data(), code.size()}};
-        cl::Program program(m_context, sources);
-        try {
-            program.build({device}, std::get<4>(deviceResult).c_str());
-        } catch (cl::Error const&) {
-            cwarn << name() << " Build info: " << program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device);
-            cwarn << name() << " Failed" ;
+        cl::Program program;
+        if (!buildProgram(device, deviceResult, workgroupSize_, dagSize128, lightSize64, program)) {
             return false;
         }
 
-        // create buffer for dag
-        std::vector<uint32_t> vData;
-        for (auto &d : cache.data()) {
-            for ( auto &dv : d) {
-                vData.push_back(dv.hword);
-            }
-        }
-
         cl_ulong result = 0;
         device.getInfo(CL_DEVICE_GLOBAL_MEM_SIZE, &result);
         if (result < dagSize) {
@@ -647,7 +1040,7 @@ bool OpenCLMiner::init_dag(uint32_t height)
             return false;
         }
         try {
-            m_light      = cl::Buffer(m_context, CL_MEM_READ_ONLY, sizeof(uint32_t) * vData.size());
+            m_light      = cl::Buffer(m_context, CL_MEM_READ_ONLY, lightBytes);
             m_dag        = cl::Buffer(m_context, CL_MEM_READ_ONLY, dagSize);
 
             m_searchKernel     = cl::Kernel(program, "ethash_search");
@@ -655,7 +1048,7 @@ bool OpenCLMiner::init_dag(uint32_t height)
 
             //ETHCL_LOG("Creating light buffer");
 
-            m_queue.enqueueWriteBuffer(m_light, CL_TRUE, 0, sizeof(uint32_t) * vData.size(), vData.data());
+            m_queue.enqueueWriteBuffer(m_light, CL_TRUE, 0, lightBytes, lightData);
         } catch (cl::Error const& err) {
             cwarn << name() << "Creating DAG buffer failed: " << err.what() << err.err();
             return false;
@@ -671,26 +1064,35 @@ bool OpenCLMiner::init_dag(uint32_t height)
 
         // create mining buffers
         //ETHCL_LOG("Creating mining buffer");
-        m_searchBuffer = cl::Buffer(m_context, CL_MEM_WRITE_ONLY, (c_maxSearchResults + 1) * sizeof(uint32_t));
+        createSearchBuffers();
 
-        uint32_t const work = (uint32_t)(dagSize / sizeof(nrghash::node));
-        uint32_t fullRuns = work / globalWorkSize_;
-        uint32_t const restWork = work % globalWorkSize_;
-        if (restWork > 0) {
-            fullRuns++;
-        }
+        if (host) {
+            uploadHostDAG(*host);
+        } else {
+            uint32_t const work = (uint32_t)(dagSize / sizeof(nrghash::node));
+            uint32_t fullRuns = work / globalWorkSize_;
+            uint32_t const restWork = work % globalWorkSize_;
+            if (restWork > 0) {
+                fullRuns++;
+            }
 
-        m_dagKernel.setArg(1, m_light);
-        m_dagKernel.setArg(2, m_dag);
-        m_dagKernel.setArg(3, ~0u);
+            m_dagKernel.setArg(1, m_light);
+            m_dagKernel.setArg(2, m_dag);
+            m_dagKernel.setArg(3, ~0u);
 
-        for (uint32_t i = 0; i < fullRuns; ++i) {
-            m_dagKernel.setArg(0, i * globalWorkSize_);
-            m_queue.enqueueNDRangeKernel(m_dagKernel, cl::NullRange, globalWorkSize_, workgroupSize_);
-            m_queue.finish();
+            for (uint32_t i = 0; i < fullRuns; ++i) {
+                m_dagKernel.setArg(0, i * globalWorkSize_);
+                m_queue.enqueueNDRangeKernel(m_dagKernel, cl::NullRange, globalWorkSize_, workgroupSize_);
+                m_queue.finish();
+            }
         }
 
-        cllog << name() << " Generating DAG for epoch #" << epoch << " finished.";
+        cllog << name() << (host ? " Loading" : " Generating") << " DAG for epoch #" << epoch << " finished.";
+
+        if (s_autoTune) {
+            autoTune(device, deviceResult, epoch, dagSize128, lightSize64);
+        }
+        prebuildProgram(device, deviceResult, epoch);
 
     } catch (cl::Error const& err) {
         cwarn << name() << err.what() << " (" << err.err() << ")";
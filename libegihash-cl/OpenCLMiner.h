@@ -8,9 +8,17 @@
 
 #include "nrgcore/plant.h"
 #include "nrgcore/miner.h"
+#include "nrgcore/hostdag.h"
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <thread>
 #include <tuple>
 
 #pragma GCC diagnostic push
@@ -52,6 +60,10 @@ namespace energi
     static const unsigned c_defaultLocalWorkSize = 128;
     /// Default value of the global work size as a multiplier of the local work size
     static const unsigned c_defaultGlobalWorkSizeMultiplier = 8192;
+    /// Number of search batches kept in flight, the device works on one while the host reads another
+    static const unsigned c_searchDepth = 2;
+    /// Size of each of the two pinned staging buffers a host DAG is uploaded through
+    static const size_t c_dagUploadChunk = 64 * 1024 * 1024;
 
 
     OpenCLMiner(const Plant& plant, unsigned index);
@@ -82,7 +94,14 @@ namespace energi
       s_threadsPerHash = _threadsPerHash;
     }
 
-    std::tuple<bool, cl::Device, int, int, std::string> getDeviceInfo(int index);
+    /// Sweep the work sizes per device instead of using the configured ones
+    static void setAutoTune(bool _autoTune)
+    {
+      s_autoTune = _autoTune;
+    }
+
+    using DeviceInfo = std::tuple<bool, cl::Device, int, int, std::string>;
+    DeviceInfo getDeviceInfo(int index);
 
     static void setDevices(const std::vector<unsigned>& _devices, unsigned _selectedDeviceCount)
     {
@@ -99,6 +118,55 @@ namespace energi
     void onSetWork() override {}
 
     bool init_dag(uint32_t height);
+    bool createDag(uint32_t height);
+    void uploadHostDAG(const HostDAG& host);
+    static void dagSwitchBegin(uint32_t epoch);
+    static void dagSwitchEnd(uint32_t epoch, bool loaded);
+    static std::string kernelSource(const DeviceInfo& deviceResult, unsigned groupSize,
+                                    uint32_t dagSize128, uint32_t lightSize64);
+    /// Loads the program from the binary cache, or builds it from source and caches it
+    bool buildProgram(const cl::Device& device, const DeviceInfo& deviceResult, unsigned groupSize,
+                      uint32_t dagSize128, uint32_t lightSize64, cl::Program& program);
+    /// Builds the program of the epoch after this one in the background
+    void prebuildProgram(const cl::Device& device, const DeviceInfo& deviceResult, uint32_t epoch);
+    void autoTune(const cl::Device& device, const DeviceInfo& deviceResult, uint32_t epoch,
+                  uint32_t dagSize128, uint32_t lightSize64);
+
+    /* -- auto-tune sweep -- */
+    static const unsigned c_tuneMinMultiplier = 256;
+    static const unsigned c_tuneMaxMultiplier = 32768;
+    static const unsigned c_tunePasses = 3;
+    static constexpr double c_tuneMaxPassSeconds = 0.5;
+
+    /**
+     * @brief One batch of the search ring. The results land in pinned host
+     *        memory mapped once at DAG creation, the completion callback of
+     *        the read marks the slot ready.
+     */
+    struct SearchSlot
+    {
+        OpenCLMiner*                          owner = nullptr;
+        unsigned                              index = 0;
+        cl::Buffer                            output;     // written by the kernel
+        cl::Buffer                            pinned;     // CL_MEM_ALLOC_HOST_PTR staging
+        uint32_t*                             results = nullptr;
+        cl::Event                             done;
+        std::shared_ptr<const Work>           work;
+        uint64_t                              startNonce = 0;
+        unsigned                              size = 0;       // nonces in the batch
+        bool                                  pending = false;
+        std::atomic<bool>                     ready = { false };
+        std::chrono::steady_clock::time_point enqueued;
+        std::chrono::steady_clock::time_point completed;
+    };
+
+    static void CL_CALLBACK onSearchComplete(cl_event event, cl_int status, void* data);
+    void createSearchBuffers();
+    void releaseSearchBuffers();
+    void enqueueSearch(SearchSlot& slot, uint64_t startNonce);
+    void collectSearch(SearchSlot& slot);
+    void drainSearches();
+    void adaptWorkSize(uint64_t target);
 
     struct clInfo;
     clInfo * cl;
@@ -110,13 +178,27 @@ namespace energi
 	cl::Buffer m_dag;
 	cl::Buffer m_light;
 	cl::Buffer m_header;
-	cl::Buffer m_searchBuffer;
+
+    std::array<SearchSlot, c_searchDepth> m_searchSlots;
+    unsigned                m_nextSlot = 0;
+    std::mutex              x_searchSlots;
+    std::condition_variable m_searchReady;
+    std::shared_ptr<const Work> m_searchWork;
+    std::chrono::steady_clock::time_point m_lastCompleted;
+    // Memory for zero-ing buffers. Cannot be static because crashes on macOS.
+    uint32_t const          m_zero = 0;
 
     uint64_t m_hashCount = 0;
     uint8_t m_searchPasses = 0;
+    uint64_t m_totalPasses = 0;
 
     unsigned                globalWorkSize_ = 0;
     unsigned                workgroupSize_ = 0;
+    /// Configured global work size, the batch only ever shrinks below it
+    unsigned                m_maxGlobalWorkSize = 0;
+    uint64_t                m_searchTarget = 0;
+    uint64_t                m_searchOverflows = 0;
+    std::thread             m_prebuild;
 
     static std::mutex       m_device_mutex;
 
@@ -130,6 +212,14 @@ namespace energi
     /// The initial global work size for the searches
     static unsigned         s_initialGlobalWorkSize;
     static bool s_adjustWorkSize;
+    static bool s_autoTune;
+
+    /* -- rig wide DAG switch, from the first device starting to the last one done -- */
+    static std::mutex       x_dagSwitch;
+    static uint32_t         s_dagSwitchEpoch;
+    static unsigned         s_dagSwitchPending;
+    static unsigned         s_dagSwitchFailed;
+    static std::chrono::steady_clock::time_point s_dagSwitchStart;
 
   };
 
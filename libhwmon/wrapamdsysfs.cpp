@@ -15,9 +15,10 @@
 #include <algorithm>
 #include <fstream>
 #include <sys/types.h>
-#include <regex>
 #if defined(__linux)
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 #include <common/Log.h>
@@ -40,6 +41,47 @@ static bool getFileContentValue(const char* filename, unsigned int& value)
 	return (p != p2);
 }
 
+#if defined(__linux)
+/*
+ * Reads a sensor file through a descriptor kept open across samples.
+ * sysfs regenerates the content on every read from offset 0, so a pread
+ * replaces the open, read and close of an ifstream per value.
+ */
+static bool readSensorFile(int& fd, const char* filename, char* buf, size_t bufsize)
+{
+	if (fd == -2)
+		return false;
+	if (fd < 0) {
+		fd = open(filename, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			fd = -2;
+			return false;
+		}
+	}
+	ssize_t n = pread(fd, buf, bufsize - 1, 0);
+	if (n <= 0) {
+		// The device went away, try opening again on the next sample
+		close(fd);
+		fd = -1;
+		return false;
+	}
+	buf[n] = 0;
+	return true;
+}
+
+static bool readSensorValue(int& fd, const char* filename, unsigned int& value)
+{
+	char buf[32];
+	value = 0;
+	if (!readSensorFile(fd, filename, buf, sizeof(buf)))
+		return false;
+	char* p2;
+	errno = 0;
+	value = strtoul(buf, &p2, 0);
+	return errno == 0 && p2 != buf;
+}
+#endif
+
 wrap_amdsysfs_handle * wrap_amdsysfs_create()
 {
 	wrap_amdsysfs_handle *sysfsh = NULL;
@@ -146,6 +188,35 @@ wrap_amdsysfs_handle * wrap_amdsysfs_create()
 		sysfsh->sysfs_hwmon_id[i] = hwmonIndex;
 	}
 
+	sysfsh->fd_temp = (int*)malloc(sysfsh->sysfs_gpucount * sizeof(int));
+	sysfsh->fd_pwm = (int*)malloc(sysfsh->sysfs_gpucount * sizeof(int));
+	sysfsh->fd_power = (int*)malloc(sysfsh->sysfs_gpucount * sizeof(int));
+	sysfsh->pwm_max = (unsigned int*)malloc(sysfsh->sysfs_gpucount * sizeof(unsigned int));
+	sysfsh->pwm_min = (unsigned int*)malloc(sysfsh->sysfs_gpucount * sizeof(unsigned int));
+	for (int i = 0; i < sysfsh->sysfs_gpucount; i++)
+	{
+		sysfsh->fd_temp[i] = sysfsh->fd_pwm[i] = sysfsh->fd_power[i] = -1;
+		sysfsh->pwm_max[i] = 255;
+		sysfsh->pwm_min[i] = 0;
+
+		int fd = -1;
+		unsigned int pwm = 0;
+		snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1_max",
+			sysfsh->card_sysfs_device_id[i], sysfsh->sysfs_hwmon_id[i]);
+		if (readSensorValue(fd, dbuf, pwm))
+			sysfsh->pwm_max[i] = pwm;
+		if (fd >= 0)
+			close(fd);
+
+		fd = -1;
+		snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1_min",
+			sysfsh->card_sysfs_device_id[i], sysfsh->sysfs_hwmon_id[i]);
+		if (readSensorValue(fd, dbuf, pwm))
+			sysfsh->pwm_min[i] = pwm;
+		if (fd >= 0)
+			close(fd);
+	}
+
 	sysfsh->opencl_gpucount = 0;
 	sysfsh->sysfs_opencl_device_id = (int*)calloc(sysfsh->sysfs_gpucount, sizeof(int));
 #if NRGHASHCL
@@ -242,6 +313,26 @@ wrap_amdsysfs_handle * wrap_amdsysfs_create()
 }
 int wrap_amdsysfs_destroy(wrap_amdsysfs_handle *sysfsh)
 {
+#if defined(__linux)
+	if (sysfsh->fd_temp) {
+		for (int i = 0; i < sysfsh->sysfs_gpucount; i++)
+		{
+			int fds[] = { sysfsh->fd_temp[i], sysfsh->fd_pwm[i], sysfsh->fd_power[i] };
+			for (int fd : fds)
+				if (fd >= 0)
+					close(fd);
+		}
+	}
+#endif
+	free(sysfsh->fd_temp);
+	free(sysfsh->fd_pwm);
+	free(sysfsh->fd_power);
+	free(sysfsh->pwm_max);
+	free(sysfsh->pwm_min);
+	free(sysfsh->card_sysfs_device_id);
+	free(sysfsh->sysfs_hwmon_id);
+	free(sysfsh->sysfs_opencl_device_id);
+	free(sysfsh->opencl_sysfs_device_id);
 	free(sysfsh);
 	return 0;
 }
@@ -278,89 +369,87 @@ int wrap_amdsysfs_get_gpu_pci_id(wrap_amdsysfs_handle *sysfsh, int index, char *
 
 int wrap_amdsysfs_get_tempC(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *tempC)
 {
+	if (index < 0 || index >= sysfsh->sysfs_gpucount)
+		return -1;
 	int gpuindex = sysfsh->card_sysfs_device_id[index];
-	if (gpuindex < 0 || index >= sysfsh->sysfs_gpucount)
+	if (gpuindex < 0)
 		return -1;
 
 	int hwmonindex = sysfsh->sysfs_hwmon_id[index];
 	if (hwmonindex < 0)
 		return -1;
 
+#if defined(__linux)
 	char dbuf[120];
 	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/temp1_input",
 		gpuindex, hwmonindex);
 
 	unsigned int temp = 0;
-	getFileContentValue(dbuf, temp);
+	readSensorValue(sysfsh->fd_temp[index], dbuf, temp);
 
 	if (temp > 0)
 		*tempC = temp / 1000;
+#endif
 
 	return 0;
 }
 
 int wrap_amdsysfs_get_fanpcnt(wrap_amdsysfs_handle *sysfsh, int index, unsigned int *fanpcnt)
 {
+	if (index < 0 || index >= sysfsh->sysfs_gpucount)
+		return -1;
 	int gpuindex = sysfsh->card_sysfs_device_id[index];
-	if (gpuindex < 0 || index >= sysfsh->sysfs_gpucount)
+	if (gpuindex < 0)
 		return -1;
 
 	int hwmonindex = sysfsh->sysfs_hwmon_id[index];
 	if (hwmonindex < 0)
 		return -1;
 
-	unsigned int pwm = 0, pwmMax = 255, pwmMin = 0;
+#if defined(__linux)
+	unsigned int pwm = 0, pwmMax = sysfsh->pwm_max[index], pwmMin = sysfsh->pwm_min[index];
 
 	char dbuf[120];
 	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1",
 		gpuindex, hwmonindex);
-	getFileContentValue(dbuf, pwm);
-
-	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1_max",
-		gpuindex, hwmonindex);
-	getFileContentValue(dbuf, pwmMax);
-
-	snprintf(dbuf, 120, "/sys/class/drm/card%u/device/hwmon/hwmon%u/pwm1_min",
-		gpuindex, hwmonindex);
-	getFileContentValue(dbuf, pwmMin);
+	readSensorValue(sysfsh->fd_pwm[index], dbuf, pwm);
 
+	if (pwmMax <= pwmMin || pwm < pwmMin)
+		return -1;
 	*fanpcnt = (unsigned int)(double(pwm - pwmMin) / double(pwmMax - pwmMin) * 100.0);
+#endif
 	return 0;
 }
 
 int wrap_amdsysfs_get_power_usage(wrap_amdsysfs_handle* sysfsh, int index, unsigned int* milliwatts)
 {
-    try
-    {
-        int gpuindex = sysfsh->card_sysfs_device_id[index];
-        if (gpuindex < 0 || index >= sysfsh->sysfs_gpucount)
-            return -1;
-
-        char dbuf[120];
-        snprintf(dbuf, 120, "/sys/kernel/debug/dri/%u/amdgpu_pm_info", gpuindex);
-
-        std::ifstream ifs(dbuf, std::ios::binary);
-        std::string line;
-
-        while (std::getline(ifs, line))
-        {
-            std::smatch sm;
-            std::regex regex(R"(([\d|\.]+) W \(average GPU\))");
-            if (std::regex_search(line, sm, regex))
-            {
-                if (sm.size() == 2)
-                {
-                    double watt = atof(sm.str(1).c_str());
-                    *milliwatts = (unsigned int)(watt * 1000);
-                    return 0;
-                }
-            }
-        }
-    }
-    catch (const std::exception& ex)
-    {
-        cwarn << "Error in amdsysfs_get_power_usage: " << ex.what();
-    }
+    if (index < 0 || index >= sysfsh->sysfs_gpucount)
+        return -1;
+    int gpuindex = sysfsh->card_sysfs_device_id[index];
+    if (gpuindex < 0)
+        return -1;
 
+#if defined(__linux)
+    char dbuf[120];
+    snprintf(dbuf, 120, "/sys/kernel/debug/dri/%u/amdgpu_pm_info", gpuindex);
+
+    char info[4096];
+    if (!readSensorFile(sysfsh->fd_power[index], dbuf, info, sizeof(info)))
+        return -1;
+
+    // The line reads "<tab><watts> W (average GPU)"
+    const char* unit = strstr(info, " W (average GPU)");
+    if (!unit)
+        return -1;
+    const char* p = unit;
+    while (p != info && (isdigit(*(p - 1)) || *(p - 1) == '.'))
+        p--;
+    if (p == unit)
+        return -1;
+    double watt = atof(p);
+    *milliwatts = (unsigned int)(watt * 1000);
+    return 0;
+#else
     return -1;
+#endif
 }
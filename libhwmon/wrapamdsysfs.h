@@ -13,6 +13,11 @@ typedef struct {
 	int *sysfs_hwmon_id;        /* filesystem card idx to filesystem hwmon idx */
 	int *sysfs_opencl_device_id;          /* map ADL dev to OPENCL dev */
 	int *opencl_sysfs_device_id;          /* map OPENCL dev to ADL dev */
+	int *fd_temp;               /* sensor files kept open per card, -1 not yet opened, -2 unavailable */
+	int *fd_pwm;
+	int *fd_power;
+	unsigned int *pwm_max;      /* pwm range, read once per card */
+	unsigned int *pwm_min;
 } wrap_amdsysfs_handle;
 
 wrap_amdsysfs_handle * wrap_amdsysfs_create();
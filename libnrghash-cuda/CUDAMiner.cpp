@@ -119,7 +119,7 @@ void CUDAMiner::trun()
             nrghash::h256_t hash_header(&truncatedBlockHeader, sizeof(truncatedBlockHeader));
 
             // Upper 64 bits of the boundary.
-            const uint64_t upper64OfBoundary = *reinterpret_cast<uint64_t const *>((m_current.hashTarget >> 192).data());
+            const uint64_t upper64OfBoundary = m_current.upper64OfBoundary;
             assert(upper64OfBoundary > 0);
             uint64_t startN = m_plant.getStartNonce(m_current, m_index);
 
@@ -432,13 +432,22 @@ void CUDAMiner::search(
     if (m_current_target != target) {
         set_target(target);
         m_current_target = target;
+        // Keep the expected candidates per batch well under the result slots
+        uint64_t grids = maxBatchForTarget(target, SEARCH_RESULTS) / s_blockSize;
+        unsigned gridSize = std::max<unsigned>(1, std::min<uint64_t>(s_gridSize, grids));
+        if (gridSize != m_gridSize) {
+            cudalog << name() << " Grid size " << m_gridSize << " -> " << gridSize << " for the current target";
+            m_gridSize = gridSize;
+        }
     }
 
     // choose the starting nonce
     uint64_t current_nonce = startN;
+    // Shared with the verifier, candidates of this search may outlive it
+    auto const searched = std::make_shared<const Work>(work);
 
     // Nonces processed in one pass by a single stream
-    const uint32_t batch_size = s_gridSize * s_blockSize;
+    const uint32_t batch_size = m_gridSize * s_blockSize;
     // Nonces processed in one pass by all streams
     const uint32_t streams_batch_size = batch_size * s_numStreams;
     volatile search_results* buffer;
@@ -449,7 +458,7 @@ void CUDAMiner::search(
         cudaStream_t stream = m_streams[current_index];
         buffer = m_search_buf[current_index];
         buffer->count = 0;
-        run_ethash_search(s_gridSize, s_blockSize, stream, buffer, current_nonce, m_parallelHash);
+        run_ethash_search(m_gridSize, s_blockSize, stream, buffer, current_nonce, m_parallelHash);
     }
 
     // process stream batches until we get new work.
@@ -481,33 +490,28 @@ void CUDAMiner::search(
                 stop = true;
             }
 
-            // See if we got solutions in this batch
-            uint32_t found_count = std::min((unsigned)buffer->count, SEARCH_RESULTS);
+            // See if we got solutions in this batch, the kernel keeps
+            // counting past the last result slot
+            uint32_t reported = buffer->count;
+            uint32_t found_count = std::min(reported, SEARCH_RESULTS);
             if (found_count) {
                 buffer->count = 0;
                 uint64_t nonce_base = current_nonce - streams_batch_size;
-                // Pass the solution(s) for submission
+                // Pass every solution for verification and submission
                 for (uint32_t i = 0; i < found_count; i++) {
-                    work.nNonce = nonce_base + buffer->result[i].gid;
-                    if (s_noeval) {
-                        cudalog << name() << " Submitting block blockhash: " << work.GetHash().ToString() << " height: " << work.nHeight << " nonce: " << work.nNonce;
-                        m_plant.submitProof(Solution(work, work.getSecondaryExtraNonce()));
-                        break;
-                    } else {
-                        auto const powHash = GetPOWHash(work);
-                        if (UintToArith256(powHash) <= work.hashTarget) {
-                            cudalog << name() << " Submitting block blockhash: " << work.GetHash().ToString() << " height: " << work.nHeight << " nonce: " << work.nNonce;
-                            m_plant.submitProof(Solution(work, work.getSecondaryExtraNonce()));
-                            break;
-                        } else {
-                            cwarn << name() << " CUDA Miner proposed invalid solution: " << work.GetHash().ToString() << " nonce: " << work.nNonce;
-                        }
-                    }
+                    verifyNonce(searched, nonce_base + buffer->result[i].gid);
                 }
             }
+            if (reported > SEARCH_RESULTS) {
+                // Takes effect with the next search, the nonce ranges of this one are fixed
+                unsigned gridSize = std::max(1u, m_gridSize / 2);
+                cwarn << name() << " " << reported << " candidates in one batch, " << reported - found_count
+                      << " lost. Grid size " << m_gridSize << " -> " << gridSize;
+                m_gridSize = gridSize;
+            }
             // restart the stream on the next batch of nonces
             if (!done) {
-                run_ethash_search(s_gridSize, s_blockSize, stream, buffer, current_nonce, m_parallelHash);
+                run_ethash_search(batch_size / s_blockSize, s_blockSize, stream, buffer, current_nonce, m_parallelHash);
             }
         }
     }
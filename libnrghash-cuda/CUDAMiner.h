@@ -108,6 +108,8 @@ private:
     volatile search_results** m_search_buf = nullptr;
     cudaStream_t* m_streams = nullptr;
 	uint64_t m_current_target = 0;
+	/// Grid size of the search, s_gridSize or less when the target is easy
+	unsigned m_gridSize = s_gridSize;
 
     uint16_t m_searchPasses = 0;
     /// The local work size for the search
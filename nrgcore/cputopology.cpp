@@ -0,0 +1,176 @@
+/*
+ * CpuTopology.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "cputopology.h"
+#include "common/Log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <thread>
+#include <utility>
+
+#if defined(__linux)
+#include <dirent.h>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+using namespace energi;
+
+namespace {
+
+#if defined(__linux)
+const char* const c_sysfsCpuPath = "/sys/devices/system/cpu";
+
+bool readSysfsInt(const std::string& path, int& value)
+{
+    std::ifstream ifs(path);
+    if (!ifs.good()) {
+        return false;
+    }
+    ifs >> value;
+    return !ifs.fail();
+}
+#endif
+
+} //! anonymous namespace
+
+const CpuTopology& CpuTopology::get()
+{
+    static CpuTopology topology;
+    return topology;
+}
+
+CpuTopology::CpuTopology()
+{
+#if defined(__linux)
+    if (DIR* dir = opendir(c_sysfsCpuPath)) {
+        while (struct dirent* entry = readdir(dir)) {
+            const char* name = entry->d_name;
+            if (std::strncmp(name, "cpu", 3) != 0 || name[3] < '0' || name[3] > '9') {
+                continue;
+            }
+            CpuInfo info;
+            info.cpu = std::atoi(name + 3);
+            std::string base = std::string(c_sysfsCpuPath) + "/" + name;
+            int online = 1;
+            readSysfsInt(base + "/online", online); // cpu0 usually has no online file
+            if (!online) {
+                continue;
+            }
+            // topology directory is only present for online cpus
+            if (!readSysfsInt(base + "/topology/core_id", info.core)) {
+                continue;
+            }
+            readSysfsInt(base + "/topology/physical_package_id", info.package);
+            m_cpus.push_back(info);
+        }
+        closedir(dir);
+    }
+    std::sort(m_cpus.begin(), m_cpus.end(), [](const CpuInfo& a, const CpuInfo& b) {
+        return a.cpu < b.cpu;
+    });
+#endif
+    if (m_cpus.empty()) {
+        // No topology information, assume each logical cpu is a core of its own
+        unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned i = 0; i < count; ++i) {
+            CpuInfo info;
+            info.cpu = static_cast<int>(i);
+            info.core = static_cast<int>(i);
+            info.package = 0;
+            m_cpus.push_back(info);
+        }
+    }
+}
+
+unsigned CpuTopology::physicalCores() const
+{
+    std::set<std::pair<int, int>> cores;
+    for (const auto& info : m_cpus) {
+        cores.insert(std::make_pair(info.package, info.core));
+    }
+    return static_cast<unsigned>(cores.size());
+}
+
+const CpuInfo* CpuTopology::find(int cpu) const
+{
+    for (const auto& info : m_cpus) {
+        if (info.cpu == cpu) {
+            return &info;
+        }
+    }
+    return nullptr;
+}
+
+std::vector<int> CpuTopology::placement(CpuAffinityPolicy policy, const std::vector<unsigned>& cores) const
+{
+    std::vector<int> result;
+    switch (policy) {
+    case CpuAffinityPolicy::kOnePerCore: {
+        // Lowest numbered sibling of every physical core
+        std::set<std::pair<int, int>> seen;
+        for (const auto& info : m_cpus) {
+            if (seen.insert(std::make_pair(info.package, info.core)).second) {
+                result.push_back(info.cpu);
+            }
+        }
+        break;
+    }
+    case CpuAffinityPolicy::kAllThreads:
+        for (const auto& info : m_cpus) {
+            result.push_back(info.cpu);
+        }
+        break;
+    case CpuAffinityPolicy::kList:
+        for (auto cpu : cores) {
+            if (!find(static_cast<int>(cpu))) {
+                cwarn << "CPU " << cpu << " is not online, skipped";
+                continue;
+            }
+            result.push_back(static_cast<int>(cpu));
+        }
+        break;
+    case CpuAffinityPolicy::kNone:
+    default: {
+        unsigned count = std::thread::hardware_concurrency();
+        result.assign(count > 1 ? count - 1 : 1, -1);
+        break;
+    }
+    }
+    return result;
+}
+
+CpuAffinityPolicy energi::cpuAffinityPolicyFromString(const std::string& policy)
+{
+    if (policy == "core") {
+        return CpuAffinityPolicy::kOnePerCore;
+    }
+    if (policy == "thread") {
+        return CpuAffinityPolicy::kAllThreads;
+    }
+    if (policy == "list") {
+        return CpuAffinityPolicy::kList;
+    }
+    return CpuAffinityPolicy::kNone;
+}
+
+std::string energi::to_string(CpuAffinityPolicy policy)
+{
+    switch (policy) {
+    case CpuAffinityPolicy::kOnePerCore:
+        return "core";
+    case CpuAffinityPolicy::kAllThreads:
+        return "thread";
+    case CpuAffinityPolicy::kList:
+        return "list";
+    case CpuAffinityPolicy::kNone:
+    default:
+        return "none";
+    }
+}
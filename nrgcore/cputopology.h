@@ -0,0 +1,63 @@
+/*
+ * CpuTopology.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_CPUTOPOLOGY_H_
+#define ENERGIMINER_CPUTOPOLOGY_H_
+
+#include <string>
+#include <vector>
+
+namespace energi {
+
+enum class CpuAffinityPolicy : unsigned
+{
+    kNone       = 0x0, // no pinning, hardware_concurrency() - 1 threads
+    kOnePerCore = 0x1, // one thread per physical core, SMT siblings left idle
+    kAllThreads = 0x2, // one thread per logical cpu
+    kList       = 0x3  // explicit list of logical cpus
+};
+
+struct CpuInfo
+{
+    int cpu     = -1; // logical cpu number as known to the scheduler
+    int core    = -1; // core_id, unique inside a package
+    int package = -1; // physical_package_id
+};
+
+class CpuTopology
+{
+public:
+    //! Probed once, on first use
+    static const CpuTopology& get();
+
+    const std::vector<CpuInfo>& cpus() const
+    {
+        return m_cpus;
+    }
+
+    unsigned physicalCores() const;
+
+    const CpuInfo* find(int cpu) const;
+
+    /**
+     * @brief Returns the logical cpus the miner threads are pinned to, one entry per thread.
+     *        An entry of -1 means the thread is left unpinned.
+     */
+    std::vector<int> placement(CpuAffinityPolicy policy, const std::vector<unsigned>& cores) const;
+
+private:
+    CpuTopology();
+
+    std::vector<CpuInfo> m_cpus;
+};
+
+CpuAffinityPolicy cpuAffinityPolicyFromString(const std::string& policy);
+std::string to_string(CpuAffinityPolicy policy);
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_CPUTOPOLOGY_H_ */
@@ -0,0 +1,163 @@
+/*
+ * HostDAG.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "hostdag.h"
+#include "miner.h"
+
+#include "common/Log.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef WIN32
+#include <boost/filesystem/fstream.hpp>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace energi;
+
+std::mutex HostDAG::x_current;
+std::shared_ptr<const HostDAG> HostDAG::s_current;
+
+namespace {
+
+//! Same layout as the header nrghash writes in dag_t::save()
+#pragma pack(push, 1)
+struct FileHeader
+{
+    char     magic[sizeof(nrghash::constants::DAG_MAGIC_BYTES)];
+    uint32_t major_version;
+    uint32_t revision;
+    uint32_t minor_version;
+    uint64_t epoch;
+    uint64_t cache_begin;
+    uint64_t cache_end;
+    uint64_t dag_begin;
+    uint64_t dag_end;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FileHeader) == nrghash::constants::DAG_FILE_HEADER_SIZE, "Dag header size invalid.");
+
+} //! anonymous namespace
+
+HostDAG::~HostDAG()
+{
+#ifndef WIN32
+    if (m_base) {
+        munmap(const_cast<uint8_t*>(m_base), m_length);
+    }
+#endif
+}
+
+std::shared_ptr<const HostDAG> HostDAG::acquire(uint64_t epoch)
+{
+    // Devices switching together wait here for the first one to map the file
+    std::lock_guard<std::mutex> lock(x_current);
+    if (s_current && s_current->epoch() == epoch) {
+        return s_current;
+    }
+    // Devices still uploading the previous epoch keep their own reference
+    s_current.reset();
+
+    const auto file = Miner::DAGFilePath(epoch);
+    auto mapped = open(file, epoch);
+    if (!mapped && generate(file, epoch)) {
+        mapped = open(file, epoch);
+    }
+    s_current = mapped;
+    return mapped;
+}
+
+std::shared_ptr<const HostDAG> HostDAG::open(const boost::filesystem::path& file, uint64_t epoch)
+{
+    std::shared_ptr<HostDAG> dag(new HostDAG());
+#ifdef WIN32
+    boost::filesystem::ifstream fs(file, std::ios::in | std::ios::binary);
+    if (!fs) {
+        return nullptr;
+    }
+    dag->m_contents.assign(std::istreambuf_iterator<char>(fs), std::istreambuf_iterator<char>());
+    dag->m_base = dag->m_contents.data();
+    dag->m_length = dag->m_contents.size();
+#else
+    int fd = ::open(file.string().c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FileHeader))) {
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        cwarn << "Mapping " << file.string() << " failed: " << std::strerror(errno);
+        return nullptr;
+    }
+    // Every device reads the file front to back while uploading
+    madvise(base, st.st_size, MADV_SEQUENTIAL);
+    madvise(base, st.st_size, MADV_WILLNEED);
+    dag->m_base = static_cast<const uint8_t*>(base);
+    dag->m_length = st.st_size;
+#endif
+    if (dag->m_length < sizeof(FileHeader)) {
+        return nullptr;
+    }
+
+    FileHeader header;
+    std::memcpy(&header, dag->m_base, sizeof(header));
+    const uint64_t height = epoch * nrghash::constants::EPOCH_LENGTH + 1;
+    if (std::memcmp(header.magic, nrghash::constants::DAG_MAGIC_BYTES, sizeof(header.magic)) != 0
+        || header.major_version != nrghash::constants::MAJOR_VERSION
+        || header.revision != nrghash::constants::REVISION
+        || header.epoch != epoch
+        || header.cache_end <= header.cache_begin
+        || header.cache_end - header.cache_begin != nrghash::cache_t::get_cache_size(height)
+        || header.dag_end <= header.dag_begin
+        || header.dag_end - header.dag_begin != nrghash::dag_t::get_full_size(height)) {
+        cwarn << "DAG file " << file.string() << " does not match epoch " << epoch;
+        return nullptr;
+    }
+    // The recorded offsets are one past where save() actually put the data
+    if (header.cache_begin == 0 || header.dag_end - 1 > dag->m_length) {
+        cwarn << "DAG file " << file.string() << " is truncated";
+        return nullptr;
+    }
+    dag->m_epoch = epoch;
+    dag->m_cacheOffset = header.cache_begin - 1;
+    dag->m_cacheSize = header.cache_end - header.cache_begin;
+    dag->m_dagOffset = header.dag_begin - 1;
+    dag->m_dagSize = header.dag_end - header.dag_begin;
+    return dag;
+}
+
+bool HostDAG::generate(const boost::filesystem::path& file, uint64_t epoch)
+{
+    cnote << "Generating DAG file for epoch #" << epoch << " on the host";
+    try {
+        std::unique_ptr<nrghash::dag_t> dag(new nrghash::dag_t(epoch * nrghash::constants::EPOCH_LENGTH,
+            [](::std::size_t, ::std::size_t, int) -> bool { return true; }));
+        boost::filesystem::create_directories(file.parent_path());
+        dag->save(file.string());
+        // Already in memory, the verifier can use it for full hashes
+        Miner::ActiveDAG(std::move(dag));
+    } catch (nrghash::hash_exception const& e) {
+        cwarn << "DAG for epoch " << epoch << " could not be generated: " << e.what();
+        return false;
+    } catch (boost::filesystem::filesystem_error const& e) {
+        cwarn << "DAG file " << file.string() << " could not be written: " << e.what();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,69 @@
+/*
+ * HostDAG.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_HOSTDAG_H_
+#define ENERGIMINER_HOSTDAG_H_
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+namespace energi {
+
+/**
+ * @brief Read only view of the .dag file of one epoch. The file is mapped
+ *        once per process and shared by every device uploading from it,
+ *        so a rig reads the DAG from disk a single time per epoch.
+ */
+class HostDAG
+{
+public:
+    ~HostDAG();
+
+    HostDAG(const HostDAG&) = delete;
+    HostDAG& operator=(const HostDAG&) = delete;
+
+    /**
+     * @brief The mapping of the epoch, the first caller maps the file and
+     *        generates it first when missing or invalid. nullptr on failure.
+     */
+    static std::shared_ptr<const HostDAG> acquire(uint64_t epoch);
+
+    uint64_t epoch() const { return m_epoch; }
+    //! Light cache as the 32 bit words the device kernels expect
+    const uint8_t* cache() const { return m_base + m_cacheOffset; }
+    uint64_t cacheSize() const { return m_cacheSize; }
+    const uint8_t* dag() const { return m_base + m_dagOffset; }
+    uint64_t dagSize() const { return m_dagSize; }
+
+private:
+    HostDAG() = default;
+
+    static std::shared_ptr<const HostDAG> open(const boost::filesystem::path& file, uint64_t epoch);
+    static bool generate(const boost::filesystem::path& file, uint64_t epoch);
+
+    const uint8_t* m_base = nullptr;
+    uint64_t       m_length = 0;
+    uint64_t       m_epoch = 0;
+    uint64_t       m_cacheOffset = 0;
+    uint64_t       m_cacheSize = 0;
+    uint64_t       m_dagOffset = 0;
+    uint64_t       m_dagSize = 0;
+#ifdef WIN32
+    std::vector<uint8_t> m_contents;
+#endif
+
+    static std::mutex                     x_current;
+    static std::shared_ptr<const HostDAG> s_current;
+};
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_HOSTDAG_H_ */
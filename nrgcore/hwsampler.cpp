@@ -0,0 +1,208 @@
+/*
+ * HwSampler.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "hwsampler.h"
+
+#include "common/Log.h"
+
+#include <algorithm>
+#include <future>
+
+using namespace energi;
+
+const unsigned HwSampler::c_maxDevices;
+const unsigned HwSampler::c_defaultIntervalMs;
+
+namespace {
+
+const uint64_t c_valid = uint64_t(1) << 63;
+
+} //! anonymous namespace
+
+HwSampler::HwSampler(bool power, unsigned intervalMs)
+    : m_power(power)
+    , m_intervalMs(intervalMs)
+{
+    for (auto& reading : m_readings) {
+        reading.store(0, std::memory_order_relaxed);
+    }
+    adlh = wrap_adl_create();
+#if defined(__linux)
+    sysfsh = wrap_amdsysfs_create();
+#endif
+    nvmlh = wrap_nvml_create();
+    m_thread = std::thread(&HwSampler::run, this);
+}
+
+HwSampler::~HwSampler()
+{
+    {
+        std::lock_guard<std::mutex> lock(x_devices);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_thread.join();
+
+    // Deinit HWMON
+    if (adlh) {
+        wrap_adl_destroy(adlh);
+    }
+#if defined(__linux)
+    if (sysfsh) {
+        wrap_amdsysfs_destroy(sysfsh);
+    }
+#endif
+    if (nvmlh) {
+        wrap_nvml_destroy(nvmlh);
+    }
+}
+
+void HwSampler::setDevices(const std::vector<HwMonitorInfo>& devices)
+{
+    std::lock_guard<std::mutex> lock(x_devices);
+    const size_t count = std::min<size_t>(devices.size(), c_maxDevices);
+    for (size_t i = 0; i < c_maxDevices; ++i) {
+        const bool same = i < count && i < m_devices.size()
+            && devices[i].deviceType == m_devices[i].deviceType
+            && devices[i].indexSource == m_devices[i].indexSource
+            && devices[i].deviceIndex == m_devices[i].deviceIndex;
+        if (!same) {
+            m_readings[i].store(0, std::memory_order_relaxed);
+        }
+    }
+    m_devices.assign(devices.begin(), devices.begin() + count);
+}
+
+void HwSampler::setInterval(unsigned intervalMs)
+{
+    m_intervalMs.store(std::max(intervalMs, 1u), std::memory_order_relaxed);
+    m_wake.notify_all();
+}
+
+bool HwSampler::reading(unsigned slot, HwMonitor& hw) const
+{
+    if (slot >= c_maxDevices) {
+        return false;
+    }
+    const uint64_t packed = m_readings[slot].load(std::memory_order_acquire);
+    if (!(packed & c_valid)) {
+        return false;
+    }
+    hw.tempC = static_cast<int>(packed & 0xffff);
+    hw.fanP = static_cast<int>((packed >> 16) & 0xffff);
+    hw.powerW = ((packed >> 32) & 0x7fffffff) / 1000.0;
+    return true;
+}
+
+uint64_t HwSampler::pack(unsigned tempC, unsigned fanP, unsigned powerMw)
+{
+    return c_valid
+        | std::min<uint64_t>(tempC, 0xffff)
+        | std::min<uint64_t>(fanP, 0xffff) << 16
+        | std::min<uint64_t>(powerMw, 0x7fffffff) << 32;
+}
+
+void HwSampler::run()
+{
+    setThreadName("hwmon");
+    std::vector<HwMonitorInfo> devices;
+    // Task of every slot, a slot whose task is still running is skipped until it returns
+    std::vector<std::future<void>> pending(c_maxDevices);
+    std::vector<bool> stuck(c_maxDevices, false);
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(x_devices);
+            if (m_stopping) {
+                break;
+            }
+            devices = m_devices;
+        }
+
+        const auto started = std::chrono::steady_clock::now();
+        // A stuck driver call holds up its own device only, the others keep their pace
+        for (unsigned slot = 0; slot < devices.size(); ++slot) {
+            if (devices[slot].deviceIndex < 0) {
+                continue;
+            }
+            if (pending[slot].valid()
+                && pending[slot].wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+                if (!stuck[slot]) {
+                    cwarn << "Hardware monitor of device " << slot << " is not answering, skipping it";
+                    stuck[slot] = true;
+                }
+                continue;
+            }
+            stuck[slot] = false;
+            const HwMonitorInfo info = devices[slot];
+            pending[slot] = m_pool.run(-1, [this, slot, info] { sample(slot, info); });
+        }
+
+        std::unique_lock<std::mutex> lock(x_devices);
+        m_wake.wait_until(lock, started + std::chrono::milliseconds(m_intervalMs.load(std::memory_order_relaxed)),
+                          [this] { return m_stopping; });
+    }
+    // The tasks use the library handles the destructor releases
+    for (auto& done : pending) {
+        if (done.valid()) {
+            done.wait();
+        }
+    }
+}
+
+void HwSampler::sample(unsigned slot, const HwMonitorInfo& hwInfo)
+{
+    unsigned int tempC = 0, fanpcnt = 0, powerMw = 0;
+    if (hwInfo.deviceType == HwMonitorInfoType::NVIDIA && nvmlh) {
+        int typeidx = 0;
+        if (hwInfo.indexSource == HwMonitorIndexSource::CUDA) {
+            typeidx = nvmlh->cuda_nvml_device_id[hwInfo.deviceIndex];
+        } else if (hwInfo.indexSource == HwMonitorIndexSource::OPENCL) {
+            typeidx = nvmlh->opencl_nvml_device_id[hwInfo.deviceIndex];
+        } else {
+            // Unknown, don't map
+            typeidx = hwInfo.deviceIndex;
+        }
+        wrap_nvml_get_tempC(nvmlh, typeidx, &tempC);
+        wrap_nvml_get_fanpcnt(nvmlh, typeidx, &fanpcnt);
+        if (m_power) {
+            wrap_nvml_get_power_usage(nvmlh, typeidx, &powerMw);
+        }
+    } else if (hwInfo.deviceType == HwMonitorInfoType::AMD && adlh) {
+        int typeidx = 0;
+        if (hwInfo.indexSource == HwMonitorIndexSource::OPENCL) {
+            typeidx = adlh->opencl_adl_device_id[hwInfo.deviceIndex];
+        } else {
+            // Unknown, don't map
+            typeidx = hwInfo.deviceIndex;
+        }
+        std::lock_guard<std::mutex> lock(x_adl);
+        wrap_adl_get_tempC(adlh, typeidx, &tempC);
+        wrap_adl_get_fanpcnt(adlh, typeidx, &fanpcnt);
+        if (m_power) {
+            wrap_adl_get_power_usage(adlh, typeidx, &powerMw);
+        }
+    }
+#if defined(__linux)
+    // Overwrite with sysfs data if present
+    if (hwInfo.deviceType == HwMonitorInfoType::AMD && sysfsh) {
+        int typeidx = 0;
+        if (hwInfo.indexSource == HwMonitorIndexSource::OPENCL) {
+            typeidx = sysfsh->opencl_sysfs_device_id[hwInfo.deviceIndex];
+        } else {
+            // Unknown, don't map
+            typeidx = hwInfo.deviceIndex;
+        }
+        // Each slot is sampled by one task at a time, so its cached descriptors are never shared
+        wrap_amdsysfs_get_tempC(sysfsh, typeidx, &tempC);
+        wrap_amdsysfs_get_fanpcnt(sysfsh, typeidx, &fanpcnt);
+        if (m_power) {
+            wrap_amdsysfs_get_power_usage(sysfsh, typeidx, &powerMw);
+        }
+    }
+#endif
+    m_readings[slot].store(pack(tempC, fanpcnt, powerMw), std::memory_order_release);
+}
@@ -0,0 +1,83 @@
+/*
+ * HwSampler.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_HWSAMPLER_H_
+#define ENERGIMINER_HWSAMPLER_H_
+
+#include "common/common.h"
+#include "primitives/workerpool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <libhwmon/wrapnvml.h>
+#include <libhwmon/wrapadl.h>
+#if defined(__linux)
+#include <libhwmon/wrapamdsysfs.h>
+#endif
+
+namespace energi {
+
+/**
+ * @brief Reads temperature, fan and power of the mining devices on its own
+ *        thread, every device of a round in parallel. A device whose last
+ *        read has not returned is skipped until it does. The latest reading
+ *        of every device is published as a single atomic word, so the plant's
+ *        collector and the temperature throttle never wait on NVML, ADL or
+ *        sysfs.
+ */
+class HwSampler
+{
+public:
+    static const unsigned c_maxDevices = 64;
+    static const unsigned c_defaultIntervalMs = 2000;
+
+    HwSampler(bool power, unsigned intervalMs = c_defaultIntervalMs);
+    HwSampler(HwSampler const&) = delete;
+    HwSampler& operator=(HwSampler const&) = delete;
+    ~HwSampler();
+
+    //! Devices to sample, slot i reports devices[i]; readings of changed slots are dropped
+    void setDevices(const std::vector<HwMonitorInfo>& devices);
+    void setInterval(unsigned intervalMs);
+
+    //! Latest reading of slot, false until the device has been sampled once
+    bool reading(unsigned slot, HwMonitor& hw) const;
+
+private:
+    void run();
+    void sample(unsigned slot, const HwMonitorInfo& info);
+
+    static uint64_t pack(unsigned tempC, unsigned fanP, unsigned powerMw);
+
+    const bool                  m_power;
+    std::atomic<unsigned>       m_intervalMs;
+
+    std::mutex                  x_devices;
+    std::condition_variable     m_wake;
+    std::vector<HwMonitorInfo>  m_devices;
+    bool                        m_stopping = false;
+
+    std::atomic<uint64_t>       m_readings[c_maxDevices];
+    WorkerPool                  m_pool;
+    std::mutex                  x_adl;      // ADL is not safe to call from several threads
+    std::thread                 m_thread;
+
+    // Wrappers for hardware monitoring libraries
+    wrap_nvml_handle *nvmlh = nullptr;
+    wrap_adl_handle *adlh = nullptr;
+#if defined(__linux)
+    wrap_amdsysfs_handle *sysfsh = nullptr;
+#endif
+};
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_HWSAMPLER_H_ */
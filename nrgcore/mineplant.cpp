@@ -16,6 +16,7 @@
 #endif
 
 #include "nrgcore/miner.h"
+#include "nrgcore/cputopology.h"
 #include "primitives/work.h"
 #include "energiminer/CpuMiner.h"
 #include "energiminer/TestMiner.h"
@@ -52,7 +53,8 @@ MinerPtr createMiner(EnumMinerEngine minerEngine, int index, const MinePlant &pl
 }
 
 MinePlant::MinePlant(boost::asio::io_service& io_service, bool hwmon, bool pwron)
-    : m_io_strand(io_service)
+    : m_verifier([this](const Solution& solution) { submitProof(solution); })
+    , m_io_strand(io_service)
     , m_collectTimer(io_service)
 {
     m_hwmon = hwmon;
@@ -60,13 +62,12 @@ MinePlant::MinePlant(boost::asio::io_service& io_service, bool hwmon, bool pwron
 
     // Init HWMON if needed
     if (m_hwmon) {
-        adlh = wrap_adl_create();
-#if defined(__linux)
-        sysfsh = wrap_amdsysfs_create();
-#endif
-        nvmlh = wrap_nvml_create();
+        m_sampler.reset(new HwSampler(m_pwron));
     }
 
+    m_submitThread = std::thread(&MinePlant::submitLoop, this);
+    m_verifier.start();
+
     // Start data collector timer
     // It should work for the whole lifetime of Farm
     // regardless it's mining state
@@ -78,18 +79,11 @@ MinePlant::MinePlant(boost::asio::io_service& io_service, bool hwmon, bool pwron
 MinePlant::~MinePlant()
 {
     // Deinit HWMON
-    if (adlh) {
-        wrap_adl_destroy(adlh);
-    }
-#if defined(__linux)
-    if (sysfsh) {
-        wrap_amdsysfs_destroy(sysfsh);
-    }
-#endif
-    if (nvmlh) {
-        wrap_nvml_destroy(nvmlh);
-    }
+    m_sampler.reset();
     stop();
+    m_verifier.stop();
+    m_submitQueue.close();
+    m_submitThread.join();
     // Stop data collector
     m_collectTimer.cancel();
 }
@@ -100,9 +94,11 @@ bool MinePlant::start(const std::vector<EnumMinerEngine> &vMinerEngine)
     if (isMining()) {
         return true;
     }
+    auto startTime = std::chrono::steady_clock::now();
     //m_started = true;
     for ( auto &minerEngine : vMinerEngine) {
         unsigned count = 0;
+        std::vector<int> affinity;
 #if NRGHASHCL
         if (minerEngine == EnumMinerEngine::kCL) {
             count = OpenCLMiner::instances();
@@ -117,15 +113,27 @@ bool MinePlant::start(const std::vector<EnumMinerEngine> &vMinerEngine)
             count = 2;
         }
         if (minerEngine == EnumMinerEngine::kCPU) {
-            count = std::thread::hardware_concurrency() - 1;
+            affinity = CpuMiner::placement();
+            count = affinity.size();
         }
         for ( unsigned i = 0; i < count; ++i ) {
             m_miners.push_back(createMiner(minerEngine, i, *this));
+            m_miners.back()->setPool(&m_workerPool);
+            if (i < affinity.size() && affinity[i] >= 0) {
+                const CpuInfo* info = CpuTopology::get().find(affinity[i]);
+                m_miners.back()->setAffinity(affinity[i]);
+                cnote << m_miners.back()->name() << " pinned to cpu " << affinity[i]
+                      << " (core " << (info ? info->core : -1)
+                      << ", package " << (info ? info->package : -1) << ")";
+            }
             m_miners.back()->startWorking();
         }
     }
     m_isMining.store(true, std::memory_order_relaxed);
 
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+    cnote << "Started " << m_miners.size() << " miners in " << us << " us, "
+          << m_workerPool.threads() << " pooled threads";
     return true;
 }
 
@@ -133,9 +141,13 @@ void MinePlant::stop()
 {
     if (isMining()) {
         {
+            auto stopTime = std::chrono::steady_clock::now();
             std::lock_guard<std::mutex> lock(x_minerWork);
             m_miners.clear();
             m_isMining.store(false, std::memory_order_relaxed);
+            auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stopTime).count();
+            cnote << "Stopped miners in " << us << " us, "
+                  << m_workerPool.idle() << "/" << m_workerPool.threads() << " pooled threads idle";
         }
     }
 }
@@ -169,10 +181,50 @@ void MinePlant::resetWork()
     }
 }
 
+std::vector<float> MinePlant::minerHashRates() const
+{
+    std::lock_guard<std::mutex> lock(x_minerWork);
+    std::vector<float> rates;
+    rates.reserve(m_miners.size());
+    for (auto const& miner : m_miners) {
+        rates.push_back(miner->is_mining_paused() ? 0.0f : miner->RetrieveHashRate());
+    }
+    return rates;
+}
+
 void MinePlant::submitProof(const Solution& solution) const
 {
-    assert(m_onSolutionFound);
-    m_onSolutionFound(solution);
+    // Called from the hash loop, must not wait for the pool
+    if (!m_submitQueue.push(solution)) {
+        cwarn << "Submit queue full, nonce " << solution.getNonce() << " dropped";
+    }
+}
+
+void MinePlant::verifyProof(Candidate&& candidate) const
+{
+    // Called from the device thread, hashing happens on the verifier threads
+    const std::string miner = candidate.miner;
+    const uint64_t nonce = candidate.nonce;
+    if (!m_verifier.push(std::move(candidate))) {
+        cwarn << "Verify queue full, " << miner << " nonce " << nonce << " dropped";
+    }
+}
+
+void MinePlant::submitLoop()
+{
+    setThreadName("submit");
+    Solution solution;
+    while (true) {
+        if (!m_submitQueue.pop(solution, std::chrono::milliseconds(500))) {
+            if (m_submitQueue.isClosed()) {
+                break;
+            }
+            continue;
+        }
+        if (m_onSolutionFound) {
+            m_onSolutionFound(solution);
+        }
+    }
 }
 
 void MinePlant::collectData(const boost::system::error_code& ec)
@@ -181,8 +233,20 @@ void MinePlant::collectData(const boost::system::error_code& ec)
         return;
 
     WorkingProgress progress;
+    const auto verifyStats = m_verifier.stats();
+
+    // Miners fill in their device while initialising, the sampler follows along
+    if (m_sampler) {
+        std::vector<HwMonitorInfo> devices;
+        devices.reserve(m_miners.size());
+        for (auto const& miner : m_miners) {
+            devices.push_back(miner->hwmonInfo());
+        }
+        m_sampler->setDevices(devices);
+    }
 
     // Process miners
+    unsigned slot = 0;
     for (auto const& miner : m_miners) {
         // Collect and reset hashrates
         if (!miner->is_mining_paused()) {
@@ -194,67 +258,20 @@ void MinePlant::collectData(const boost::system::error_code& ec)
             progress.minersHashRates.insert(std::make_pair<std::string, float>(miner->name(), 0.0));
             progress.miningIsPaused.insert(std::make_pair<std::string, bool>(miner->name(), true));
         }
+        auto verified = verifyStats.find(miner->name());
+        if (verified != verifyStats.end() && verified->second.invalid) {
+            progress.minerInvalids[miner->name()] = verified->second.invalid;
+        }
 
-        if (m_hwmon) {
-            HwMonitorInfo hwInfo = miner->hwmonInfo();
+        if (m_sampler) {
+            // Latest sensor reading, zeros until the device has been sampled
             HwMonitor hw;
-            unsigned int tempC = 0, fanpcnt = 0, powerW = 0;
-            if (hwInfo.deviceIndex >= 0) {
-                if (hwInfo.deviceType == HwMonitorInfoType::NVIDIA && nvmlh) {
-                    int typeidx = 0;
-                    if (hwInfo.indexSource == HwMonitorIndexSource::CUDA) {
-                        typeidx = nvmlh->cuda_nvml_device_id[hwInfo.deviceIndex];
-                    } else if (hwInfo.indexSource == HwMonitorIndexSource::OPENCL) {
-                        typeidx = nvmlh->opencl_nvml_device_id[hwInfo.deviceIndex];
-                    } else {
-                        // Unknown, don't map
-                        typeidx = hwInfo.deviceIndex;
-                    }
-                    wrap_nvml_get_tempC(nvmlh, typeidx, &tempC);
-                    wrap_nvml_get_fanpcnt(nvmlh, typeidx, &fanpcnt);
-                    if (m_pwron) {
-                        wrap_nvml_get_power_usage(nvmlh, typeidx, &powerW);
-                    }
-                } else if (hwInfo.deviceType == HwMonitorInfoType::AMD && adlh) {
-                    int typeidx = 0;
-                    if (hwInfo.indexSource == HwMonitorIndexSource::OPENCL) {
-                        typeidx = adlh->opencl_adl_device_id[hwInfo.deviceIndex];
-                    } else {
-                        // Unknown, don't map
-                        typeidx = hwInfo.deviceIndex;
-                    }
-                    wrap_adl_get_tempC(adlh, typeidx, &tempC);
-                    wrap_adl_get_fanpcnt(adlh, typeidx, &fanpcnt);
-                    if (m_pwron) {
-                        wrap_adl_get_power_usage(adlh, typeidx, &powerW);
-                    }
-                }
-#if defined(__linux)
-                // Overwrite with sysfs data if present
-                if (hwInfo.deviceType == HwMonitorInfoType::AMD && sysfsh) {
-                    int typeidx = 0;
-                    if (hwInfo.indexSource == HwMonitorIndexSource::OPENCL) {
-                        typeidx = sysfsh->opencl_sysfs_device_id[hwInfo.deviceIndex];
-                    } else {
-                        // Unknown, don't map
-                        typeidx = hwInfo.deviceIndex;
-                    }
-                    wrap_amdsysfs_get_tempC(sysfsh, typeidx, &tempC);
-                    wrap_amdsysfs_get_fanpcnt(sysfsh, typeidx, &fanpcnt);
-                    if (m_pwron) {
-                        wrap_amdsysfs_get_power_usage(sysfsh, typeidx, &powerW);
-                    }
-                }
-#endif
+            if (m_sampler->reading(slot, hw)) {
+                miner->update_temperature(hw.tempC);
             }
-
-            miner->update_temperature(tempC);
-
-            hw.tempC = tempC;
-            hw.fanP = fanpcnt;
-            hw.powerW = powerW / ((double)1000.0);
             progress.minerMonitors[miner->name()] = hw;
         }
+        ++slot;
     }
 
     m_progress = progress;
@@ -272,6 +289,13 @@ void MinePlant::setTStartTStop(unsigned tstart, unsigned tstop)
     m_tstop = tstop;
 }
 
+void MinePlant::setHwmonInterval(unsigned ms)
+{
+    if (m_sampler) {
+        m_sampler->setInterval(ms);
+    }
+}
+
 void MinePlant::restart()
 {
     if (m_onMinerRestart) {
@@ -300,8 +324,14 @@ void MinePlant::failedSolution()
     m_solutionStats.failed();
 }
 
-void MinePlant::acceptedSolution(bool _stale)
+void MinePlant::wastedSolution()
+{
+    m_solutionStats.wasted();
+}
+
+void MinePlant::acceptedSolution(bool _stale, const std::chrono::milliseconds& findToAck)
 {
+    m_submitQueue.recordAck(findToAck);
     if (!_stale) {
         m_solutionStats.accepted();
     } else {
@@ -309,11 +339,17 @@ void MinePlant::acceptedSolution(bool _stale)
     }
 }
 
-void MinePlant::rejectedSolution()
+void MinePlant::rejectedSolution(const std::chrono::milliseconds& findToAck)
 {
+    m_submitQueue.recordAck(findToAck);
     m_solutionStats.rejected();
 }
 
+void MinePlant::sentSolution(const std::chrono::microseconds& findToWire)
+{
+    m_submitQueue.recordSent(findToWire);
+}
+
 const Work& MinePlant::getWork() const
 {
     std::lock_guard<std::mutex> lock(x_minerWork);
@@ -11,6 +11,10 @@
 #include "plant.h"
 #include "miner.h"
 #include "primitives/solution.h"
+#include "primitives/workerpool.h"
+#include "hwsampler.h"
+#include "submitqueue.h"
+#include "verifier.h"
 #include <boost/asio.hpp>
 
 
@@ -21,11 +25,6 @@
 #include <map>
 #include <chrono>
 #include <random>
-#include <libhwmon/wrapnvml.h>
-#include <libhwmon/wrapadl.h>
-#if defined(__linux)
-#include <libhwmon/wrapamdsysfs.h>
-#endif
 
 
 namespace energi {
@@ -36,20 +35,23 @@ public:
     void accepted() { accepts++;  }
     void rejected() { rejects++;  }
     void failed()   { failures++; }
+    void wasted()   { wastes++;   }
 
     void acceptedStale() { acceptedStales++; }
 
 
-    void reset() { accepts = rejects = failures = acceptedStales = 0; }
+    void reset() { accepts = rejects = failures = wastes = acceptedStales = 0; }
 
     unsigned getAccepts() const { return accepts; }
     unsigned getRejects() const { return rejects; }
     unsigned getFailures() const { return failures; }
+    unsigned getWasted() const { return wastes; }
     unsigned getAcceptedStales() const { return acceptedStales; }
 private:
     unsigned accepts  = 0;
     unsigned rejects  = 0;
     unsigned failures = 0;
+    unsigned wastes   = 0;          // found while their pool connection was gone
 
     unsigned acceptedStales = 0;
 };
@@ -66,6 +68,9 @@ inline std::ostream& operator<<(std::ostream& os, SolutionStats s)
     if (s.getFailures()) {
         os << ":F" << s.getFailures();
     }
+    if (s.getWasted()) {
+        os << ":W" << s.getWasted();
+    }
     return os << "]";
 }
 
@@ -82,6 +87,8 @@ public:
     uint64_t getStartNonce(const Work& work, unsigned idx) const override;
     //! Temperature
     void setTStartTStop(unsigned tstart, unsigned tstop);
+    //! How often the hardware sensors are read, independent of the collect interval
+    void setHwmonInterval(unsigned ms);
     unsigned get_tstart() const override
     {
         return m_tstart;
@@ -100,10 +107,13 @@ public:
     void setWork(const Work& work);
     void resetWork();
     void submitProof(const Solution &sol) const override;
+    void verifyProof(Candidate &&candidate) const override;
     const WorkingProgress& miningProgress() const
     {
         return m_progress;
     }
+    //! Current hashrate of every miner, without waiting for the collect timer
+    std::vector<float> minerHashRates() const;
 
     using SolutionFound = std::function<void(Solution const&)>;
     using MinerRestart = std::function<void()>;
@@ -129,8 +139,14 @@ public:
 	bool isMining() const;
 	SolutionStats getSolutionStats();
 	void failedSolution() override;
-	void acceptedSolution(bool _stale);
-	void rejectedSolution();
+	void wastedSolution();
+	void acceptedSolution(bool _stale, const std::chrono::milliseconds& findToAck);
+	void rejectedSolution(const std::chrono::milliseconds& findToAck);
+	void sentSolution(const std::chrono::microseconds& findToWire);
+	SubmitStats getSubmitStats() const
+	{
+	    return m_submitQueue.stats();
+	}
     const Work& getWork() const;
 	std::chrono::steady_clock::time_point farmLaunched();
     std::string farmLaunchedFormatted() const;
@@ -138,9 +154,13 @@ public:
 private:
     // Collects data about hashing and hardware status
     void collectData(const boost::system::error_code& ec);
+    // Hands queued solutions over to the pool client
+    void submitLoop();
 
 private:
 	mutable std::mutex                  x_minerWork;
+	// Declared ahead of the miners so that it outlives them
+	WorkerPool                          m_workerPool;
 	Miners                              m_miners;
 	Work                                m_work;
 
@@ -149,6 +169,9 @@ private:
 	mutable WorkingProgress             m_progress;
 
 	SolutionFound                       m_onSolutionFound;
+	mutable SubmitQueue                 m_submitQueue;
+	std::thread                         m_submitThread;
+	mutable SolutionVerifier            m_verifier;
 	MinerRestart                        m_onMinerRestart;
 
 	//std::map<std::string, SealerDescriptor> m_sealers;
@@ -171,13 +194,8 @@ private:
     unsigned m_tstart = 0;
     unsigned m_tstop = 0;
 
-    // Wrappers for hardware monitoring libraries
-    wrap_nvml_handle *nvmlh = nullptr;
-    wrap_adl_handle *adlh = nullptr;
-
-#if defined(__linux)
-    wrap_amdsysfs_handle *sysfsh = nullptr;
-#endif
+    // Samples the sensors off the io_service, null without --HWMON
+    std::unique_ptr<HwSampler> m_sampler;
 };
 
 } //! namespace energi
@@ -5,7 +5,9 @@
  *      Author: ranjeet
  */
 
+#include <algorithm>
 #include <iomanip>
+#include <limits>
 #include <mutex>
 #include <iostream>
 #include <sstream>
@@ -38,6 +40,17 @@ void Miner::updateHashRate(uint64_t _n)
     m_hashRate.store(hr, std::memory_order_relaxed);
 }
 
+void Miner::verifyNonce(const std::shared_ptr<const Work>& work, uint64_t nonce) const
+{
+    Candidate candidate;
+    candidate.work = work;
+    candidate.nonce = nonce;
+    candidate.miner = name();
+    candidate.evaluate = !s_noeval;
+    candidate.found = std::chrono::steady_clock::now();
+    m_plant.verifyProof(std::move(candidate));
+}
+
 bool Miner::LoadNrgHashDAG(uint64_t blockHeight)
 {
     // initialize the DAG
@@ -99,6 +112,19 @@ uint256 Miner::GetPOWHash(const BlockHeader& header)
     return uint256(ret.value);
 }
 
+uint64_t Miner::maxBatchForTarget(uint64_t upper64OfBoundary, unsigned resultSlots)
+{
+    // A nonce meets the boundary with a probability of about (upper64 + 1) / 2^64,
+    // the headroom keeps bursts within the slots the kernel can report
+    const long double headroom = 0.25L;
+    const long double perNonce = (static_cast<long double>(upper64OfBoundary) + 1.0L) / 18446744073709551616.0L;
+    const long double batch = headroom * resultSlots / perNonce;
+    if (batch >= static_cast<long double>(std::numeric_limits<uint64_t>::max())) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return std::max<uint64_t>(1, static_cast<uint64_t>(batch));
+}
+
 std::unique_ptr<nrghash::dag_t> const & Miner::ActiveDAG(std::unique_ptr<nrghash::dag_t> next_dag)
 {
     using namespace std;
@@ -140,6 +166,14 @@ boost::filesystem::path Miner::GetDataDir()
 #endif
 }
 
+boost::filesystem::path Miner::DAGFilePath(uint64_t epoch)
+{
+    auto const & seedhash = nrghash::cache_t::get_seedhash(0).to_hex();
+    std::stringstream ss;
+    ss << std::hex << std::setw(4) << std::setfill('0') << epoch << "-" << seedhash.substr(0, 12) << ".dag";
+    return GetDataDir() / "dag" / ss.str();
+}
+
 void Miner::InitDAG(uint64_t blockHeight, nrghash::progress_callback_type callback)
 {
     using namespace nrghash;
@@ -147,10 +181,7 @@ void Miner::InitDAG(uint64_t blockHeight, nrghash::progress_callback_type callba
     auto const & dag = ActiveDAG();
     if (!dag) {
         auto const epoch = blockHeight / constants::EPOCH_LENGTH;
-        auto const & seedhash = cache_t::get_seedhash(0).to_hex();
-        std::stringstream ss;
-        ss << std::hex << std::setw(4) << std::setfill('0') << epoch << "-" << seedhash.substr(0, 12) << ".dag";
-        auto const epoch_file = GetDataDir() / "dag" / ss.str();
+        auto const epoch_file = DAGFilePath(epoch);
 
         std::cout << "\nDAG file for epoch " << epoch << " is " << epoch_file.string() << std::endl;
         // try to load the DAG from disk
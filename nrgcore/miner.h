@@ -27,6 +27,7 @@
 #define DAG_LOAD_MODE_PARALLEL	 0
 #define DAG_LOAD_MODE_SEQUENTIAL 1
 #define DAG_LOAD_MODE_SINGLE	 2
+#define DAG_LOAD_MODE_HOST	 3
 
 namespace energi {
 
@@ -93,8 +94,15 @@ public:
 public:
     static bool LoadNrgHashDAG(uint64_t blockHeight = 0);
     static boost::filesystem::path GetDataDir();
+    //! Where InitDAG() keeps the DAG file of an epoch
+    static boost::filesystem::path DAGFilePath(uint64_t epoch);
     static void InitDAG(uint64_t blockHeight, nrghash::progress_callback_type callback);
     static uint256 GetPOWHash(const BlockHeader& header);
+    /**
+     * @brief Largest batch of nonces expected to yield at most a quarter of
+     *        resultSlots candidates against the upper 64 bits of a boundary.
+     */
+    static uint64_t maxBatchForTarget(uint64_t upper64OfBoundary, unsigned resultSlots);
 
     static std::unique_ptr<nrghash::dag_t> const & ActiveDAG(std::unique_ptr<nrghash::dag_t> next_dag  = std::unique_ptr<nrghash::dag_t>());
 
@@ -111,6 +119,8 @@ protected:
     }
 
     void updateHashRate(uint64_t _n);
+    //! Hands a device reported nonce to the plant for CPU verification, never blocks on hashing
+    void verifyNonce(const std::shared_ptr<const Work>& work, uint64_t nonce) const;
 
     static unsigned s_dagLoadMode;
     static unsigned s_dagLoadIndex;
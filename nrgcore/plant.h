@@ -9,6 +9,9 @@
 #define PLANT_H_
 
 #include "primitives/solution.h"
+#include "verifier.h"
+
+#include <memory>
 
 namespace energi {
 
@@ -27,6 +30,11 @@ public:
 	 */
     //virtual void submit(const Solution &m) const = 0;
     virtual void submitProof(const Solution &m) const = 0;
+    /**
+     * @brief Called from a Miner with a nonce its device reported. Checked
+     *        off the miner thread and submitted when it meets the target.
+     */
+    virtual void verifyProof(Candidate &&candidate) const = 0;
 	virtual void failedSolution() = 0;
     virtual uint64_t getStartNonce(const Work& work, unsigned idx) const = 0;
 };
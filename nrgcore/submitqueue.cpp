@@ -0,0 +1,84 @@
+/*
+ * SubmitQueue.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "submitqueue.h"
+
+#include <algorithm>
+
+using namespace energi;
+
+const size_t SubmitQueue::c_defaultCapacity;
+
+bool SubmitQueue::push(const Solution& solution)
+{
+    {
+        std::lock_guard<std::mutex> lock(x_queue);
+        if (m_closed || m_queue.size() >= m_capacity) {
+            ++m_stats.drops;
+            return false;
+        }
+        m_queue.push_back(solution);
+        m_stats.maxDepth = std::max(m_stats.maxDepth, m_queue.size());
+    }
+    m_ready.notify_one();
+    return true;
+}
+
+bool SubmitQueue::pop(Solution& solution, const std::chrono::milliseconds& timeout)
+{
+    std::unique_lock<std::mutex> lock(x_queue);
+    if (!m_ready.wait_for(lock, timeout, [&] { return m_closed || !m_queue.empty(); })) {
+        return false;
+    }
+    if (m_queue.empty()) {
+        return false;
+    }
+    solution = std::move(m_queue.front());
+    m_queue.pop_front();
+    return true;
+}
+
+void SubmitQueue::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(x_queue);
+        m_closed = true;
+    }
+    m_ready.notify_all();
+}
+
+bool SubmitQueue::isClosed() const
+{
+    std::lock_guard<std::mutex> lock(x_queue);
+    return m_closed;
+}
+
+void SubmitQueue::recordAck(const std::chrono::milliseconds& findToAck)
+{
+    std::lock_guard<std::mutex> lock(x_queue);
+    uint64_t ms = static_cast<uint64_t>(std::max<std::chrono::milliseconds::rep>(0, findToAck.count()));
+    ++m_stats.acks;
+    m_stats.findToAckTotalMs += ms;
+    m_stats.findToAckMaxMs = std::max(m_stats.findToAckMaxMs, ms);
+}
+
+void SubmitQueue::recordSent(const std::chrono::microseconds& findToWire)
+{
+    std::lock_guard<std::mutex> lock(x_queue);
+    uint64_t us = static_cast<uint64_t>(std::max<std::chrono::microseconds::rep>(0, findToWire.count()));
+    ++m_stats.sent;
+    m_stats.findToWireTotalUs += us;
+    m_stats.findToWireMaxUs = std::max(m_stats.findToWireMaxUs, us);
+}
+
+SubmitStats SubmitQueue::stats() const
+{
+    std::lock_guard<std::mutex> lock(x_queue);
+    SubmitStats stats = m_stats;
+    stats.depth = m_queue.size();
+    return stats;
+}
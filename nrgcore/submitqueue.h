@@ -0,0 +1,89 @@
+/*
+ * SubmitQueue.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_SUBMITQUEUE_H_
+#define ENERGIMINER_SUBMITQUEUE_H_
+
+#include "primitives/solution.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+
+namespace energi {
+
+struct SubmitStats
+{
+    size_t   depth = 0;      // solutions waiting to be handed to the pool client
+    size_t   maxDepth = 0;
+    uint64_t drops = 0;      // solutions lost because the queue was full
+    uint64_t acks = 0;       // accepted or rejected by the pool
+    uint64_t findToAckTotalMs = 0;
+    uint64_t findToAckMaxMs = 0;
+    uint64_t sent = 0;       // written to the pool's socket
+    uint64_t findToWireTotalUs = 0;
+    uint64_t findToWireMaxUs = 0;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const SubmitStats& s)
+{
+    if (!s.acks && !s.drops && !s.depth && !s.sent) {
+        return os;
+    }
+    os << "[Q" << s.depth << "/" << s.maxDepth;
+    if (s.drops) {
+        os << ":D" << s.drops;
+    }
+    if (s.acks) {
+        os << " " << s.findToAckTotalMs / s.acks << "/" << s.findToAckMaxMs << " ms";
+    }
+    if (s.sent) {
+        os << " W" << s.findToWireTotalUs / s.sent << "/" << s.findToWireMaxUs << " us";
+    }
+    return os << "]";
+}
+
+/**
+ * @brief Bounded multi producer single consumer queue of found solutions.
+ *        Miners push from their hash loop and never wait for the pool,
+ *        a single consumer hands the solutions over to the pool client.
+ */
+class SubmitQueue
+{
+public:
+    static const size_t c_defaultCapacity = 64;
+
+    explicit SubmitQueue(size_t capacity = c_defaultCapacity)
+        : m_capacity(capacity)
+    {}
+
+    //! Returns false and counts a drop when the queue is full or closed
+    bool push(const Solution& solution);
+    //! Waits up to timeout for a solution, returns false on timeout or once closed and drained
+    bool pop(Solution& solution, const std::chrono::milliseconds& timeout);
+    void close();
+    bool isClosed() const;
+
+    void recordAck(const std::chrono::milliseconds& findToAck);
+    void recordSent(const std::chrono::microseconds& findToWire);
+    SubmitStats stats() const;
+
+private:
+    const size_t                m_capacity;
+    mutable std::mutex          x_queue;
+    std::condition_variable     m_ready;
+    std::deque<Solution>        m_queue;
+    bool                        m_closed = false;
+    SubmitStats                 m_stats;
+};
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_SUBMITQUEUE_H_ */
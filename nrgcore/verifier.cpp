@@ -0,0 +1,142 @@
+/*
+ * Verifier.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "verifier.h"
+#include "miner.h"
+#include "primitives/block.h"
+
+#include "common/Log.h"
+
+using namespace energi;
+
+const size_t SolutionVerifier::c_defaultCapacity;
+const unsigned SolutionVerifier::c_defaultThreads;
+
+namespace {
+
+//! Per thread state, the header hash only changes with the work
+class Evaluator
+{
+public:
+    nrghash::result_t hash(const std::shared_ptr<const Work>& work, uint64_t nonce)
+    {
+        if (work != m_work) {
+            CBlockHeaderTruncatedLE truncatedBlockHeader(*work);
+            m_header = nrghash::h256_t(&truncatedBlockHeader, sizeof(truncatedBlockHeader));
+            m_work = work;
+        }
+        const uint64_t epoch = work->nHeight / nrghash::constants::EPOCH_LENGTH;
+        const auto& dag = Miner::ActiveDAG();
+        if (dag && epoch == dag->epoch()) {
+            return nrghash::full::hash(*dag, m_header, nonce);
+        }
+        if (!m_cache || m_cache->epoch() != epoch) {
+            // Shared with anyone else holding the epoch, only built once
+            m_cache.reset(new nrghash::cache_t(work->nHeight));
+        }
+        return nrghash::light::hash(*m_cache, m_header, nonce);
+    }
+
+private:
+    std::shared_ptr<const Work>       m_work;
+    nrghash::h256_t                   m_header;
+    std::unique_ptr<nrghash::cache_t> m_cache;
+};
+
+}
+
+SolutionVerifier::~SolutionVerifier()
+{
+    stop();
+}
+
+void SolutionVerifier::start(unsigned threads)
+{
+    std::lock_guard<std::mutex> lock(x_queue);
+    m_stopping = false;
+    for (unsigned i = m_threads.size(); i < threads; ++i) {
+        m_threads.emplace_back(&SolutionVerifier::run, this, i);
+    }
+}
+
+void SolutionVerifier::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(x_queue);
+        m_stopping = true;
+    }
+    m_ready.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+bool SolutionVerifier::push(Candidate&& candidate)
+{
+    {
+        std::lock_guard<std::mutex> lock(x_queue);
+        if (m_stopping || m_queue.size() >= m_capacity) {
+            ++m_stats[candidate.miner].drops;
+            return false;
+        }
+        m_queue.push_back(std::move(candidate));
+    }
+    m_ready.notify_one();
+    return true;
+}
+
+std::map<std::string, VerifyStats> SolutionVerifier::stats() const
+{
+    std::lock_guard<std::mutex> lock(x_queue);
+    return m_stats;
+}
+
+void SolutionVerifier::run(unsigned index)
+{
+    setThreadName(("verify" + std::to_string(index)).c_str());
+    Evaluator evaluator;
+    while (true) {
+        Candidate candidate;
+        {
+            std::unique_lock<std::mutex> lock(x_queue);
+            m_ready.wait(lock, [&] { return m_stopping || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                break;
+            }
+            candidate = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        bool valid = false;
+        Work work;
+        try {
+            auto result = evaluator.hash(candidate.work, candidate.nonce);
+            work = *candidate.work;
+            work.nNonce = candidate.nonce;
+            work.hashMix = uint256(result.mixhash);
+            valid = !candidate.evaluate || work.meetsTarget(uint256(result.value));
+        } catch (const std::exception& e) {
+            cwarn << candidate.miner << " Verifying nonce " << candidate.nonce << " failed: " << e.what();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(x_queue);
+            auto& stats = m_stats[candidate.miner];
+            ++(valid ? stats.verified : stats.invalid);
+        }
+        if (!valid) {
+            cwarn << candidate.miner << " proposed invalid solution: " << work.GetHash().ToString() << " nonce: " << candidate.nonce;
+            continue;
+        }
+        cnote << candidate.miner << " Submitting block blockhash: " << work.GetHash().ToString()
+              << " height: " << work.nHeight << " nonce: " << candidate.nonce;
+        if (m_onVerified) {
+            m_onVerified(Solution(work, work.getSecondaryExtraNonce(), candidate.found));
+        }
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * Verifier.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_VERIFIER_H_
+#define ENERGIMINER_VERIFIER_H_
+
+#include "primitives/solution.h"
+#include "primitives/work.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace energi {
+
+//! A nonce reported by a device, not yet checked on the CPU
+struct Candidate
+{
+    std::shared_ptr<const Work>           work;
+    uint64_t                              nonce = 0;
+    std::string                           miner;
+    bool                                  evaluate = true;   // false with --noeval, only the mix hash is computed
+    std::chrono::steady_clock::time_point found;
+};
+
+struct VerifyStats
+{
+    uint64_t verified = 0;
+    uint64_t invalid = 0;
+    uint64_t drops = 0;     // candidates lost because the queue was full
+};
+
+/**
+ * @brief Re-evaluates device candidates on its own threads, so the device
+ *        threads go straight back to launching kernels. Candidates meeting
+ *        the target are handed on as solutions, carrying the mix hash.
+ */
+class SolutionVerifier
+{
+public:
+    static const size_t   c_defaultCapacity = 256;
+    static const unsigned c_defaultThreads = 2;
+
+    using Verified = std::function<void(const Solution&)>;
+
+    explicit SolutionVerifier(const Verified& onVerified, size_t capacity = c_defaultCapacity)
+        : m_onVerified(onVerified)
+        , m_capacity(capacity)
+    {}
+    ~SolutionVerifier();
+
+    void start(unsigned threads = c_defaultThreads);
+    void stop();
+
+    //! Never waits for hashing, returns false and counts a drop when full
+    bool push(Candidate&& candidate);
+
+    //! Counters per miner name
+    std::map<std::string, VerifyStats> stats() const;
+
+private:
+    void run(unsigned index);
+
+    const Verified                      m_onVerified;
+    const size_t                        m_capacity;
+    mutable std::mutex                  x_queue;
+    std::condition_variable             m_ready;
+    std::deque<Candidate>               m_queue;
+    bool                                m_stopping = false;
+    std::vector<std::thread>            m_threads;
+    std::map<std::string, VerifyStats>  m_stats;
+};
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_VERIFIER_H_ */
@@ -279,30 +279,6 @@ namespace
 		auto const serialized = HashType::serialize(deserialized);
 		return hash_words<HashType>(serialized);
 	}
-
-	template <typename HashFunc, typename DatasetType>
-	result_t hash_header_nonce(HashFunc hashfunc, DatasetType const & dataset, h256_t const & header_hash, uint64_t const nonce)
-	{
-		uint8_t const * nonce_bytes = reinterpret_cast<uint8_t const *>(&nonce);
-
-		// combine header_hash with nonce
-		uint8_t const bytes[sizeof(header_hash.b) + sizeof(nonce)] =
-		{
-			header_hash.b[ 0], header_hash.b[ 1], header_hash.b[ 2], header_hash.b[ 3],
-			header_hash.b[ 4], header_hash.b[ 5], header_hash.b[ 6], header_hash.b[ 7],
-			header_hash.b[ 8], header_hash.b[ 9], header_hash.b[10], header_hash.b[11],
-			header_hash.b[12], header_hash.b[13], header_hash.b[14], header_hash.b[15],
-			header_hash.b[16], header_hash.b[17], header_hash.b[18], header_hash.b[19],
-			header_hash.b[20], header_hash.b[21], header_hash.b[22], header_hash.b[23],
-			header_hash.b[24], header_hash.b[25], header_hash.b[26], header_hash.b[27],
-			header_hash.b[28], header_hash.b[29], header_hash.b[30], header_hash.b[31],
-
-			nonce_bytes[0], nonce_bytes[1], nonce_bytes[2], nonce_bytes[3],
-			nonce_bytes[4], nonce_bytes[5], nonce_bytes[6], nonce_bytes[7],
-		};
-
-		return hashfunc(dataset, bytes, sizeof(bytes));
-	}
 }
 
 namespace nrghash
@@ -1136,84 +1112,157 @@ namespace nrghash
 	}
 #endif // 0
 
-	// TODO: unify light & full implementation
 	namespace hashimoto
 	{
-		using mediator_get_dag_size = std::function<dag_t::size_type ()>;
-		using mediator_get_dag_item = std::function<std::vector<node> const (uint32_t index)>;
+		constexpr uint32_t HASH_WORDS = constants::HASH_BYTES / constants::WORD_BYTES;
+		constexpr uint32_t MIX_WORDS = constants::MIX_BYTES / constants::WORD_BYTES;
+		constexpr uint32_t MIX_NODES = constants::MIX_BYTES / constants::HASH_BYTES;
+
+		using item_t = uint32_t[HASH_WORDS];
 
-		result_t hash(void const * input_data, dag_t::size_type input_size, mediator_get_dag_size get_dag_size, mediator_get_dag_item get_dag_item)
+		// Works on fixed size buffers only, verification runs this for every
+		// candidate nonce and must not touch the allocator.
+		template <typename LookupFunc>
+		result_t hash(void const * input_data, size_t input_size, uint64_t dag_size, LookupFunc const & get_dag_item)
 		{
-			static constexpr auto w = constants::MIX_BYTES / constants::WORD_BYTES;
-			auto MIXNODES = (constants::MIX_BYTES / constants::HASH_BYTES);
+			// seed followed by the compressed mix, the input to the final hash
+			uint32_t s[HASH_WORDS + MIX_WORDS / 4];
+			if (::sha3_512(reinterpret_cast<uint8_t *>(s), constants::HASH_BYTES, static_cast<uint8_t const *>(input_data), input_size) != 0)
+			{
+				throw hash_exception("Unable to compute hash");
+			}
 
-			auto s = sha3_512(std::string(static_cast<const char*>(input_data), input_size));
-			decltype(s) mix;
-			for (uint32_t i = 0; i < MIXNODES; i++)
+			uint32_t mix[MIX_WORDS];
+			for (uint32_t i = 0; i < MIX_NODES; i++)
 			{
-				mix.insert(mix.end(), s.begin(), s.end());
+				::std::memcpy(mix + i * HASH_WORDS, s, constants::HASH_BYTES);
 			}
 
-			uint32_t const full_page_count = (uint32_t) ( get_dag_size() / constants::MIX_BYTES );
+			item_t item;
+			uint32_t const full_page_count = static_cast<uint32_t>(dag_size / constants::MIX_BYTES);
 			for (uint32_t i = 0; i < constants::ACCESSES; i++)
 			{
-				auto p = fnv(i ^ s[0].hword, mix[i % w].hword) % full_page_count;
-				for (uint32_t j = 0; j < MIXNODES; j++)
+				auto p = fnv(i ^ s[0], mix[i % MIX_WORDS]) % full_page_count;
+				for (uint32_t j = 0; j < MIX_NODES; j++)
 				{
-					auto h = get_dag_item(p * MIXNODES + j);
-					auto k = h.begin(), kEnd = h.end();
-					for (auto m = mix.begin() + j * w / 2, mEnd = mix.begin() + ( j + 1 ) * w / 2; m != mEnd && k != kEnd; m++, k++)
+					get_dag_item(p * MIX_NODES + j, item);
+					uint32_t * m = mix + j * HASH_WORDS;
+					for (uint32_t k = 0; k < HASH_WORDS; k++)
 					{
-						m->hword = fnv(m->hword, k->hword);
+						m[k] = fnv(m[k], item[k]);
 					}
 				}
 			}
 
-			decltype(s) cmix;
-			for (uint32_t i = 0; i < mix.size(); i += 4)
+			uint32_t * cmix = s + HASH_WORDS;
+			for (uint32_t i = 0; i < MIX_WORDS; i += 4)
 			{
-				cmix.push_back(node(fnv(fnv(fnv(mix[i].hword, mix[i+1].hword), mix[i+2].hword), mix[i+3].hword)));
+				cmix[i / 4] = fnv(fnv(fnv(mix[i], mix[i + 1]), mix[i + 2]), mix[i + 3]);
 			}
 
-			auto combined = std::move(s);
-			combined.insert(combined.end(), cmix.begin(), cmix.end());
-			auto v = sha3_256(combined);
 			result_t out;
-			::std::memcpy(&out.value.b[0], &v[0], ::std::min(sizeof(out.value.b), v.size() * sizeof(node)));
-			::std::memcpy(&out.mixhash.b[0], &cmix[0], ::std::min(sizeof(out.mixhash.b), cmix.size() * sizeof(node)));
+			if (::sha3_256(&out.value.b[0], sizeof(out.value.b), reinterpret_cast<uint8_t const *>(s), sizeof(s)) != 0)
+			{
+				throw hash_exception("Unable to compute hash");
+			}
+			::std::memcpy(&out.mixhash.b[0], cmix, sizeof(out.mixhash.b));
 			return out;
 		}
+
+		// Same as dag_t::impl_t::calc_dataset_item without the intermediate vectors
+		void calc_dataset_item(cache_t::data_type const & cache, uint32_t const i, item_t & out)
+		{
+			uint32_t const n = cache.size();
+			item_t mix;
+			::std::memcpy(mix, cache[i % n].data(), constants::HASH_BYTES);
+			mix[0] ^= i;
+			if (::sha3_512(reinterpret_cast<uint8_t *>(out), constants::HASH_BYTES, reinterpret_cast<uint8_t const *>(mix), constants::HASH_BYTES) != 0)
+			{
+				throw hash_exception("Unable to compute hash");
+			}
+			for (uint32_t j = 0; j < constants::DATASET_PARENTS; j++)
+			{
+				uint32_t const cache_index = fnv(i ^ j, out[j % HASH_WORDS]);
+				node const * parent = cache[cache_index % n].data();
+				for (uint32_t k = 0; k < HASH_WORDS; k++)
+				{
+					out[k] = fnv(out[k], parent[k].hword);
+				}
+			}
+			::std::memcpy(mix, out, constants::HASH_BYTES);
+			if (::sha3_512(reinterpret_cast<uint8_t *>(out), constants::HASH_BYTES, reinterpret_cast<uint8_t const *>(mix), constants::HASH_BYTES) != 0)
+			{
+				throw hash_exception("Unable to compute hash");
+			}
+		}
+
+		template <typename LookupFunc>
+		result_t hash_header_nonce(h256_t const & header_hash, uint64_t const nonce, uint64_t dag_size, LookupFunc const & get_dag_item)
+		{
+			// combine header_hash with nonce
+			uint8_t bytes[sizeof(header_hash.b) + sizeof(nonce)];
+			::std::memcpy(bytes, &header_hash.b[0], sizeof(header_hash.b));
+			::std::memcpy(bytes + sizeof(header_hash.b), &nonce, sizeof(nonce));
+			return hash(bytes, sizeof(bytes), dag_size, get_dag_item);
+		}
 	}
+
 	namespace full
 	{
-
+		namespace
+		{
+			struct lookup
+			{
+				dag_t::data_type const & data;
+				void operator()(uint32_t index, hashimoto::item_t & out) const
+				{
+					::std::memcpy(out, data[index].data(), constants::HASH_BYTES);
+				}
+			};
+		}
 
 		result_t hash(dag_t const & dag, void const * input_data, dag_t::size_type input_size)
 		{
-			return hashimoto::hash(input_data, input_size
-					, [&]() -> dag_t::size_type { return dag.size(); }
-					, [&](uint32_t index) -> std::vector<node> const { return dag.data()[index]; });
+			return hashimoto::hash(input_data, input_size, dag.size(), lookup{dag.data()});
 		}
+
 		result_t hash(dag_t const & dag, h256_t const & header_hash, uint64_t const nonce)
 		{
-			std::function<result_t (dag_t const &, void const *, dag_t::size_type)> hash_func = static_cast<result_t (*)(dag_t const &, void const *, dag_t::size_type)>(&hash);
-			return hash_header_nonce(hash_func, dag, header_hash, nonce);
+			return hashimoto::hash_header_nonce(header_hash, nonce, dag.size(), lookup{dag.data()});
 		}
 	}
 
 	namespace light
 	{
+		namespace
+		{
+			struct lookup
+			{
+				cache_t::data_type const & data;
+				void operator()(uint32_t index, hashimoto::item_t & out) const
+				{
+					hashimoto::calc_dataset_item(data, index, out);
+				}
+			};
+		}
+
 		result_t hash(cache_t const & cache, void const * input_data, cache_t::size_type input_size)
 		{
-			return hashimoto::hash(input_data, input_size
-					, [&]() -> dag_t::size_type { return dag_t::get_full_size((cache.epoch() * constants::EPOCH_LENGTH)); }
-					, [&](uint32_t index) -> std::vector<node> const { return dag_t::impl_t::calc_dataset_item(cache.data(), index); });
+			return hashimoto::hash(input_data, input_size, dag_t::get_full_size(cache.epoch() * constants::EPOCH_LENGTH), lookup{cache.data()});
 		}
 
 		result_t hash(cache_t const & cache, h256_t const & header_hash, uint64_t const nonce)
 		{
-			std::function<result_t (cache_t const &, void const *, cache_t::size_type)> hash_func = static_cast<result_t (*)(cache_t const &, void const *, cache_t::size_type)>(&hash);
-			return hash_header_nonce(hash_func, cache, header_hash, nonce);
+			return hashimoto::hash_header_nonce(header_hash, nonce, dag_t::get_full_size(cache.epoch() * constants::EPOCH_LENGTH), lookup{cache.data()});
+		}
+
+		h512_t calc_dataset_item(cache_t const & cache, uint32_t const index)
+		{
+			hashimoto::item_t item;
+			hashimoto::calc_dataset_item(cache.data(), index, item);
+			h512_t out;
+			::std::memcpy(&out.b[0], item, sizeof(out.b));
+			return out;
 		}
 	}
 
@@ -711,6 +711,15 @@ namespace nrghash
 		*	\return result_t containing hashed data
 		*/
 		result_t hash(cache_t const & cache, h256_t const & header_hash, uint64_t const nonce);
+
+		/** \brief Compute a single DAG item from the cache, the unit of work of both DAG generation and light hashing.
+		*
+		*	\param cache A const reference to the cache for the current epoch
+		*	\param index The index of the 64 byte DAG item
+		*	\throws hash_exception on error
+		*	\return h512_t containing the DAG item
+		*/
+		h512_t calc_dataset_item(cache_t const & cache, uint32_t const index);
 	}
 }
 
@@ -4,13 +4,17 @@
 #include <iostream>
 #include <sstream>
 #include <cstdlib>
+#include <memory>
+#include <mutex>
 #include <vector>
 
 #include "transaction.h"
 #include "common/utilstrencodings.h"
 #include "common/serialize.h"
+#include "common/streams.h"
 #include "uint256.h"
 #include "extranoncesingleton.h"
+#include "templatecache.h"
 
 namespace energi {
 
@@ -100,9 +104,51 @@ struct BlockHeader
     }
 };
 
+//! Fields of a mining.notify, independent of how the message was parsed
+struct StratumJob
+{
+    std::string jobName;
+    std::string prevHash;
+    std::string coinbase1;
+    std::string coinbase2;
+    std::vector<std::string> transactions; // hex encoded
+    uint32_t version = 0;
+    uint32_t bits = 0;
+    uint32_t time = 0;
+    uint32_t height = 0;
+    bool clean = false;
+
+    static StratumJob fromJson(const Json::Value& jPrm)
+    {
+        StratumJob job;
+        job.jobName = jPrm.get((Json::Value::ArrayIndex)0, "").asString();
+        job.prevHash = jPrm.get((Json::Value::ArrayIndex)1, "").asString();
+        job.coinbase1 = jPrm.get((Json::Value::ArrayIndex)2, "").asString();
+        job.coinbase2 = jPrm.get((Json::Value::ArrayIndex)3, "").asString();
+        const auto merkleBranches = jPrm.get((Json::Value::ArrayIndex)4, "");
+        for (const auto& branch : merkleBranches) {
+            job.transactions.push_back(branch["data"].asString());
+        }
+        job.version = std::stoul(jPrm.get((Json::Value::ArrayIndex)5, "").asString(), 0, 16);
+        job.bits = std::stoul(jPrm.get((Json::Value::ArrayIndex)6, "").asString(), 0, 16);
+        job.time = std::stoul(jPrm.get((Json::Value::ArrayIndex)7, "").asString(), 0, 16);
+        job.clean = jPrm.get((Json::Value::ArrayIndex)8, "").asBool();
+        job.height = jPrm.get((Json::Value::ArrayIndex)9, "").asUInt();
+        return job;
+    }
+};
+
 struct Block : public BlockHeader
 {
-    std::vector<CTransaction> vtx;
+    std::vector<CTransactionRef> vtx;
+
+    //! Hex of the transactions after the coinbase, which stay the same for all copies of a template
+    struct TemplateTransactions
+    {
+        std::once_flag encoded;
+        std::string    hex;
+    };
+    std::shared_ptr<TemplateTransactions> templateTxs;
 
     CTxOut txoutBackbone; // Energibackbone payment
     CTxOut txoutMasternode; // masternode payment
@@ -116,40 +162,46 @@ struct Block : public BlockHeader
 
     Block(const Json::Value& jPrm,
           const std::string& extraNonce, bool)
+        : Block(StratumJob::fromJson(jPrm), extraNonce)
+    {
+    }
+
+    Block(const StratumJob& job,
+          const std::string& extraNonce)
     {
-        hashPrevBlock = uint256S(jPrm.get((Json::Value::ArrayIndex)1, "").asString());
+        hashPrevBlock = uint256S(job.prevHash);
         hashMerkleRoot.SetNull();
-        nVersion = std::stoul(jPrm.get((Json::Value::ArrayIndex)5, "").asString(), 0, 16);
-        nTime = std::stoul(jPrm.get((Json::Value::ArrayIndex)7, "").asString(), 0, 16);
-        nBits = std::stoul(jPrm.get((Json::Value::ArrayIndex)6, "").asString(), 0, 16);
+        nVersion = job.version;
+        nTime = job.time;
+        nBits = job.bits;
         hashMix.SetNull();
         nNonce = 0;
-        nHeight = jPrm.get((Json::Value::ArrayIndex)9, "").asUInt();
+        nHeight = job.height;
 
-        std::string coinbase1 = jPrm.get((Json::Value::ArrayIndex)2, "").asString();
-        std::string coinbase2 = jPrm.get((Json::Value::ArrayIndex)3, "").asString();
-        std::string hexData = coinbase1 + extraNonce +/* + "00000000" +*/ coinbase2;
+        std::string hexData = job.coinbase1 + extraNonce +/* + "00000000" +*/ job.coinbase2;
         CTransaction coinbaseTx;
         DecodeHexTx(coinbaseTx, hexData);
 
-        vtx.push_back(coinbaseTx);
-        vtx[0].UpdateHash();
-        const auto merkleBranches = jPrm.get((Json::Value::ArrayIndex)4, "");
-        for (const auto branch : merkleBranches) {
+        templateTxs = std::make_shared<TemplateTransactions>();
+        vtx.reserve(job.transactions.size() + 1);
+        vtx.push_back(MakeTransactionRef(std::move(coinbaseTx)));
+        vtx[0]->UpdateHash();
+        for (const auto& data : job.transactions) {
             CTransaction trans;
-            DecodeHexTx(trans, branch["data"].asString());
-            vtx.push_back(trans);
+            DecodeHexTx(trans, data);
+            vtx.push_back(MakeTransactionRef(std::move(trans)));
         }
     }
 
     Block(const Json::Value& gbt,
-          const std::string& coinbaseAddress)
+          const std::string& coinbaseAddress,
+          TemplateCache* cache = nullptr)
         : BlockHeader(gbt)
     {
         if ( !( gbt.isMember("height") && gbt.isMember("version") && gbt.isMember("previousblockhash") ) ) {
             throw WorkException("Height or Version or Previous Block Hash not found");
         }
-        fillTransactions(gbt, coinbaseAddress);
+        fillTransactions(gbt, coinbaseAddress, cache);
     }
 
     Block(const BlockHeader& header)
@@ -158,8 +210,10 @@ struct Block : public BlockHeader
         *((BlockHeader*)this) = header;
     }
 
+    //! With a cache, transactions already decoded for an earlier template are copied from it
     void fillTransactions(const Json::Value& gbt,
-                          const std::string& coinbaseAddress)
+                          const std::string& coinbaseAddress,
+                          TemplateCache* cache = nullptr)
     {
         if (coinbaseAddress.empty()) {
             std::cerr << "Empty coinbase address" << std::endl;
@@ -182,7 +236,7 @@ struct Block : public BlockHeader
             uint64_t masternodeAmount = 0;
             //bool const masternode_payments_enforced = gbt["masternode_payments_enforced"].asBool(); // not used currently
             if (masternode_payments_started && !gbt["masternode"].empty()) {
-                auto mast = gbt["masternode"];
+                const auto& mast = gbt["masternode"];
                 std::string scriptStr = mast["script"].asString();
                 if (!IsHex(scriptStr)) {
                     throw WorkException("Cannot decode script");
@@ -202,7 +256,7 @@ struct Block : public BlockHeader
             bool is_superblock=false;
             bool const superblocks_enabled = gbt["superblocks_enabled"].asBool();
             if (superblocks_enabled) {
-                const auto superblock = gbt["superblock"];
+                const auto& superblock = gbt["superblock"];
                 if (superblock.size()  > 0) {
                     is_superblock=true;
                     for (const auto& proposal_payee : superblock) {
@@ -222,14 +276,20 @@ struct Block : public BlockHeader
             }
             //! end Backbone transaction
 
-            vtx.push_back(coinbaseTransaction);
-            vtx[0].UpdateHash();
+            templateTxs = std::make_shared<TemplateTransactions>();
+            vtx.push_back(MakeTransactionRef(std::move(coinbaseTransaction)));
+            vtx[0]->UpdateHash();
 
-            auto transactions = gbt["transactions"];
+            const Json::Value& transactions = gbt["transactions"];
+            vtx.reserve(transactions.size() + 1);
             for (const auto& txn : transactions) {
+                if (cache) {
+                    vtx.push_back(cache->transaction(txn));
+                    continue;
+                }
                 CTransaction trans;
                 DecodeHexTx(trans, txn["data"].asString());
-                vtx.push_back(trans);
+                vtx.push_back(MakeTransactionRef(std::move(trans)));
             }
         }
     }
@@ -258,9 +318,47 @@ struct Block : public BlockHeader
         READWRITE(vtx);
     }
 
+    /**
+     * @brief Appends the hex of the serialized block to hex. Only the header
+     *        and the coinbase are serialized each time, the transactions
+     *        after the coinbase are encoded once per template and shared by
+     *        all of its copies.
+     */
+    void appendSubmitHex(std::string& hex, int nType, int nVersion) const
+    {
+        // Capacity is kept between calls, a submit serializes without allocating
+        thread_local std::vector<unsigned char> buffer;
+        buffer.clear();
+        CVectorWriter writer(nType, nVersion, buffer, 0);
+        writer << *(const BlockHeader*)this;
+        WriteCompactSize(writer, vtx.size());
+        if (!vtx.empty()) {
+            writer << vtx[0];
+        }
+        if (!templateTxs) {
+            for (size_t i = 1; i < vtx.size(); ++i) {
+                writer << vtx[i];
+            }
+            HexEncode(buffer.data(), buffer.size(), hex);
+            return;
+        }
+        std::call_once(templateTxs->encoded, [&] {
+            std::vector<unsigned char> txs;
+            CVectorWriter txWriter(nType, nVersion, txs, 0);
+            for (size_t i = 1; i < vtx.size(); ++i) {
+                txWriter << vtx[i];
+            }
+            HexEncode(txs.data(), txs.size(), templateTxs->hex);
+        });
+        hex.reserve(hex.size() + 2 * buffer.size() + templateTxs->hex.size());
+        HexEncode(buffer.data(), buffer.size(), hex);
+        hex += templateTxs->hex;
+    }
+
     void SetNull()
     {
         BlockHeader::SetNull();
+        templateTxs.reset();
         vtx.clear();
         txoutBackbone = CTxOut();
         txoutMasternode = CTxOut();
@@ -287,11 +385,9 @@ struct CBlockHeaderTruncatedLE
         , nBits(htole32(header.nBits))
         , nHeight(htole32(header.nHeight))
     {
-        auto prevHash = header.hashPrevBlock.ToString();
-        memcpy(hashPrevBlock, prevHash.c_str(), (std::min)(prevHash.size(), sizeof(hashPrevBlock)));
-
-        auto merkleRoot = header.hashMerkleRoot.ToString();
-        memcpy(hashMerkleRoot, merkleRoot.c_str(), (std::min)(merkleRoot.size(), sizeof(hashMerkleRoot)));
+        // 64 digits each, the zeroed last byte terminates them
+        header.hashPrevBlock.GetHex(hashPrevBlock);
+        header.hashMerkleRoot.GetHex(hashMerkleRoot);
     }
 };
 
@@ -307,8 +403,7 @@ struct CBlockHeaderFullLE : public CBlockHeaderTruncatedLE
         , nNonce(h.nNonce)
         , hashMix{0}
     {
-        auto mixString = h.hashMix.ToString();
-        memcpy(hashMix, mixString.c_str(), (std::min)(mixString.size(), sizeof(hashMix)));
+        h.hashMix.GetHex(hashMix);
     }
 };
 static_assert(sizeof(CBlockHeaderFullLE) == 219, "CBlockHeaderFullLE has incorrect size");
@@ -7,6 +7,25 @@
 #include "common/common.h"
 #include "sha256.h"
 
+#if (defined(__x86_64__) || defined(__amd64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#define HAVE_GETCPUID 1
+#endif
+
+
+#ifdef ENABLE_SHANI
+namespace sha256_shani
+{
+void Transform(uint32_t* s, const unsigned char* chunk, size_t blocks);
+}
+#endif
+
+#ifdef ENABLE_AVX2
+namespace sha256d64_avx2
+{
+void Transform_8way(unsigned char* out, const unsigned char* in);
+}
+#endif
 
 // Internal implementation code.
 namespace
@@ -128,10 +147,158 @@ void Transform(uint32_t* s, const unsigned char* chunk)
     s[7] += h;
 }
 
+void TransformBlocks(uint32_t* s, const unsigned char* chunk, size_t blocks)
+{
+    while (blocks--) {
+        Transform(s, chunk);
+        chunk += 64;
+    }
+}
+
 } // namespace sha256
+
+typedef void (*TransformType)(uint32_t*, const unsigned char*, size_t);
+typedef void (*TransformD64Type)(unsigned char*, const unsigned char*);
+
+// Statically initialised to the portable code, so hashing during static
+// initialisation works before the detection below has run.
+TransformType Transform = sha256::TransformBlocks;
+TransformD64Type TransformD64_8way = nullptr;
+const char* g_implementation = "standard";
+
+/** Padding block of a 64-byte message. */
+const unsigned char c_pad64[64] = {
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x02, 0x00
+};
+
+/** Padding after a 32-byte digest, completing its only block. */
+const unsigned char c_pad32[32] = {
+    0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0x00
+};
+
+/** Double SHA-256 of one 64-byte input, with the given transform. */
+void TransformD64(TransformType transform, unsigned char* out, const unsigned char* in)
+{
+    uint32_t s[8];
+    unsigned char buf[64];
+    sha256::Initialize(s);
+    transform(s, in, 1);
+    transform(s, c_pad64, 1);
+    for (int i = 0; i < 8; ++i) {
+        WriteBE32(buf + 4 * i, s[i]);
+    }
+    memcpy(buf + 32, c_pad32, 32);
+    sha256::Initialize(s);
+    transform(s, buf, 1);
+    for (int i = 0; i < 8; ++i) {
+        WriteBE32(out + 4 * i, s[i]);
+    }
+}
+
+/** Whether the selected implementations agree with the portable code, like Bitcoin Core's SelfTest(). */
+bool SelfTest()
+{
+    // Eight 64-byte inputs, enough for one 8-way call
+    unsigned char data[8 * 64];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = static_cast<unsigned char>(i * 167 + 13);
+    }
+    for (size_t blocks = 1; blocks <= 3; ++blocks) {
+        uint32_t expected[8];
+        uint32_t actual[8];
+        sha256::Initialize(expected);
+        sha256::Initialize(actual);
+        sha256::TransformBlocks(expected, data, blocks);
+        Transform(actual, data, blocks);
+        if (memcmp(expected, actual, sizeof(expected))) {
+            return false;
+        }
+    }
+    unsigned char expected[8 * 32];
+    unsigned char actual[8 * 32];
+    for (size_t i = 0; i < 8; ++i) {
+        TransformD64(sha256::TransformBlocks, expected + 32 * i, data + 64 * i);
+    }
+    SHA256D64(actual, data, 8);
+    return !memcmp(expected, actual, sizeof(expected));
+}
+
+#if defined(HAVE_GETCPUID) && defined(ENABLE_AVX2)
+/** Whether the OS saves the AVX registers on context switches. */
+bool AVXEnabled()
+{
+    uint32_t a, d;
+    __asm__("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    return (a & 6) == 6;
+}
+#endif
+
+/** Selects the implementations once, before main runs. */
+struct SHA256Detect
+{
+    SHA256Detect() { SHA256AutoDetect(); }
+} g_sha256Detect;
+
 } // namespace
 
 
+std::string SHA256AutoDetect()
+{
+#if defined(HAVE_GETCPUID) && (defined(ENABLE_SHANI) || defined(ENABLE_AVX2))
+    uint32_t eax, ebx, ecx, edx;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && __get_cpuid_max(0, nullptr) >= 7) {
+        const uint32_t features = ecx;
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+#if defined(ENABLE_SHANI)
+        const bool have_sse4 = (features >> 19) & 1;
+        const bool have_shani = (ebx >> 29) & 1;
+        if (have_shani && have_sse4) {
+            Transform = sha256_shani::Transform;
+            g_implementation = "shani(1way)";
+        }
+#endif
+#if defined(ENABLE_AVX2)
+        // Three SHA-NI transforms per 64-byte input beat the 8-way code, it is for processors without them
+        const bool enabled_avx = ((features >> 27) & 1) && ((features >> 28) & 1) && AVXEnabled();
+        const bool have_avx2 = (ebx >> 5) & 1;
+        if (have_avx2 && enabled_avx && Transform == sha256::TransformBlocks) {
+            TransformD64_8way = sha256d64_avx2::Transform_8way;
+            g_implementation = "standard,avx2(8way)";
+        }
+#endif
+    }
+    if (!SelfTest()) {
+        // A wrong hash would only show up as rejected blocks, so fall back to the portable code
+        Transform = sha256::TransformBlocks;
+        TransformD64_8way = nullptr;
+        g_implementation = "standard (accelerated code failed its self-test)";
+    }
+#endif
+    return g_implementation;
+}
+
+void SHA256D64(unsigned char* out, const unsigned char* in, size_t blocks)
+{
+    if (TransformD64_8way) {
+        while (blocks >= 8) {
+            TransformD64_8way(out, in);
+            out += 256;
+            in += 512;
+            blocks -= 8;
+        }
+    }
+    while (blocks) {
+        TransformD64(Transform, out, in);
+        out += 32;
+        in += 64;
+        --blocks;
+    }
+}
+
 ////// SHA-256
 
 CSHA256::CSHA256() : bytes(0)
@@ -148,14 +315,15 @@ CSHA256& CSHA256::Write(const unsigned char* data, size_t len)
         memcpy(buf + bufsize, data, 64 - bufsize);
         bytes += 64 - bufsize;
         data += 64 - bufsize;
-        sha256::Transform(s, buf);
+        Transform(s, buf, 1);
         bufsize = 0;
     }
-    while (end >= data + 64) {
+    if (end - data >= 64) {
         // Process full chunks directly from the source.
-        sha256::Transform(s, data);
-        bytes += 64;
-        data += 64;
+        size_t blocks = (end - data) / 64;
+        Transform(s, data, blocks);
+        data += 64 * blocks;
+        bytes += 64 * blocks;
     }
     if (end > data) {
         // Fill the buffer with what remains.
@@ -26,9 +26,9 @@ std::string Solution::getSubmitBlockData() const
     if (!m_work.isValid()) {
         throw WorkException("Invalid work, solution must be wrong!");
     }
-    std::stringstream ss;
+    std::string hex;
     //! TODO check and provid correct nType and nVersion for this operation
-    m_work.Serialize(ss, (1 << 0), 70208);
-    return strToHex(ss.str());
+    m_work.appendSubmitHex(hex, SER_NETWORK, 70208);
+    return hex;
 }
 
@@ -8,6 +8,7 @@
 #ifndef ENERGIMINER_SOLUTION_H_
 #define ENERGIMINER_SOLUTION_H_
 
+#include <chrono>
 #include <functional>
 #include <iostream>
 
@@ -26,6 +27,13 @@ public:
     Solution(Work work, unsigned extraNonce)
         : m_extraNonce(extraNonce)
         , m_work(work)
+        , m_found(std::chrono::steady_clock::now())
+    {}
+
+    Solution(Work work, unsigned extraNonce, const std::chrono::steady_clock::time_point& found)
+        : m_extraNonce(extraNonce)
+        , m_work(work)
+        , m_found(found)
     {}
 
     std::string getSubmitBlockData() const;
@@ -44,6 +52,11 @@ public:
         return stream.str();
     }
 
+    unsigned getExtraNonceValue() const
+    {
+        return m_extraNonce;
+    }
+
     inline std::string getExtraNonce() const
     {
         std::stringstream stream;
@@ -72,6 +85,12 @@ public:
         return m_work.getMerkleRoot();
     }
 
+    //! When the miner found the solution, base of the find to ack latency
+    const std::chrono::steady_clock::time_point& getFoundTime() const
+    {
+        return m_found;
+    }
+
     void reset()
     {
         m_extraNonce = 0;
@@ -83,6 +102,7 @@ public:
 
 private:
     Work m_work;
+    std::chrono::steady_clock::time_point m_found;
 };
 
 using SolutionFoundCallback = std::function<void(const Solution&)>;
@@ -0,0 +1,114 @@
+/*
+ * TemplateCache.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "templatecache.h"
+
+#include "sha256.h"
+
+namespace energi {
+
+namespace {
+
+void write(CSHA256& hasher, const std::string& str)
+{
+    // Separated, so that adjacent fields cannot run into each other
+    hasher.Write(reinterpret_cast<const unsigned char*>(str.data()), str.size());
+    hasher.Write(reinterpret_cast<const unsigned char*>(""), 1);
+}
+
+void write(CSHA256& hasher, const Json::Value& value)
+{
+    if (value.isObject()) {
+        for (const auto& name : value.getMemberNames()) {
+            write(hasher, name);
+            write(hasher, value[name]);
+        }
+    } else if (value.isArray()) {
+        write(hasher, std::to_string(value.size()));
+        for (const auto& item : value) {
+            write(hasher, item);
+        }
+    } else if (value.isString()) {
+        write(hasher, value.asString());
+    } else if (value.isBool()) {
+        write(hasher, std::string(value.asBool() ? "true" : "false"));
+    } else if (value.isInt64()) {
+        write(hasher, std::to_string(value.asInt64()));
+    } else if (value.isUInt64()) {
+        write(hasher, std::to_string(value.asUInt64()));
+    } else if (!value.isNull()) {
+        write(hasher, std::to_string(value.asDouble()));
+    }
+}
+
+//! txid of a template transaction, older nodes only name it hash
+const Json::Value& txid(const Json::Value& txn)
+{
+    const Json::Value& id = txn["txid"];
+    return id.isString() ? id : txn["hash"];
+}
+
+} //! anonymous namespace
+
+uint256 TemplateCache::fingerprint(const Json::Value& gbt)
+{
+    static const char* const c_fields[] = {
+        "version", "previousblockhash", "height", "bits", "coinbasevalue",
+        "masternode", "masternode_payments_started", "superblock", "superblocks_enabled", "backbone"
+    };
+    CSHA256 hasher;
+    for (const char* field : c_fields) {
+        write(hasher, gbt[field]);
+    }
+    // The txids stand for the transactions, their data is only hashed when a node sends none
+    const Json::Value& transactions = gbt["transactions"];
+    write(hasher, std::to_string(transactions.size()));
+    for (const auto& txn : transactions) {
+        const Json::Value& id = txid(txn);
+        write(hasher, id.isString() ? id : txn["data"]);
+    }
+    uint256 result;
+    hasher.Finalize(result.begin());
+    return result;
+}
+
+CTransactionRef TemplateCache::transaction(const Json::Value& txn)
+{
+    const Json::Value& id = txid(txn);
+    if (!id.isString()) {
+        CTransaction tx;
+        DecodeHexTx(tx, txn["data"].asString());
+        ++m_decoded;
+        return MakeTransactionRef(std::move(tx));
+    }
+    auto it = m_transactions.find(id.asString());
+    if (it == m_transactions.end()) {
+        CTransaction tx;
+        ++m_decoded;
+        if (!DecodeHexTx(tx, txn["data"].asString())) {
+            // Not cached, a broken entry is decoded again rather than kept
+            return MakeTransactionRef(std::move(tx));
+        }
+        it = m_transactions.emplace(id.asString(), Entry{MakeTransactionRef(std::move(tx)), m_generation}).first;
+    }
+    it->second.generation = m_generation;
+    return it->second.tx;
+}
+
+void TemplateCache::sweep()
+{
+    for (auto it = m_transactions.begin(); it != m_transactions.end();) {
+        if (it->second.generation != m_generation) {
+            it = m_transactions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    ++m_generation;
+}
+
+} //! namespace energi
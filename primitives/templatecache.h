@@ -0,0 +1,69 @@
+/*
+ * TemplateCache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_TEMPLATECACHE_H_
+#define ENERGIMINER_TEMPLATECACHE_H_
+
+#include <json/json.h>
+
+#include <string>
+#include <unordered_map>
+
+#include "transaction.h"
+#include "uint256.h"
+
+namespace energi {
+
+/**
+ * @brief Decoded transactions of the recent getblocktemplate results, keyed
+ *        by txid. Consecutive templates mostly share their transactions, so
+ *        a poll only decodes and hashes the ones it has not seen yet, and
+ *        the blocks built from it share the same transaction objects.
+ *        Not thread safe, the owner serializes the template updates.
+ */
+class TemplateCache
+{
+public:
+    /**
+     * @brief Hash of everything in gbt that ends up in the block, apart from
+     *        the time. Two templates with the same fingerprint give the same
+     *        block, so a poll returning it again is not worth any work.
+     */
+    static uint256 fingerprint(const Json::Value& gbt);
+
+    //! Decoded transaction of the template entry txn, decoded on first sight only
+    CTransactionRef transaction(const Json::Value& txn);
+
+    //! Drops the transactions no template asked for since the previous sweep
+    void sweep();
+
+    size_t size() const
+    {
+        return m_transactions.size();
+    }
+
+    //! Transactions decoded since construction, for the statistics
+    uint64_t decoded() const
+    {
+        return m_decoded;
+    }
+
+private:
+    struct Entry
+    {
+        CTransactionRef tx;
+        unsigned        generation;
+    };
+
+    std::unordered_map<std::string, Entry> m_transactions;
+    unsigned     m_generation = 0;
+    uint64_t     m_decoded = 0;
+};
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_TEMPLATECACHE_H_ */
@@ -247,6 +247,10 @@ public:
 
     /** Convert a CMutableTransaction into a CTransaction. */
     CTransaction(const CMutableTransaction &tx);
+    CTransaction(CMutableTransaction &&tx);
+
+    CTransaction(const CTransaction &tx) = default;
+    CTransaction(CTransaction &&tx) = default;
 
     CTransaction& operator=(const CTransaction& tx);
 
@@ -348,6 +352,15 @@ struct CMutableTransaction
 
 };
 
+/**
+ * Transactions do not change once a template is built, so the copies of a
+ * block handed to the miners and solutions share them instead of copying
+ * every input, output and script.
+ */
+typedef std::shared_ptr<const CTransaction> CTransactionRef;
+static inline CTransactionRef MakeTransactionRef() { return std::make_shared<const CTransaction>(); }
+template <typename Tx> static inline CTransactionRef MakeTransactionRef(Tx&& txIn) { return std::make_shared<const CTransaction>(std::forward<Tx>(txIn)); }
+
 /** Implementation of BIP69
  * https://github.com/bitcoin/bips/blob/master/bip-0069.mediawiki
  */
@@ -378,11 +391,12 @@ struct CompareOutputBIP69
 
 inline bool DecodeHexTx(CTransaction& tx, const std::string& strHexTx)
 {
-    if (!IsHex(strHexTx)) {
+    // Validated while decoding, a string that is not all hex pairs decodes short
+    std::vector<unsigned char> txData(strHexTx.size() / 2);
+    if (strHexTx.empty() || strHexTx.size() % 2 != 0 ||
+        HexDecode(strHexTx.data(), strHexTx.size(), txData.data()) != txData.size()) {
         return false;
     }
-
-    std::vector<unsigned char> txData(ParseHex(strHexTx));
     CDataStream ssData(txData, SER_NETWORK, 70208);
     try {
         ssData >> tx;
@@ -59,13 +59,17 @@ base_blob<BITS>::base_blob(const std::vector<unsigned char>& vch)
 template <unsigned int BITS>
 std::string base_blob<BITS>::GetHex() const
 {
-    char psz[sizeof(data) * 2 + 1];
-    for (unsigned int i = 0; i < sizeof(data); ++i) {
-        sprintf(psz + i * 2, "%02x", data[sizeof(data) - i - 1]);
-    }
+    char psz[sizeof(data) * 2];
+    GetHex(psz);
     return std::string(psz, psz + sizeof(data) * 2);
 }
 
+template <unsigned int BITS>
+void base_blob<BITS>::GetHex(char* psz) const
+{
+    HexEncodeReversed(data, sizeof(data), psz);
+}
+
 template <unsigned int BITS>
 void base_blob<BITS>::SetHex(const char* psz)
 {
@@ -84,6 +88,17 @@ void base_blob<BITS>::SetHex(const char* psz)
     while (::HexDigit(*psz) != -1){
         psz++;
     }
+    // An even number of digits decodes in bulk, the last pair is the lowest byte
+    const size_t digits = psz - pbegin;
+    if (digits % 2 == 0) {
+        unsigned char bytes[WIDTH];
+        const size_t skip = digits > 2 * WIDTH ? digits - 2 * WIDTH : 0;
+        const size_t count = HexDecode(pbegin + skip, digits - skip, bytes);
+        for (size_t i = 0; i < count; ++i) {
+            data[i] = bytes[count - 1 - i];
+        }
+        return;
+    }
     psz--;
     unsigned char* p1 = (unsigned char*)data;
     unsigned char* pend = p1 + WIDTH;
@@ -133,6 +148,7 @@ uint64_t uint256::GetHash(const uint256& salt) const
 // Explicit instantiations for base_blob<160>
 template base_blob<160>::base_blob(const std::vector<unsigned char>&);
 template std::string base_blob<160>::GetHex() const;
+template void base_blob<160>::GetHex(char*) const;
 template std::string base_blob<160>::ToString() const;
 template void base_blob<160>::SetHex(const char*);
 template void base_blob<160>::SetHex(const std::string&);
@@ -140,6 +156,7 @@ template void base_blob<160>::SetHex(const std::string&);
 // Explicit instantiations for base_blob<256>
 template base_blob<256>::base_blob(const std::vector<unsigned char>&);
 template std::string base_blob<256>::GetHex() const;
+template void base_blob<256>::GetHex(char*) const;
 template std::string base_blob<256>::ToString() const;
 template void base_blob<256>::SetHex(const char*);
 template void base_blob<256>::SetHex(const std::string&);
@@ -64,6 +64,8 @@ public:
 public:
     /// @brief returns hexadecimal value
     std::string GetHex() const;
+    /// @brief writes the 2 * WIDTH hex digits of GetHex() to psz, not terminated
+    void GetHex(char* psz) const;
     /// @brief set value
     void SetHex(const char* psz);
     /// @brief set value
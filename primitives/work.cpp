@@ -20,14 +20,24 @@ Work::Work(const Json::Value& gbt,
     , m_extraNonce(extraNonce)
 {
     m_jobName = gbt.get((Json::Value::ArrayIndex)0, "").asString();
-    hashTarget = arith_uint256().SetCompact(this->nBits);
+    setTarget(arith_uint256().SetCompact(this->nBits));
+}
+
+Work::Work(const StratumJob& job,
+           const std::string& extraNonce)
+    : Block(job, extraNonce)
+    , m_jobName(job.jobName)
+    , m_extraNonce(extraNonce)
+{
+    setTarget(arith_uint256().SetCompact(this->nBits));
 }
 
 Work::Work(const Json::Value &gbt,
-           const std::string &coinbase_addr)
-    : Block(gbt, coinbase_addr)
+           const std::string &coinbase_addr,
+           TemplateCache* cache)
+    : Block(gbt, coinbase_addr, cache)
 {
-    hashTarget = arith_uint256().SetCompact(this->nBits);
+    setTarget(arith_uint256().SetCompact(this->nBits));
 }
 
 void Work::incrementExtraNonce()
@@ -38,10 +48,10 @@ void Work::incrementExtraNonce()
         hashPrev = this->hashPrevBlock;
     }
     ++m_secondaryExtraNonce;
-    CMutableTransaction txCoinbase(this->vtx[0]);
+    CMutableTransaction txCoinbase(*this->vtx[0]);
     txCoinbase.vin[0].scriptSig = (CScript() << this->nHeight << CScriptNum(m_secondaryExtraNonce)) + COINBASE_FLAGS;
 
-   this->vtx[0] = txCoinbase;
+   this->vtx[0] = MakeTransactionRef(std::move(txCoinbase));
    this->hashMerkleRoot = BlockMerkleRoot(*this);
 }
 
@@ -52,10 +62,20 @@ void Work::updateTimestamp()
 
 std::string Work::getBlockTransaction() const
 {
-    std::stringstream ss;
+    std::string hex;
+    appendBlockTransaction(hex);
+    return hex;
+}
+
+void Work::appendBlockTransaction(std::string& hex) const
+{
+    // Capacity is kept between calls, a submit serializes without allocating
+    thread_local std::vector<unsigned char> buffer;
+    buffer.clear();
+    CVectorWriter writer(SER_NETWORK, 70208, buffer, 0);
     //! TODO check and provid correct nType and nVersion for this operation
-    vtx[0].Serialize(ss, (1 << 0), 70208);
-    return strToHex(ss.str());
+    writer << *vtx[0];
+    HexEncode(buffer.data(), buffer.size(), hex);
 }
 
 } //! namespace energi
@@ -39,8 +39,12 @@ struct Work : public Block
     Work(const Json::Value& gbt,
          const std::string& extraNonce, bool);
 
+    Work(const StratumJob& job,
+         const std::string& extraNonce);
+
     Work(const Json::Value& gbt,
-         const std::string& coinbase_addr); // -> coinbase to transfer miners reward
+         const std::string& coinbase_addr,
+         TemplateCache* cache = nullptr); // -> coinbase to transfer miners reward
 
     Work& operator=(const Work &) = default;
 
@@ -59,6 +63,7 @@ struct Work : public Block
         SetNull();
         m_jobName = std::string();
         m_extraNonce = std::string();
+        sessionId = 0;
     }
 
     bool isValid() const
@@ -77,6 +82,8 @@ struct Work : public Block
     }
 
     std::string getBlockTransaction() const;
+    //! Appends the hex of the coinbase transaction to hex
+    void appendBlockTransaction(std::string& hex) const;
 
     void incrementExtraNonce();
 
@@ -105,14 +112,37 @@ struct Work : public Block
         m_extraNonce = exNonce;
     }
 
+    //! Sets hashTarget together with the upper 64 bits the comparisons start from
+    void setTarget(const arith_uint256& target)
+    {
+        hashTarget = target;
+        upper64OfBoundary = (target >> 192).GetLow64();
+    }
+
+    /**
+     * @brief Whether hash meets hashTarget. Hashes are uniform, so all but
+     *        about one in 2^64 are decided by their upper 64 bits alone, the
+     *        full 256 bit comparison only runs when those are equal.
+     */
+    bool meetsTarget(const uint256& hash) const
+    {
+        const uint64_t upper64 = ReadLE64(hash.begin() + 24);
+        if (upper64 != upper64OfBoundary) {
+            return upper64 < upper64OfBoundary;
+        }
+        return UintToArith256(hash) <= hashTarget;
+    }
+
 
     //!TODO keep only this part
     uint64_t       startNonce = 0;
     int            exSizeBits = -1;
     uint32_t       m_secondaryExtraNonce = 0;
+    uint32_t       sessionId = 0;       // pool connection the job came from, set by the PoolManager
     std::string    m_jobName;
     std::string    m_extraNonce;
-    arith_uint256  hashTarget;
+    arith_uint256  hashTarget;          // assign through setTarget()
+    uint64_t       upper64OfBoundary = 0;
 
     std::string ToString() const
     {
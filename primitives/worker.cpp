@@ -8,47 +8,76 @@
 #include <iostream>
 
 #include "worker.h"
+#include "workerpool.h"
 #include "common/Log.h"
 
-
 using namespace energi;
 
 void Worker::startWorking()
 {
     std::lock_guard<std::mutex> lock(x_work);
-    if (m_work) {
+    if (m_work || m_pooled.valid()) {
         State ex = State::Stopped;
         m_state.compare_exchange_strong(ex, State::Starting);
+        notifyState();
     } else {
         m_state = State::Starting;
-        m_work.reset(new std::thread([&]() {
-                while (m_state != State::Killing) {
-                    State ex = State::Starting;
-                    m_state.compare_exchange_strong(ex, State::Started);
-                    try {
-                        trun();
-                    } catch (std::exception const& _e) {
-                        clog(WarnChannel) << "Exception thrown in Worker thread: " << _e.what();
-                    }
-                    ex = m_state.exchange(State::Stopped);
-                    if (ex == State::Killing || ex == State::Starting) {
-                        m_state.exchange(ex);
-                    }
-                    while (m_state == State::Stopped) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(20));
-                    }
-               }
-        }));
+        if (m_pool) {
+            // the pool pins its thread itself and keeps it pinned between tasks
+            m_pooled = m_pool->run(m_affinity, [&]() { workLoop(); });
+        } else {
+            m_work.reset(new std::thread([&]() {
+                    applyAffinity();
+                    workLoop();
+            }));
+        }
     }
     while (m_state == State::Starting) {
         std::this_thread::sleep_for(std::chrono::microseconds(20));
     }
 }
 
+void Worker::workLoop()
+{
+    while (m_state != State::Killing) {
+        State ex = State::Starting;
+        m_state.compare_exchange_strong(ex, State::Started);
+        try {
+            trun();
+        } catch (std::exception const& _e) {
+            clog(WarnChannel) << "Exception thrown in Worker thread: " << _e.what();
+        }
+        ex = m_state.exchange(State::Stopped);
+        if (ex == State::Killing || ex == State::Starting) {
+            m_state.exchange(ex);
+        }
+        std::unique_lock<std::mutex> lock(x_state);
+        m_stateChanged.wait(lock, [&] { return m_state != State::Stopped; });
+    }
+}
+
+void Worker::notifyState()
+{
+    std::lock_guard<std::mutex> lock(x_state);
+    m_stateChanged.notify_all();
+}
+
+void Worker::applyAffinity()
+{
+    int cpu = m_affinity;
+    if (cpu < 0) {
+        return;
+    }
+    std::string error;
+    if (!WorkerPool::pinCurrentThread(cpu, error)) {
+        cwarn << "Unable to pin " << m_name << " to cpu " << cpu << ": " << error;
+    }
+}
+
 void Worker::stopWorking()
 {
     DEV_GUARDED(x_work)
-    if (m_work) {
+    if (m_work || m_pooled.valid()) {
         State ex = State::Started;
         m_state.compare_exchange_strong(ex, State::Stopping);
 
@@ -63,7 +92,13 @@ Worker::~Worker()
     DEV_GUARDED(x_work)
     if (m_work) {
         m_state.exchange(State::Killing);
+        notifyState();
         m_work->join();
         m_work.reset();
+    } else if (m_pooled.valid()) {
+        // the thread goes back to the pool
+        m_state.exchange(State::Killing);
+        notifyState();
+        m_pooled.wait();
     }
 }
@@ -11,15 +11,19 @@
 #include <atomic>
 #include <string>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <memory>
 #include <cstdlib>
+#include <future>
 
 #include "common/common.h"
 #include "work.h"
 
 namespace energi {
 
+class WorkerPool;
+
 class Worker
 {
 public:
@@ -53,6 +57,23 @@ public:
     {
         return m_name;
     }
+
+    //! Logical cpu the worker thread is pinned to when it starts, -1 leaves it to the scheduler
+    void setAffinity(int cpu)
+    {
+        m_affinity = cpu;
+    }
+
+    int affinity() const
+    {
+        return m_affinity;
+    }
+
+    //! Run on a thread borrowed from the pool instead of an own one. Must be set before startWorking()
+    void setPool(WorkerPool* pool)
+    {
+        m_pool = pool;
+    }
 protected:
     // run in a thread
     // This function is meant to run some logic in a loop.
@@ -60,12 +81,20 @@ protected:
     virtual void trun() = 0;
 
 private:
+    void workLoop();
+    void applyAffinity();
+    void notifyState();
 
     std::string                   m_name;
     mutable std::mutex            x_work;
     std::unique_ptr<std::thread>  m_work;
+    WorkerPool*                   m_pool = nullptr;
+    std::future<void>             m_pooled;
 
     std::atomic<State>            m_state { State::Starting };
+    std::mutex                    x_state;
+    std::condition_variable       m_stateChanged;  // wakes a stopped thread on restart or kill
+    std::atomic<int>              m_affinity { -1 };
 };
 
 } //! namespace energi
@@ -0,0 +1,192 @@
+/*
+ * WorkerPool.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#include "workerpool.h"
+#include "common/Log.h"
+
+#include <cstring>
+#include <exception>
+
+#if defined(__linux)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace energi;
+
+WorkerPool::WorkerPool()
+{
+#if defined(__linux)
+    // Kept as it is, so unpinned threads stay within a taskset or cgroup restriction
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpuset)) {
+                m_inheritedCpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(x_slots);
+        m_exit = true;
+        for (auto& slot : m_slots) {
+            slot->cv.notify_one();
+        }
+    }
+    for (auto& slot : m_slots) {
+        if (slot->thread.joinable()) {
+            slot->thread.join();
+        }
+    }
+}
+
+std::future<void> WorkerPool::run(int cpu, Task task)
+{
+    std::lock_guard<std::mutex> lock(x_slots);
+    Slot* chosen = nullptr;
+    for (auto& slot : m_slots) {
+        if (slot->busy) {
+            continue;
+        }
+        if (slot->cpu == cpu) {
+            chosen = slot.get();
+            break;
+        }
+        if (!chosen) {
+            chosen = slot.get();
+        }
+    }
+    if (!chosen) {
+        m_slots.emplace_back(new Slot);
+        chosen = m_slots.back().get();
+        chosen->thread = std::thread(&WorkerPool::loop, this, std::ref(*chosen));
+    }
+    chosen->task = std::move(task);
+    chosen->done = std::promise<void>();
+    chosen->wanted = cpu;
+    chosen->busy = true;
+    auto result = chosen->done.get_future();
+    chosen->cv.notify_one();
+    return result;
+}
+
+void WorkerPool::loop(Slot& slot)
+{
+    std::unique_lock<std::mutex> lock(x_slots);
+    while (true) {
+        slot.cv.wait(lock, [&] { return m_exit || slot.busy; });
+        if (!slot.busy) {
+            return;
+        }
+        Task task = std::move(slot.task);
+        std::promise<void> done = std::move(slot.done);
+        int wanted = slot.wanted;
+        lock.unlock();
+
+        if (wanted != slot.cpu) {
+            std::string error;
+            if (wanted >= 0 && !pinCurrentThread(wanted, error)) {
+                cwarn << "Unable to pin pooled thread to cpu " << wanted << ": " << error;
+                wanted = slot.cpu;
+            } else if (wanted < 0 && !unpinCurrentThread(error)) {
+                cwarn << "Unable to unpin pooled thread from cpu " << slot.cpu << ": " << error;
+                wanted = slot.cpu;
+            }
+        }
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // mark the slot idle before the owner learns the task is over,
+        // so an immediate restart lands on this very thread
+        lock.lock();
+        slot.cpu = wanted;
+        slot.busy = false;
+        if (error) {
+            done.set_exception(error);
+        } else {
+            done.set_value();
+        }
+    }
+}
+
+size_t WorkerPool::threads() const
+{
+    std::lock_guard<std::mutex> lock(x_slots);
+    return m_slots.size();
+}
+
+size_t WorkerPool::idle() const
+{
+    std::lock_guard<std::mutex> lock(x_slots);
+    size_t count = 0;
+    for (auto& slot : m_slots) {
+        if (!slot->busy) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+bool WorkerPool::pinCurrentThread(int cpu, std::string& error)
+{
+    if (cpu < 0) {
+        error = "no cpu given";
+        return false;
+    }
+#if defined(__linux)
+    if (cpu >= CPU_SETSIZE) {
+        error = "cpu out of range";
+        return false;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (rc != 0) {
+        error = strerror(rc);
+        return false;
+    }
+    return true;
+#else
+    error = "thread affinity is not supported on this platform";
+    return false;
+#endif
+}
+
+bool WorkerPool::unpinCurrentThread(std::string& error) const
+{
+#if defined(__linux)
+    if (m_inheritedCpus.empty()) {
+        error = "the initial affinity is unknown";
+        return false;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : m_inheritedCpus) {
+        CPU_SET(cpu, &cpuset);
+    }
+    int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    if (rc != 0) {
+        error = strerror(rc);
+        return false;
+    }
+    return true;
+#else
+    (void)error;
+    return true;
+#endif
+}
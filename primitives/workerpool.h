@@ -0,0 +1,76 @@
+/*
+ * WorkerPool.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: ranjeet
+ */
+
+#ifndef ENERGIMINER_WORKERPOOL_H_
+#define ENERGIMINER_WORKERPOOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace energi {
+
+/**
+ * @brief Long lived threads a Worker can run its loop on.
+ *        Threads are never torn down before the pool itself, so a Worker
+ *        recreated on restart or DAG reload lands on a warm thread which
+ *        keeps its affinity and thread local state.
+ */
+class WorkerPool
+{
+public:
+    using Task = std::function<void()>;
+
+    WorkerPool();
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+    ~WorkerPool();
+
+    /**
+     * @brief Hands the task to an idle thread, preferring one already pinned to cpu.
+     *        A new thread is spawned when all are busy.
+     * @param cpu logical cpu the thread should run on, -1 for no pinning
+     * @return future becoming ready once the task returned
+     */
+    std::future<void> run(int cpu, Task task);
+
+    size_t threads() const;
+    size_t idle() const;
+
+    //! Pins the calling thread to cpu
+    static bool pinCurrentThread(int cpu, std::string& error);
+    //! Gives the calling thread back the affinity the pool was built with
+    bool unpinCurrentThread(std::string& error) const;
+
+private:
+    struct Slot
+    {
+        std::thread                 thread;
+        std::condition_variable     cv;
+        Task                        task;
+        std::promise<void>          done;
+        int                         cpu = -1;   // cpu the thread is currently pinned to
+        int                         wanted = -1;
+        bool                        busy = false;
+    };
+
+    void loop(Slot& slot);
+
+    std::vector<int>                   m_inheritedCpus;    // affinity of the thread that built the pool
+    mutable std::mutex                 x_slots;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    bool                               m_exit = false;
+};
+
+} //! namespace energi
+
+#endif /* ENERGIMINER_WORKERPOOL_H_ */
@@ -3,6 +3,8 @@
 #include <boost/asio/ip/address.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <queue>
+#include <deque>
+#include <mutex>
 #include <chrono>
 
 #include <nrgcore/mineplant.h>
@@ -29,8 +31,11 @@ public:
     virtual bool isPendingState() = 0;
     virtual std::string ActiveEndPoint() = 0;
 
-    using SolutionAccepted = std::function<void(bool const&, const std::chrono::milliseconds&)>;
-    using SolutionRejected = std::function<void(bool const&, const std::chrono::milliseconds&)>;
+    // stale, pool response delay, time elapsed since the miner found the solution
+    using SolutionAccepted = std::function<void(bool const&, const std::chrono::milliseconds&, const std::chrono::milliseconds&)>;
+    using SolutionRejected = std::function<void(bool const&, const std::chrono::milliseconds&, const std::chrono::milliseconds&)>;
+    // time elapsed between the miner finding the solution and its write to the pool completing
+    using SolutionSent = std::function<void(const std::chrono::microseconds&)>;
     using Disconnected = std::function<void()>;
     using Connected = std::function<void()>;
     using ResetWork = std::function<void()>;
@@ -46,6 +51,11 @@ public:
         m_onSolutionRejected = handler;
     }
 
+    void onSolutionSent(const SolutionSent& handler)
+    {
+        m_onSolutionSent = handler;
+    }
+
     void onDisconnected(const Disconnected& handler)
     {
         m_onDisconnected = handler;
@@ -67,6 +77,30 @@ public:
     }
 
 protected:
+    // Pools answer submissions in order, so find times are kept FIFO
+    void trackSolution(const energi::Solution& solution)
+    {
+        std::lock_guard<std::mutex> lock(x_found);
+        m_foundTimes.push_back(solution.getFoundTime());
+    }
+
+    std::chrono::milliseconds untrackSolution()
+    {
+        std::lock_guard<std::mutex> lock(x_found);
+        if (m_foundTimes.empty()) {
+            return std::chrono::milliseconds(0);
+        }
+        auto found = m_foundTimes.front();
+        m_foundTimes.pop_front();
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - found);
+    }
+
+    void clearTrackedSolutions()
+    {
+        std::lock_guard<std::mutex> lock(x_found);
+        m_foundTimes.clear();
+    }
+
     std::atomic<bool> m_subscribed = { false };
     std::atomic<bool> m_authorized = { false };
     std::atomic<bool> m_connected = { false };
@@ -78,8 +112,13 @@ protected:
 
     SolutionAccepted m_onSolutionAccepted;
     SolutionRejected m_onSolutionRejected;
+    SolutionSent m_onSolutionSent;
     Disconnected m_onDisconnected;
     Connected m_onConnected;
     ResetWork m_onResetWork;
     WorkReceived m_onWorkReceived;
+
+private:
+    std::mutex x_found;
+    std::deque<std::chrono::steady_clock::time_point> m_foundTimes;
 };
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Running health of one pool connection. Response times and the share
+ *        of rejected solutions are kept as moving averages, so a pool that
+ *        turns slow or starts rejecting loses its standing within a few
+ *        samples. Lower scores are better.
+ */
+class PoolHealth
+{
+public:
+    //! Time a pool took to answer, the handshake of a fresh connection counts as one answer
+    void recordLatency(const std::chrono::milliseconds& elapsed)
+    {
+        const double ms = static_cast<double>(elapsed.count() > 0 ? elapsed.count() : 0);
+        m_latencyMs = m_latencySamples ? m_latencyMs + c_weight * (ms - m_latencyMs) : ms;
+        ++m_latencySamples;
+    }
+
+    void recordAccepted() { recordShare(0.0); }
+    void recordRejected() { recordShare(1.0); }
+
+    bool measured() const { return m_latencySamples > 0; }
+    double latencyMs() const { return m_latencyMs; }
+    double rejectRate() const { return m_rejectRate; }
+    uint64_t accepted() const { return m_accepted; }
+    uint64_t rejected() const { return m_rejected; }
+
+    //! Expected milliseconds per useful answer, every rejected share weighs as much as c_rejectWeight answers
+    double score() const
+    {
+        return (m_latencyMs + c_floorMs) * (1.0 + c_rejectWeight * m_rejectRate);
+    }
+
+private:
+    void recordShare(double rejected)
+    {
+        m_rejectRate += c_weight * (rejected - m_rejectRate);
+        (rejected > 0 ? m_rejected : m_accepted)++;
+    }
+
+    /// Weight of the newest sample in the moving averages
+    static constexpr double c_weight = 0.2;
+    /// Keeps pools on a local network from looking infinitely better than each other
+    static constexpr double c_floorMs = 10.0;
+    static constexpr double c_rejectWeight = 10.0;
+
+    double   m_latencyMs = 0;
+    uint64_t m_latencySamples = 0;
+    double   m_rejectRate = 0;
+    uint64_t m_accepted = 0;
+    uint64_t m_rejected = 0;
+};
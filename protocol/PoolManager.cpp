@@ -1,103 +1,223 @@
+#include <algorithm>
 #include <chrono>
+#include <iomanip>
 #include <boost/bind.hpp>
 
 #include "PoolManager.h"
 
 using namespace energi;
 
+const unsigned PoolManager::c_minDwellSeconds;
+const unsigned PoolManager::c_drainSeconds;
+const unsigned PoolManager::c_maxBackoffSeconds;
+
 PoolManager::PoolManager(boost::asio::io_service& io_service,
-                         PoolClient* client,
+                         const ClientFactory& factory,
                          energi::MinePlant &farm,
                          const MinerExecutionMode& minerType,
                          unsigned maxTries,
-                         unsigned failoverTimeout)
+                         unsigned failoverTimeout,
+                         unsigned standby)
     : Worker("main")
     , m_io_strand(io_service)
     , m_failovertimer(io_service)
+    , m_factory(factory)
     , m_farm(farm)
     , m_minerType(minerType)
 {
-	p_client = client;
     m_maxConnectionAttempts = maxTries;
     m_failoverTimeout = failoverTimeout;
+    m_standby = standby;
 
-	p_client->onConnected([&]()
+	m_farm.onSolutionFound([&](const Solution& sol)
 	{
-        m_connectionAttempt = 0;
-        m_activeConnectionHost = m_connections[m_activeConnectionIdx].Host();
-        cnote << "Connected to " << m_connections[m_activeConnectionIdx].Host() << p_client->ActiveEndPoint();
-        // Rough implementation to return to primary pool
-        // after specified amount of time
-        if (m_activeConnectionIdx != 0 && m_failoverTimeout > 0) {
-            m_failovertimer.expires_from_now(boost::posix_time::minutes(m_failoverTimeout));
-            m_failovertimer.async_wait(m_io_strand.wrap(boost::bind(&PoolManager::check_failover_timeout, this, boost::asio::placeholders::error)));
+        PoolClient* client = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            // Only the connection that handed out the job can take the solution,
+            // any other pool would reject it and be scored down for it
+            for (auto& session : m_sessions) {
+                if (session->id == sol.getWork().sessionId) {
+                    // Solution should passthrough only if client is
+                    // properly connected. Otherwise we'll have the bad behavior
+                    // to log nonce submission but receive no response
+                    if (session->ready && session->client->isConnected()) {
+                        client = session->client.get();
+                    }
+                    break;
+                }
+            }
+        }
+        if (client) {
+            client->submitSolution(sol);
         } else {
-            m_failovertimer.cancel();
+            cnote << std::string(EthRed "Nonce ") + std::to_string(sol.getNonce()) << " wasted, its pool connection is gone";
+            m_farm.wastedSolution();
         }
+    return false;
+	});
+	m_farm.onMinerRestart([&]() {
+        setThreadName("main");
+		cnote << "Restart miners...";
+		if (m_farm.isMining()) {
+			cnote << "Shutting down miners...";
+			m_farm.stop();
+		}
+        auto vEngineModes = getEngineModes(m_minerType);
+        m_farm.start(vEngineModes);
+	});
+}
 
-        if (!m_farm.isMining()) {
-            cnote << "Spinning up miners...";
-            auto vEngineModes = getEngineModes(m_minerType);
-            m_farm.start(vEngineModes);
+bool PoolManager::ensureClient(Session& session)
+{
+    if (session.client) {
+        return true;
+    }
+    PoolClient* client = m_factory ? m_factory() : nullptr;
+    if (!client) {
+        session.unusable = true;
+        return false;
     }
+    session.client.reset(client);
+
+    Session* s = &session;
+	client->onConnected([this, s]()
+	{
+        bool primary;
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            s->ready = true;
+            s->lost = false;
+            s->attempts = 0;
+            s->health.recordLatency(std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::steady_clock::now() - s->connecting));
+            primary = isPrimary(s);
+        }
+        if (primary) {
+            cnote << "Connected to " << s->uri.Host() << s->client->ActiveEndPoint();
+            spinUp();
+        } else {
+            cnote << "Standby connected to " << s->uri.Host() << s->client->ActiveEndPoint();
+        }
 	});
-	p_client->onResetWork([&]()
+	client->onResetWork([this, s]()
 	{
-        m_farm.resetWork();
+        std::lock_guard<std::mutex> lock(x_sessions);
+        if (isPrimary(s)) {
+            m_farm.resetWork();
+        }
 	});
-	p_client->onDisconnected([&]()
+	client->onDisconnected([this, s]()
 	{
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            s->lost = s->ready;
+            s->ready = false;
+            s->hasWork = false;
+        }
         setThreadName("main");
-        cnote << "Disconnected from " + m_activeConnectionHost << p_client->ActiveEndPoint();
+        cnote << "Disconnected from " + s->uri.Host() << s->client->ActiveEndPoint();
         // Do not stop mining here
-        // Workloop will determine if we're trying a fast reconnect to same pool
-        // or if we're switching to failover(s)
+        // Workloop will determine if we're promoting a standby, trying
+        // a fast reconnect to same pool or switching to failover(s)
 	});
-    p_client->onWorkReceived([&](const Work& wp)
+    client->onWorkReceived([this, s](const Work& wp)
     {
-        m_farm.setWork(wp);
+        // Standbys keep their latest job so a promotion has work to hand out at once
+        std::lock_guard<std::mutex> lock(x_sessions);
+        s->work = wp;
+        s->work.sessionId = s->id;
+        s->hasWork = true;
+        if (isPrimary(s)) {
+            m_farm.setWork(s->work);
+        }
     });
-	p_client->onSolutionAccepted([&](const bool& stale, const std::chrono::milliseconds& elapsedMs)
+	client->onSolutionAccepted([this, s](const bool& stale, const std::chrono::milliseconds& elapsedMs, const std::chrono::milliseconds& findToAckMs)
 	{
-		using namespace std::chrono;
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            s->health.recordLatency(elapsedMs);
+            s->health.recordAccepted();
+        }
 		std::stringstream ss;
 		ss << std::setw(4) << std::setfill(' ') << elapsedMs.count();
-		ss << " ms." << "   " << m_connections[m_activeConnectionIdx].Host() + p_client->ActiveEndPoint();
+		ss << " ms. found " << findToAckMs.count() << " ms ago   " << s->uri.Host() + s->client->ActiveEndPoint();
 		cnote << EthLime "**Accepted  " EthReset << (stale ? "(stale)" : "") << ss.str();
-		m_farm.acceptedSolution(stale);
+		m_farm.acceptedSolution(stale, findToAckMs);
 	});
-	p_client->onSolutionRejected([&](const bool& stale, std::chrono::milliseconds const& elapsedMs)
+	client->onSolutionRejected([this, s](const bool& stale, std::chrono::milliseconds const& elapsedMs, std::chrono::milliseconds const& findToAckMs)
 	{
-		using namespace std::chrono;
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            s->health.recordLatency(elapsedMs);
+            s->health.recordRejected();
+        }
 		std::stringstream ss;
 		ss << std::setw(4) << std::setfill(' ') << elapsedMs.count();
-		ss << " ms." << "   " << m_connections[m_activeConnectionIdx].Host() + p_client->ActiveEndPoint();
+		ss << " ms. found " << findToAckMs.count() << " ms ago   " << s->uri.Host() + s->client->ActiveEndPoint();
 		cwarn << EthRed "**Rejected  " EthReset << (stale ? "(stale)" : "") << ss.str();
-		m_farm.rejectedSolution();
+		m_farm.rejectedSolution(findToAckMs);
 	});
-
-	m_farm.onSolutionFound([&](const Solution& sol)
+	client->onSolutionSent([this](const std::chrono::microseconds& findToWire)
 	{
-        // Solution should passthrough only if client is
-        // properly connected. Otherwise we'll have the bad behavior
-        // to log nonce submission but receive no response
-        if (p_client->isConnected()) {
-            p_client->submitSolution(sol);
-        } else {
-            cnote << std::string(EthRed "Nonce ") + std::to_string(sol.getNonce()) << " wasted. Waiting for connection ...";
-        }
-    return false;
+		m_farm.sentSolution(findToWire);
 	});
-	m_farm.onMinerRestart([&]() {
-        setThreadName("main");
-		cnote << "Restart miners...";
-		if (m_farm.isMining()) {
-			cnote << "Shutting down miners...";
-			m_farm.stop();
-		}
+    return true;
+}
+
+bool PoolManager::usable(Session& session) const
+{
+    return !session.unusable && !session.uri.IsUnrecoverable();
+}
+
+bool PoolManager::isPrimary(const Session* session) const
+{
+    return !m_sessions.empty() && m_sessions[m_activeConnectionIdx].get() == session;
+}
+
+void PoolManager::promote(unsigned idx)
+{
+    Session& next = *m_sessions[idx];
+    if (idx != m_activeConnectionIdx) {
+        m_previous = m_sessions[m_activeConnectionIdx].get();
+        m_switched = std::chrono::steady_clock::now();
+        m_activeConnectionIdx = idx;
+    }
+    cnote << "Switched to standby " << next.uri.Host() << next.client->ActiveEndPoint();
+    m_farm.set_pool_addresses(next.uri.Host(), next.uri.Port());
+    // Otherwise the plant stays on the last job until the new primary sends one
+    if (next.hasWork) {
+        m_farm.setWork(next.work);
+    }
+
+    // Rough implementation to return to primary pool
+    // after specified amount of time
+    if (idx != 0 && m_failoverTimeout > 0) {
+        m_failovertimer.expires_from_now(boost::posix_time::minutes(m_failoverTimeout));
+        m_failovertimer.async_wait(m_io_strand.wrap(boost::bind(&PoolManager::check_failover_timeout, this, boost::asio::placeholders::error)));
+    } else {
+        m_failovertimer.cancel();
+    }
+}
+
+void PoolManager::spinUp()
+{
+    std::lock_guard<std::mutex> lock(x_spinUp);
+    if (m_running.load(std::memory_order_relaxed) && !m_farm.isMining()) {
+        cnote << "Spinning up miners...";
         auto vEngineModes = getEngineModes(m_minerType);
         m_farm.start(vEngineModes);
-	});
+    }
+}
+
+bool PoolManager::isConnected()
+{
+    std::lock_guard<std::mutex> lock(x_sessions);
+    if (m_sessions.empty()) {
+        return false;
+    }
+    Session& primary = *m_sessions[m_activeConnectionIdx];
+    return primary.ready && primary.client->isConnected();
 }
 
 void PoolManager::stop()
@@ -107,8 +227,17 @@ void PoolManager::stop()
         m_running.store(false, std::memory_order_relaxed);
         m_failovertimer.cancel();
 
-        if (p_client->isConnected()) {
-            p_client->disconnect();
+        std::vector<PoolClient*> connected;
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            for (auto& session : m_sessions) {
+                if (session->client && session->client->isConnected()) {
+                    connected.push_back(session->client.get());
+                }
+            }
+        }
+        for (auto client : connected) {
+            client->disconnect();
         }
         if (m_farm.isMining()) {
             cnote << "Shutting down miners...";
@@ -121,55 +250,165 @@ void PoolManager::trun()
 {
     setThreadName("main");
     while (m_running.load(std::memory_order_relaxed)) {
-        // Take action only if not pending state (connecting/disconnecting)
-        // Otherwise do nothing and wait until connection state is NOT pending
-        if (!p_client->isPendingState()) {
-            if (!p_client->isConnected()) {
-                // If this connection is marked Unrecoverable then discard it
-                if (m_connections[m_activeConnectionIdx].IsUnrecoverable()) {
-                    m_connections.erase(m_connections.begin() + m_activeConnectionIdx);
-                    if (m_activeConnectionIdx >= m_connections.size()) {
-                        m_activeConnectionIdx = 0;
-                    }
-                    m_connectionAttempt = 0;
+        const auto now = std::chrono::steady_clock::now();
+        std::vector<Session*> connects;
+        std::vector<Session*> disconnects;
+        Session* primary = nullptr;
+        bool exhausted = false;
+        {
+            std::lock_guard<std::mutex> lock(x_sessions);
+            primary = m_sessions[m_activeConnectionIdx].get();
+
+            // Best ready standby, the one with the lowest health score
+            int best = -1;
+            for (unsigned i = 0; i < m_sessions.size(); ++i) {
+                Session& s = *m_sessions[i];
+                if (i != m_activeConnectionIdx && s.ready && s.hasWork &&
+                        (best < 0 || s.health.score() < m_sessions[best]->health.score())) {
+                    best = static_cast<int>(i);
                 }
-                // Rotate connections if above max attempts threshold
-                if (m_connectionAttempt >= m_maxConnectionAttempts) {
-                    m_connectionAttempt = 0;
-                    m_activeConnectionIdx++;
-                    if (m_activeConnectionIdx == m_connections.size()) {
-                        m_activeConnectionIdx = 0;
-                    }
+            }
+
+            if (m_previous && now - m_switched > std::chrono::seconds(c_drainSeconds)) {
+                m_previous = nullptr;
+            }
 
-                    // Suspend mining if applicable as we're switching
+            if (!primary->ready) {
+                const bool gone = !usable(*primary) || primary->attempts >= m_maxConnectionAttempts;
+                const bool busy = primary->client &&
+                    (primary->client->isPendingState() || primary->client->isConnected());
+                if ((gone || primary->lost) && best >= 0) {
+                    // A ready standby takes over without a handshake
+                    promote(static_cast<unsigned>(best));
+                } else if (gone && !busy) {
+                    // Rotate connections if above max attempts threshold
+                    unsigned next = m_activeConnectionIdx;
+                    do {
+                        next = (next + 1) % m_sessions.size();
+                    } while (next != m_activeConnectionIdx && !usable(*m_sessions[next]));
+                    if (!usable(*m_sessions[next])) {
+                        exhausted = true;
+                    } else {
+                        m_previous = primary;
+                        m_switched = now;
+                        m_activeConnectionIdx = next;
+                        // Solutions to the lost pool's job would be wasted, mine nothing until the next pool sends one
+                        if (m_farm.isMining()) {
+                            cnote << "Suspend mining due connection change...";
+                            m_farm.setWork({});
+                        }
+                        m_sessions[next]->attempts = 0;
+                        if (next != 0 && m_failoverTimeout > 0) {
+                            m_failovertimer.expires_from_now(boost::posix_time::minutes(m_failoverTimeout));
+                            m_failovertimer.async_wait(m_io_strand.wrap(boost::bind(&PoolManager::check_failover_timeout, this, boost::asio::placeholders::error)));
+                        }
+                    }
+                }
+            } else if (m_failback.load(std::memory_order_relaxed)) {
+                Session& first = *m_sessions[0];
+                if (m_activeConnectionIdx == 0) {
+                    m_failback.store(false, std::memory_order_relaxed);
+                } else if (first.ready && first.hasWork) {
+                    promote(0);
+                    m_failback.store(false, std::memory_order_relaxed);
+                } else if (!m_standby) {
+                    // No standby to switch to, reconnect to the first pool
+                    disconnects.push_back(primary);
+                    m_activeConnectionIdx = 0;
+                    first.attempts = 0;
                     if (m_farm.isMining()) {
                         cnote << "Suspend mining due connection change...";
-                        m_farm.setWork({});//
+                        m_farm.setWork({});
                     }
+                    m_failback.store(false, std::memory_order_relaxed);
                 }
-                if (m_connections[m_activeConnectionIdx].Host() != "exit"  && m_connections.size() > 0) {
-                    // Count connectionAttempts
-                    m_connectionAttempt++;
+            } else if (best >= 0 && now - m_switched >= std::chrono::seconds(c_minDwellSeconds)) {
+                // Health decides only on a clear margin, so close pools do not flap
+                Session& challenger = *m_sessions[best];
+                if (primary->health.measured() &&
+                        challenger.health.score() * c_switchRatio < primary->health.score()) {
+                    cnote << "Pool " << primary->uri.Host() << ':' << primary->uri.Port() << " answers in " << std::fixed << std::setprecision(0)
+                          << primary->health.latencyMs() << " ms with " << std::setprecision(1)
+                          << 100.0 * primary->health.rejectRate() << "% rejected, " << challenger.uri.Host() << ':'
+                          << challenger.uri.Port() << " in "
+                          << std::setprecision(0) << challenger.health.latencyMs() << " ms with " << std::setprecision(1)
+                          << 100.0 * challenger.health.rejectRate() << "%";
+                    promote(static_cast<unsigned>(best));
+                }
+            }
 
-                    // Invoke connections
-                    p_client->setConnection(m_connections[m_activeConnectionIdx]);
-                    m_farm.set_pool_addresses(m_connections[m_activeConnectionIdx].Host(), m_connections[m_activeConnectionIdx].Port());
-                    cnote << "Selected pool" << (m_connections[m_activeConnectionIdx].Host() + ":" + toString(m_connections[m_activeConnectionIdx].Port()));
-                    p_client->connect();
+            primary = m_sessions[m_activeConnectionIdx].get();
+            if (!exhausted && primary->uri.Host() == "exit" && !primary->ready) {
+                exhausted = true;
+            }
 
-                } else {
-                    cnote << "No more connections to try. Exiting ...";
-                    // Stop mining if applicable
-                    if (m_farm.isMining()) {
-                        cnote << "Shutting down miners...";
-                        m_farm.stop();
-                    }
+            // Take action only if not pending state (connecting/disconnecting)
+            // Otherwise do nothing and wait until connection state is NOT pending
+            auto idle = [](Session& s) {
+                return !s.client->isPendingState() && !s.client->isConnected();
+            };
+            if (!exhausted) {
+                if (!primary->ready && ensureClient(*primary) && idle(*primary)) {
+                    // Count connectionAttempts
+                    primary->attempts++;
+                    primary->connecting = now;
+                    primary->id = ++m_lastSessionId;
+                    connects.push_back(primary);
+                }
 
-                    m_running.store(false, std::memory_order_relaxed);
-                    continue;
+                // The first usable pools in configured order stand by, the rest are let go
+                unsigned standbys = 0;
+                for (unsigned i = 0; i < m_sessions.size(); ++i) {
+                    Session& s = *m_sessions[i];
+                    if (i == m_activeConnectionIdx) {
+                        continue;
+                    }
+                    if (standbys < m_standby && usable(s) && s.uri.Host() != "exit") {
+                        ++standbys;
+                        if (!s.ready && now >= s.retryAt && ensureClient(s) && idle(s)) {
+                            s.attempts++;
+                            s.connecting = now;
+                            s.id = ++m_lastSessionId;
+                            s.retryAt = now + std::chrono::seconds(std::min(c_maxBackoffSeconds, 1u << std::min(s.attempts, 6u)));
+                            connects.push_back(&s);
+                        }
+                    } else if (&s != m_previous && s.client && s.client->isConnected() &&
+                               std::find(disconnects.begin(), disconnects.end(), &s) == disconnects.end()) {
+                        disconnects.push_back(&s);
+                    }
                 }
             }
+        }
+
+        if (exhausted) {
+            cnote << "No more connections to try. Exiting ...";
+            // Stop mining if applicable
+            if (m_farm.isMining()) {
+                cnote << "Shutting down miners...";
+                m_farm.stop();
+            }
 
+            m_running.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        for (auto session : disconnects) {
+            session->client->disconnect();
+        }
+        for (auto session : connects) {
+            // Invoke connections
+            session->client->setConnection(session->uri);
+            if (session == primary) {
+                m_farm.set_pool_addresses(session->uri.Host(), session->uri.Port());
+                cnote << "Selected pool" << (session->uri.Host() + ":" + toString(session->uri.Port()));
+            } else {
+                cnote << "Standby pool" << (session->uri.Host() + ":" + toString(session->uri.Port()));
+            }
+            session->client->connect();
+        }
+        // A standby promoted before the miners ever started
+        if (isConnected()) {
+            spinUp();
         }
 
         // Hashrate reporting
@@ -186,29 +425,72 @@ void PoolManager::trun()
             //ss << std::setw(64) << std::setfill('0') << res;
             //cnote << res.str();
             //!TODO p_client->submitHashrate();
+            if (m_standby) {
+                reportHealth();
+            }
             m_hashrateReportingTimePassed = 0;
         }
         std::this_thread::sleep_for(std::chrono::seconds(1));
     }
 }
 
+void PoolManager::reportHealth()
+{
+    std::stringstream ss;
+    {
+        std::lock_guard<std::mutex> lock(x_sessions);
+        if (m_sessions.size() < 2) {
+            return;
+        }
+        for (unsigned i = 0; i < m_sessions.size(); ++i) {
+            const Session& s = *m_sessions[i];
+            if (!s.client) {
+                continue;
+            }
+            ss << (ss.tellp() > 0 ? ", " : "") << s.uri.Host() << ':' << s.uri.Port() << ' '
+               << (i == m_activeConnectionIdx ? "primary" : (s.ready ? "standby" : "down"));
+            if (s.health.measured()) {
+                ss << ' ' << std::fixed << std::setprecision(0) << s.health.latencyMs() << " ms";
+            }
+            if (s.health.accepted() + s.health.rejected()) {
+                ss << ' ' << std::fixed << std::setprecision(1) << 100.0 * s.health.rejectRate() << "% rejected";
+            }
+        }
+    }
+    cnote << "Pools: " << ss.str();
+}
+
 void PoolManager::addConnection(URI &conn)
 {
-	m_connections.push_back(conn);
+    std::lock_guard<std::mutex> lock(x_sessions);
+    m_sessions.emplace_back(new Session(conn));
 }
 
 void PoolManager::clearConnections()
 {
-    m_connections.clear();
-    m_farm.set_pool_addresses("", 0);
-    if (p_client && p_client->isConnected()) {
-        p_client->disconnect();
+    std::vector<PoolClient*> connected;
+    {
+        std::lock_guard<std::mutex> lock(x_sessions);
+        for (auto& session : m_sessions) {
+            if (session->client && session->client->isConnected()) {
+                connected.push_back(session->client.get());
+            }
+        }
     }
+    for (auto client : connected) {
+        client->disconnect();
+    }
+    std::lock_guard<std::mutex> lock(x_sessions);
+    m_sessions.clear();
+    m_activeConnectionIdx = 0;
+    m_previous = nullptr;
+    m_farm.set_pool_addresses("", 0);
 }
 
 bool PoolManager::start()
 {
-    if (m_connections.size() > 0) {
+    if (m_sessions.size() > 0) {
+        m_switched = std::chrono::steady_clock::now();
         m_running.store (true, std::memory_order_relaxed);
         m_workThread = std::thread{ boost::bind(&PoolManager::trun, this) };
         // Try to connect to pool
@@ -222,15 +504,10 @@ bool PoolManager::start()
 
 void PoolManager::check_failover_timeout(const boost::system::error_code& ec)
 {
-
     if (!ec) {
         if (m_running.load(std::memory_order_relaxed)) {
-            if (m_activeConnectionIdx != 0) {
-                p_client->disconnect();
-                m_activeConnectionIdx = 0;
-                m_connectionAttempt = 0;
-            }
+            // The work loop switches once the first pool is ready
+            m_failback.store(true, std::memory_order_relaxed);
         }
     }
 }
-
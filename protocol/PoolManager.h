@@ -1,49 +1,104 @@
 #pragma once
 
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <primitives/worker.h>
 #include <nrgcore/mineplant.h>
 #include <nrgcore/miner.h>
 
 #include "PoolClient.h"
+#include "PoolHealth.h"
 
+/**
+ * @brief Keeps the plant fed from the configured pools. Besides the primary,
+ *        up to standby failover pools stay connected and authorized, their
+ *        jobs are kept but not mined. When the primary drops, or a standby
+ *        answers much faster and rejects less for a while, a standby is
+ *        promoted and its latest job goes to the plant at once, without a
+ *        handshake in between.
+ */
 class PoolManager : public energi::Worker
 {
 public:
+    //! Makes the client of one pool, every configured pool gets its own
+    using ClientFactory = std::function<PoolClient*()>;
+
     PoolManager(boost::asio::io_service & io_service,
-                PoolClient* client,
+                const ClientFactory& factory,
                 energi::MinePlant& farm,
                 const MinerExecutionMode& minerType,
                 unsigned maxTries,
-                unsigned failovertimeout);
+                unsigned failovertimeout,
+                unsigned standby);
     void addConnection(URI &conn);
     void clearConnections();
     bool start();
     void stop();
 
-    bool isConnected() { return p_client->isConnected(); };
+    bool isConnected();
     bool isRunning() { return m_running; };
 
 private:
+    struct Session
+    {
+        explicit Session(const URI& conn) : uri(conn) {}
+
+        URI uri;
+        std::unique_ptr<PoolClient> client;
+        bool unusable = false;      // the factory had no client for it
+        bool ready = false;         // authorized, between onConnected and onDisconnected
+        bool lost = false;          // was ready and dropped, not a failed connect
+        unsigned attempts = 0;      // connects since the last success
+        uint32_t id = 0;            // of the latest connect, its jobs carry it to their solutions
+        std::chrono::steady_clock::time_point connecting;
+        std::chrono::steady_clock::time_point retryAt;  // standbys back off after failures
+        PoolHealth health;
+        bool hasWork = false;
+        energi::Work work;          // latest job, handed to the plant on promotion
+    };
+
+    /// A standby must score this many times better before it replaces a working primary
+    static constexpr double c_switchRatio = 2.0;
+    /// Least time on a pool before health alone moves the miner off it
+    static const unsigned c_minDwellSeconds = 120;
+    /// The previous primary stays connected this long, for the solutions to its jobs
+    static const unsigned c_drainSeconds = 10;
+    static const unsigned c_maxBackoffSeconds = 60;
+
     unsigned m_hashrateReportingTime = 60;
     unsigned m_hashrateReportingTimePassed = 0;
     // After this amount of time in minutes of mining on a failover pool return to "primary"
     unsigned m_failoverTimeout = 0;
+    std::atomic<bool> m_failback = { false };
     void check_failover_timeout(const boost::system::error_code& ec);
 
     std::atomic<bool> m_running = { false };
     void trun() override;
-    unsigned m_connectionAttempt = 0;
+    bool usable(Session& session) const;
+    bool isPrimary(const Session* session) const;
+    bool ensureClient(Session& session);
+    void promote(unsigned idx);
+    void spinUp();
+    void reportHealth();
     unsigned m_maxConnectionAttempts = 0;
+    unsigned m_standby = 0;
+
+    // Sessions are only added before start, so their addresses are stable for the callbacks
+    std::mutex x_sessions;
+    std::vector<std::unique_ptr<Session>> m_sessions;
     unsigned m_activeConnectionIdx = 0;
-    std::string m_activeConnectionHost = "";
+    Session* m_previous = nullptr;
+    uint32_t m_lastSessionId = 0;
+    std::chrono::steady_clock::time_point m_switched;
+    std::mutex x_spinUp;
 
-    std::vector <URI> m_connections;
     std::thread m_workThread;
 
     boost::asio::io_service::strand m_io_strand;
     boost::asio::deadline_timer m_failovertimer;
-    PoolClient *p_client;
+    ClientFactory m_factory;
     energi::MinePlant &m_farm;
     MinerExecutionMode m_minerType;
 };
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <boost/bind.hpp>
+
+#include <common/utilstrencodings.h>
+
+#include "CancellableHttpClient.h"
+
+using boost::asio::ip::tcp;
+
+CancellableHttpClient::CancellableHttpClient(const std::string& url)
+    : m_resolver(m_io_service)
+    , m_socket(m_io_service)
+    , m_timer(m_io_service)
+{
+    std::string rest = url;
+    const size_t scheme = rest.find("://");
+    if (scheme != std::string::npos) {
+        rest = rest.substr(scheme + 3);
+    }
+    const size_t slash = rest.find('/');
+    m_path = slash == std::string::npos ? "/" : rest.substr(slash);
+    rest = rest.substr(0, slash);
+    const size_t at = rest.rfind('@');
+    if (at != std::string::npos) {
+        m_authorization = "Authorization: Basic " + EncodeBase64(rest.substr(0, at)) + "\r\n";
+        rest = rest.substr(at + 1);
+    }
+    const size_t colon = rest.rfind(':');
+    m_host = rest.substr(0, colon);
+    m_port = colon == std::string::npos ? "80" : rest.substr(colon + 1);
+}
+
+void CancellableHttpClient::SendRPCMessage(const std::string& message, std::string& result) throw (jsonrpc::JsonRpcException)
+{
+    if (m_cancelled.load(std::memory_order_relaxed)) {
+        throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, "request cancelled");
+    }
+    m_request = "POST " + m_path + " HTTP/1.1\r\nHost: " + m_host + ":" + m_port + "\r\n" + m_authorization
+              + "Content-Type: application/json\r\nContent-Length: " + std::to_string(message.size())
+              + "\r\nConnection: close\r\n\r\n" + message;
+    m_response.consume(m_response.size());
+    m_contentLength = 0;
+    m_status = 0;
+    m_done = false;
+    m_error.clear();
+
+    // A cancel() posted since the last request runs here and ends this one
+    m_io_service.reset();
+    m_timer.expires_from_now(boost::posix_time::milliseconds(m_timeoutMs));
+    m_timer.async_wait(boost::bind(&CancellableHttpClient::onTimeout, this, boost::asio::placeholders::error));
+    m_resolver.async_resolve(tcp::resolver::query(m_host, m_port),
+            boost::bind(&CancellableHttpClient::onResolve, this, boost::asio::placeholders::error, boost::asio::placeholders::iterator));
+    m_io_service.run();
+
+    if (!m_error.empty()) {
+        throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_CLIENT_CONNECTOR, m_error);
+    }
+    const std::size_t length = m_contentLength ? m_contentLength : m_response.size();
+    const std::string body(boost::asio::buffers_begin(m_response.data()),
+                           boost::asio::buffers_begin(m_response.data()) + length);
+    if (m_status / 100 != 2) {
+        // Like jsonrpc::HttpClient, the node's error body is passed on as the message
+        throw jsonrpc::JsonRpcException(jsonrpc::Errors::ERROR_RPC_INTERNAL_ERROR, body);
+    }
+    result = body;
+}
+
+void CancellableHttpClient::cancel()
+{
+    m_cancelled.store(true, std::memory_order_relaxed);
+    m_io_service.post(boost::bind(&CancellableHttpClient::finish, this, std::string("request cancelled")));
+}
+
+void CancellableHttpClient::onResolve(const boost::system::error_code& ec, tcp::resolver::iterator endpoints)
+{
+    if (m_done) {
+        return;
+    }
+    if (ec) {
+        finish("can't resolve " + m_host + ": " + ec.message());
+        return;
+    }
+    boost::asio::async_connect(m_socket, endpoints,
+            boost::bind(&CancellableHttpClient::onConnect, this, boost::asio::placeholders::error));
+}
+
+void CancellableHttpClient::onConnect(const boost::system::error_code& ec)
+{
+    if (m_done) {
+        return;
+    }
+    if (ec) {
+        finish("can't connect to " + m_host + ":" + m_port + ": " + ec.message());
+        return;
+    }
+    boost::system::error_code ignored;
+    m_socket.set_option(tcp::no_delay(true), ignored);
+    boost::asio::async_write(m_socket, boost::asio::buffer(m_request),
+            boost::bind(&CancellableHttpClient::onWrite, this, boost::asio::placeholders::error));
+}
+
+void CancellableHttpClient::onWrite(const boost::system::error_code& ec)
+{
+    if (m_done) {
+        return;
+    }
+    if (ec) {
+        finish(ec.message());
+        return;
+    }
+    boost::asio::async_read_until(m_socket, m_response, "\r\n\r\n",
+            boost::bind(&CancellableHttpClient::onHeaders, this, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+}
+
+void CancellableHttpClient::onHeaders(const boost::system::error_code& ec, std::size_t bytes)
+{
+    if (m_done) {
+        return;
+    }
+    if (ec) {
+        finish(ec.message());
+        return;
+    }
+    std::string headers(boost::asio::buffers_begin(m_response.data()),
+                        boost::asio::buffers_begin(m_response.data()) + bytes);
+    m_response.consume(bytes);
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+
+    const size_t space = headers.find(' ');
+    m_status = space == std::string::npos ? 0 : std::strtoul(headers.c_str() + space + 1, nullptr, 10);
+    const std::string field = "\r\ncontent-length:";
+    const size_t pos = headers.find(field);
+    m_contentLength = pos == std::string::npos ? 0 : std::strtoul(headers.c_str() + pos + field.size(), nullptr, 10);
+
+    if (m_contentLength && m_response.size() >= m_contentLength) {
+        onBody(boost::system::error_code());
+    } else if (m_contentLength) {
+        boost::asio::async_read(m_socket, m_response, boost::asio::transfer_exactly(m_contentLength - m_response.size()),
+                boost::bind(&CancellableHttpClient::onBody, this, boost::asio::placeholders::error));
+    } else {
+        // The connection is closed after the response
+        boost::asio::async_read(m_socket, m_response, boost::asio::transfer_all(),
+                boost::bind(&CancellableHttpClient::onBody, this, boost::asio::placeholders::error));
+    }
+}
+
+void CancellableHttpClient::onBody(const boost::system::error_code& ec)
+{
+    if (m_done) {
+        return;
+    }
+    if (ec && ec != boost::asio::error::eof) {
+        finish(ec.message());
+        return;
+    }
+    if (m_response.size() < m_contentLength) {
+        finish("connection closed before the end of the response");
+        return;
+    }
+    finish(std::string());
+}
+
+void CancellableHttpClient::onTimeout(const boost::system::error_code& ec)
+{
+    if (ec || m_done) {
+        return;
+    }
+    finish("no response after " + std::to_string(m_timeoutMs) + " ms");
+}
+
+void CancellableHttpClient::finish(const std::string& reason)
+{
+    if (m_done) {
+        return;
+    }
+    m_done = true;
+    m_error = reason;
+    boost::system::error_code ignored;
+    m_timer.cancel(ignored);
+    m_resolver.cancel();
+    m_socket.shutdown(tcp::socket::shutdown_both, ignored);
+    m_socket.close(ignored);
+}
@@ -2,8 +2,11 @@
 #include <boost/exception/diagnostic_information.hpp>
 
 #include "GetworkClient.h"
+#include "../replay/SessionRecorder.h"
 
 std::mutex GetworkClient::s_mutex;
+const long GetworkClient::c_longpollTimeout;
+const long GetworkClient::c_pollTimeout;
 
 using namespace energi;
 
@@ -19,22 +22,44 @@ GetworkClient::GetworkClient(unsigned const & farmRecheckPeriod, const std::stri
 
 GetworkClient::~GetworkClient()
 {
-	p_client = nullptr;
+    m_longpollExit.store(true, std::memory_order_relaxed);
+    {
+        // Neither loop is left waiting on the node
+        std::lock_guard<std::mutex> lock(s_mutex);
+        m_connected.store(false, std::memory_order_relaxed);
+        cancelRequests();
+    }
+    stopWorking();
+    if (m_longpollThread.joinable()) {
+        m_longpollThread.join();
+    }
 }
 
 void GetworkClient::connect()
 {
     std::lock_guard<std::mutex> lock(s_mutex);
-    std::string uri = "http://" + m_conn->User() + ":" + m_conn->Pass() + "@" + m_conn->Host() + ":" + std::to_string(m_conn->Port());
+    m_uri = "http://" + m_conn->User() + ":" + m_conn->Pass() + "@" + m_conn->Host() + ":" + std::to_string(m_conn->Port());
     if (m_conn->Path().length())
-        uri += m_conn->Path();
-    p_client = new ::JsonrpcGetwork(new jsonrpc::HttpClient(uri), m_coinbase);
+        m_uri += m_conn->Path();
+    ++m_uriGeneration;
+    m_longpollId.clear();
+    // The loops connect to the new node on their next request
+    cancelRequests();
+    {
+        std::lock_guard<std::mutex> submitLock(x_submit);
+        p_submit.reset();
+        m_submitConnector.reset(new jsonrpc::HttpClient(m_uri));
+        p_submit.reset(new ::JsonrpcGetwork(m_submitConnector.get(), m_coinbase));
+    }
 
     m_connected.store(true, std::memory_order_relaxed);
     // Since we do not have a real connected state with getwork, we just fake it
     if (m_onConnected) {
         m_onConnected();
     }
+    if (!m_longpollThread.joinable()) {
+        m_longpollThread = std::thread(&GetworkClient::longpoll, this);
+    }
     // No need to worry about starting again.
     // Worker class prevents that
     startWorking();
@@ -44,6 +69,7 @@ void GetworkClient::disconnect()
 {
     std::lock_guard<std::mutex> lock(s_mutex);
     m_connected.store(false, std::memory_order_relaxed);
+    cancelRequests();
 
 	// Since we do not have a real connected state with getwork, we just fake it.
 	if (m_onDisconnected) {
@@ -58,61 +84,215 @@ void GetworkClient::submitHashrate(const std::string& rate)
 	m_currentHashrateToSubmit = rate;
 }
 
-void GetworkClient::submit()
+void GetworkClient::submitSolution(const Solution& solution)
 {
-    std::lock_guard<std::mutex> lock(s_mutex);
-    if (m_connected.load(std::memory_order_relaxed)) {
-        try {
-            m_prevWork.reset();
-            std::chrono::steady_clock::time_point submit_start = std::chrono::steady_clock::now();
-            bool accepted = p_client->submitWork(m_solutionToSubmit);
-            std::chrono::milliseconds response_delay_ms =
-                std::chrono::duration_cast<std::chrono::milliseconds>(
-                        std::chrono::steady_clock::now() - submit_start);
-            if (accepted) {
-                if (m_onSolutionAccepted) {
-                    m_onSolutionAccepted(false, response_delay_ms);
-                }
-            } else {
-                if (m_onSolutionRejected) {
-                    m_onSolutionRejected(false, response_delay_ms);
-                }
+    // Runs on the plant's submit thread over its own connection,
+    // so it neither waits for nor delays the (long)poll
+    std::lock_guard<std::mutex> lock(x_submit);
+    if (!m_connected.load(std::memory_order_relaxed) || !p_submit) {
+        return;
+    }
+    try {
+        // getwork has no ids, submissions are recorded as id 4 like the stratum ones
+        if (SessionRecorder::active()) {
+            Json::Value jReq;
+            jReq["id"] = unsigned(4);
+            jReq["method"] = "submitblock";
+            jReq["params"].append(solution.getSubmitBlockData());
+            SessionRecorder::record(SessionRecorder::Direction::Outbound, jReq);
+        }
+        std::chrono::steady_clock::time_point submit_start = std::chrono::steady_clock::now();
+        bool accepted = p_submit->submitWork(solution);
+        if (SessionRecorder::active()) {
+            Json::Value jRes;
+            jRes["id"] = unsigned(4);
+            jRes["result"] = accepted;
+            SessionRecorder::record(SessionRecorder::Direction::Inbound, jRes);
+        }
+        std::chrono::milliseconds response_delay_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - submit_start);
+        std::chrono::milliseconds find_to_ack_ms =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - solution.getFoundTime());
+        {
+            // Announce the next template even if it is the same
+            std::lock_guard<std::mutex> workLock(s_mutex);
+            m_prevFingerprint.SetNull();
+        }
+        if (accepted) {
+            if (m_onSolutionAccepted) {
+                m_onSolutionAccepted(false, response_delay_ms, find_to_ack_ms);
+            }
+        } else {
+            if (m_onSolutionRejected) {
+                m_onSolutionRejected(false, response_delay_ms, find_to_ack_ms);
             }
-        } catch (const jsonrpc::JsonRpcException& ex) {
-            cwarn << "Failed to submit solution.";
-            cwarn << boost::diagnostic_information(ex);
         }
+    } catch (const jsonrpc::JsonRpcException& ex) {
+        cwarn << "Failed to submit solution.";
+        cwarn << boost::diagnostic_information(ex);
     }
-    m_solutionToSubmit.reset();
 }
 
-void GetworkClient::submitSolution(const Solution& solution)
+bool GetworkClient::isCurrent(unsigned generation) const
+{
+    return m_connected.load(std::memory_order_relaxed) && generation == m_uriGeneration;
+}
+
+bool GetworkClient::snapshot(NodeConnection& connection, NodeConnection& copy, long timeoutMs)
+{
+    if (!m_connected.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    if (!connection.client || connection.generation != m_uriGeneration) {
+        connection.generation = m_uriGeneration;
+        connection.connector = std::make_shared<CancellableHttpClient>(m_uri);
+        connection.connector->SetTimeout(timeoutMs);
+        connection.client = std::make_shared<JsonrpcGetwork>(connection.connector.get(), m_coinbase);
+    }
+    copy = connection;
+    return true;
+}
+
+void GetworkClient::cancelRequests()
 {
+    for (NodeConnection* connection : { &m_poll, &m_longpoll }) {
+        if (connection->connector) {
+            connection->connector->cancel();
+        }
+    }
+}
+
+void GetworkClient::processTemplate(const Json::Value& gbt, const char* source, unsigned generation,
+                                    const std::chrono::steady_clock::time_point& requested)
+{
+    using namespace std::chrono;
+    auto received = steady_clock::now();
+    {
+        // A request can be answered just as a disconnect or a move to another node gives it up
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!isCurrent(generation)) {
+            return;
+        }
+    }
+    if (SessionRecorder::active()) {
+        Json::Value jRes;
+        jRes["method"] = "getblocktemplate";
+        jRes["result"] = gbt;
+        SessionRecorder::record(SessionRecorder::Direction::Inbound, jRes);
+    }
+    // Only a template that changes the block is decoded, and only its new transactions
+    const uint256 fingerprint = energi::TemplateCache::fingerprint(gbt);
+    std::lock_guard<std::mutex> templateLock(x_template);
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!isCurrent(generation)) {
+            return;
+        }
+        if (gbt.isMember("longpollid") && gbt["longpollid"].isString()) {
+            m_longpollId = gbt["longpollid"].asString();
+        }
+        if (fingerprint == m_prevFingerprint) {
+            return;
+        }
+    }
+    const uint64_t decoded = m_templateCache.decoded();
+    energi::Work newWork(gbt, m_coinbase, &m_templateCache);
+    m_templateCache.sweep();
+
     std::lock_guard<std::mutex> lock(s_mutex);
-    m_solutionToSubmit = solution;
+    if (!isCurrent(generation)) {
+        return;
+    }
+    m_prevFingerprint = fingerprint;
+    m_prevWork = newWork;
+    if (m_onWorkReceived) {
+        m_onWorkReceived(m_prevWork);
+    }
+    cnote << "Work from " << source << " after "
+          << duration_cast<milliseconds>(received - requested).count() << " ms, ready in "
+          << duration_cast<microseconds>(steady_clock::now() - received).count() << " us, "
+          << m_templateCache.decoded() - decoded << " of " << newWork.vtx.size() - 1 << " transactions decoded";
 }
 
-// Handles all getwork communication.
+// Holds a getblocktemplate request open on its own connection until the node has a new template
+void GetworkClient::longpoll()
+{
+    using namespace std::chrono;
+    setThreadName("longpoll");
+    while (!m_longpollExit.load(std::memory_order_relaxed)) {
+        NodeConnection connection;
+        std::string longpollid;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            if (snapshot(m_longpoll, connection, c_longpollTimeout)) {
+                longpollid = m_longpollId;
+            }
+        }
+        // Nothing to wait on until a poll told us the node supports longpoll
+        if (longpollid.empty()) {
+            m_longpollActive.store(false, std::memory_order_relaxed);
+            std::this_thread::sleep_for(milliseconds(m_farmRecheckPeriod));
+            continue;
+        }
+        m_longpollActive.store(true, std::memory_order_relaxed);
+        auto requested = steady_clock::now();
+        try {
+            processTemplate(connection.client->getBlockTemplate(longpollid), "longpoll", connection.generation, requested);
+        } catch (const jsonrpc::JsonRpcException& ex) {
+            bool current;
+            {
+                std::lock_guard<std::mutex> lock(s_mutex);
+                current = isCurrent(connection.generation);
+            }
+            // Neither a request given up by connect() or disconnect() nor a quiet node is a failure
+            if (current && duration_cast<milliseconds>(steady_clock::now() - requested).count() < c_longpollTimeout) {
+                // Let the fallback poll take over for a while
+                cwarn << "Longpoll failed: " << ex.what();
+                m_longpollActive.store(false, std::memory_order_relaxed);
+                std::this_thread::sleep_for(milliseconds(m_farmRecheckPeriod));
+            }
+        } catch (const std::exception& ex) {
+            cwarn << "Longpoll failed: " << ex.what();
+            m_longpollActive.store(false, std::memory_order_relaxed);
+            std::this_thread::sleep_for(milliseconds(m_farmRecheckPeriod));
+        }
+        // Do not spin against a node answering immediately
+        auto elapsed = steady_clock::now() - requested;
+        if (elapsed < milliseconds(250)) {
+            std::this_thread::sleep_for(milliseconds(250) - elapsed);
+        }
+    }
+    m_longpollActive.store(false, std::memory_order_relaxed);
+}
+
+// Handles the fallback polling, idle while a longpoll is outstanding
 void GetworkClient::trun()
 {
     while (!shouldStop()) {
-        if (m_connected.load(std::memory_order_relaxed)) {
+        NodeConnection poll;
+        bool polling;
+        {
+            std::lock_guard<std::mutex> lock(s_mutex);
+            polling = !m_longpollActive.load(std::memory_order_relaxed) && snapshot(m_poll, poll, c_pollTimeout);
+        }
+        if (polling) {
             // Get Work
             try {
-                if (m_solutionToSubmit.getNonce() > 0) {
-                    submit();
+                auto requested = std::chrono::steady_clock::now();
+                processTemplate(poll.client->getBlockTemplate(), "poll", poll.generation, requested);
+            } catch (jsonrpc::JsonRpcException) {
+                bool current;
+                {
+                    std::lock_guard<std::mutex> lock(s_mutex);
+                    current = isCurrent(poll.generation);
                 }
-                energi::Work newWork = p_client->getWork();
-                // Check if header changes so the new workpackage is really new
-                if (newWork != m_prevWork) {
-                    m_prevWork = newWork;
-                    if (m_onWorkReceived) {
-                        m_onWorkReceived(m_prevWork);
-                    }
+                // A poll given up by connect() or disconnect() says nothing about the node
+                if (current) {
+                    cwarn << "Failed getting work!";
+                    disconnect();
                 }
-            } catch (jsonrpc::JsonRpcException) {
-                cwarn << "Failed getting work!";
-                disconnect();
             }
             //TODO submit hashrate part
         }
@@ -2,7 +2,11 @@
 
 #include <jsonrpccpp/client/connectors/httpclient.h>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <primitives/templatecache.h>
 #include <primitives/worker.h>
+#include "CancellableHttpClient.h"
 #include "jsonrpc_getwork.h"
 #include "../PoolClient.h"
 
@@ -23,17 +27,58 @@ public:
 	void submitHashrate(const std::string& rate) override;
 	void submitSolution(const energi::Solution& solution) override;
 
-    void submit();
-
 private:
+	// One loop's connection to the node, rebuilt once connect() has moved on
+	struct NodeConnection
+	{
+		unsigned generation = 0;
+		std::shared_ptr<CancellableHttpClient> connector;
+		std::shared_ptr<JsonrpcGetwork> client;
+	};
+
 	void trun() override;
+	void longpoll();
+	//! Copies the loop's connection, rebuilding it first for a new node, false while disconnected. Callers hold s_mutex
+	bool snapshot(NodeConnection& connection, NodeConnection& copy, long timeoutMs);
+	//! Gives up the poll and longpoll requests in flight. Callers hold s_mutex
+	void cancelRequests();
+	//! Drops the template unless the client is still connected to the node the request went to
+	void processTemplate(const Json::Value& gbt, const char* source, unsigned generation,
+	                     const std::chrono::steady_clock::time_point& requested);
+	//! Callers hold s_mutex
+	bool isCurrent(unsigned generation) const;
 	unsigned m_farmRecheckPeriod = 500;
 
+	// A longpoll request is renewed after this long even if the node is quiet
+	static const long c_longpollTimeout = 30000;
+	// jsonrpc::HttpClient's default
+	static const long c_pollTimeout = 10000;
+
 private:
-    energi::Solution m_solutionToSubmit;
     std::string m_coinbase;
     std::string m_currentHashrateToSubmit = "";
-    JsonrpcGetwork *p_client = nullptr;
+    std::string m_uri;
+    unsigned m_uriGeneration = 0;   // bumped on connect, both loops rebuild their connection
+
+    // The loops request on copies of these, so connect() never frees a connection in use
+    NodeConnection m_poll;          // fallback poll, only used while no longpoll is outstanding
+    NodeConnection m_longpoll;
+
+    // Submissions have their own keep-alive connection so they never queue behind a poll
+    std::mutex x_submit;
+    std::unique_ptr<jsonrpc::HttpClient> m_submitConnector;
+    std::unique_ptr<JsonrpcGetwork> p_submit;
+
+    std::thread m_longpollThread;
+    std::atomic<bool> m_longpollExit = { false };
+    std::atomic<bool> m_longpollActive = { false };
+    std::string m_longpollId;
+
+    // Serializes the template updates of the poll and the longpoll
+    std::mutex x_template;
+    energi::TemplateCache m_templateCache;
+    uint256 m_prevFingerprint;      // of the announced template, null to announce the next one
+
     energi::Work m_prevWork;
     static std::mutex s_mutex;
 };
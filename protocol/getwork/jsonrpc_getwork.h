@@ -19,7 +19,8 @@ public:
         this->m_client = new jsonrpc::Client(*conn, jsonrpc::JSONRPC_CLIENT_V1);
     }
 
-    Json::Value getBlockTemplate() throw (jsonrpc::JsonRpcException)
+    // With a longpollid the node holds the request until the template changes
+    Json::Value getBlockTemplate(const std::string& longpollid = std::string()) throw (jsonrpc::JsonRpcException)
     {
         auto params = Json::Value(Json::arrayValue);
         auto object = Json::Value(Json::objectValue);
@@ -28,6 +29,9 @@ public:
         object["capabilities"].append("coinbasevalue");
         object["capabilities"].append("longpoll");
         object["capabilities"].append("workid");
+        if (!longpollid.empty()) {
+            object["longpollid"] = longpollid;
+        }
         params.append(object);
 
         Json::Value result = this->m_client->CallMethod("getblocktemplate", params);
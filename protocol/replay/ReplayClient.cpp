@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "ReplayClient.h"
+#include "SessionRecorder.h"
+#include "../stratum/StratumParser.h"
+
+using namespace energi;
+
+const unsigned ReplayClient::c_reportSeconds;
+
+namespace {
+
+//! "p50/p90/p99/max" of the values
+std::string distribution(std::vector<uint64_t> values)
+{
+    if (values.empty()) {
+        return "-";
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&values](double q) { return values[static_cast<size_t>(q * (values.size() - 1))]; };
+    std::stringstream ss;
+    ss << at(0.5) << "/" << at(0.9) << "/" << at(0.99) << "/" << values.back();
+    return ss.str();
+}
+
+} //! anonymous namespace
+
+ReplayClient::ReplayClient(const std::string& file, double speed)
+    : PoolClient()
+    , Worker("replay")
+    , m_file(file)
+    , m_speed(speed > 0 ? speed : 1.0)
+{
+    m_subscribed.store(true, std::memory_order_relaxed);
+    m_authorized.store(true, std::memory_order_relaxed);
+}
+
+ReplayClient::~ReplayClient()
+{
+    stopWorking();
+}
+
+bool ReplayClient::load()
+{
+    std::ifstream log(m_file);
+    std::string line;
+    if (!log || !std::getline(log, line) || line.compare(0, std::strlen(SessionRecorder::c_magic), SessionRecorder::c_magic) != 0) {
+        cwarn << m_file << " is not a session log";
+        return false;
+    }
+    std::istringstream header(line.substr(std::strlen(SessionRecorder::c_magic)));
+    header >> m_protocol >> m_coinbase;
+    if (m_protocol != "stratum" && m_protocol != "getwork") {
+        cwarn << "Cannot replay a " << m_protocol << " session";
+        return false;
+    }
+
+    Json::Reader reader;
+    std::deque<uint64_t> submits;
+    uint64_t time = 0;
+    unsigned lineNumber = 1;
+    while (std::getline(log, line)) {
+        ++lineNumber;
+        // <delta us> <direction> <json>
+        size_t space = line.find(' ');
+        if (space == std::string::npos || space + 3 > line.size()) {
+            cwarn << m_file << ":" << lineNumber << " is malformed, replaying up to it";
+            break;
+        }
+        time += std::strtoull(line.c_str(), nullptr, 10);
+        const char direction = line[space + 1];
+        Message message{ time, line.substr(space + 3) };
+
+        Json::Value json;
+        if (!reader.parse(message.json, json) || !json.isObject()) {
+            continue;
+        }
+        const bool submit = json.get("id", Json::Value::null).isConvertibleTo(Json::uintValue)
+                            && json.get("id", 0).asUInt() == 4;
+        if (direction == static_cast<char>(SessionRecorder::Direction::Outbound)) {
+            // Only the submissions matter, the miner makes its own on replay
+            if (submit) {
+                submits.push_back(time);
+                ++m_recordedSubmits;
+            }
+            continue;
+        }
+        if (submit && !json.isMember("method")) {
+            // Pools answer submissions in order
+            if (!submits.empty()) {
+                m_recordedRtt.push_back(time - submits.front());
+                submits.pop_front();
+            }
+            const Json::Value result = json.get("result", Json::Value::null);
+            if (!json.get("error", Json::Value::null).empty() || (result.isBool() && !result.asBool())) {
+                ++m_recordedRejects;
+            }
+            continue;
+        }
+        m_messages.push_back(std::move(message));
+    }
+    if (m_messages.empty()) {
+        cwarn << m_file << " holds no messages from the pool";
+        return false;
+    }
+
+    std::vector<uint64_t> rttMs;
+    for (auto rtt : m_recordedRtt) {
+        rttMs.push_back(rtt / 1000);
+    }
+    cnote << "Replaying " << m_protocol << " session " << m_file << ": " << m_messages.size() << " messages over "
+          << m_messages.back().time / 1000000 << " s at " << m_speed << "x, recorded "
+          << m_recordedSubmits << " submits, " << m_recordedRejects << " rejected, round trip "
+          << distribution(rttMs) << " ms";
+    return true;
+}
+
+void ReplayClient::connect()
+{
+    m_connected.store(true, std::memory_order_relaxed);
+    if (m_onConnected) {
+        m_onConnected();
+    }
+    startWorking();
+}
+
+void ReplayClient::disconnect()
+{
+    m_connected.store(false, std::memory_order_relaxed);
+    if (m_onDisconnected) {
+        m_onDisconnected();
+    }
+}
+
+void ReplayClient::submitHashrate(const std::string& rate)
+{
+    (void)rate;
+}
+
+void ReplayClient::submitSolution(const Solution& solution)
+{
+    // GetPOWHash overwrites the mix hash, compare against the one the miner sent
+    Work work = solution.getWork();
+    const uint256 mixHash = work.hashMix;
+    const uint256 hash = Miner::GetPOWHash(work);
+    const bool valid = work.meetsTarget(hash) && work.hashMix == mixHash;
+
+    std::lock_guard<std::mutex> lock(x_work);
+    Reply reply;
+    reply.found = solution.getFoundTime();
+    reply.valid = valid;
+    reply.stale = work != m_current || work.getJobName() != m_current.getJobName();
+    // Answered as late as the recorded pool answered, in the recorded order
+    uint64_t rtt = 0;
+    if (!m_recordedRtt.empty()) {
+        rtt = m_recordedRtt[m_nextRtt++ % m_recordedRtt.size()];
+    }
+    reply.delay = std::chrono::milliseconds(static_cast<int64_t>(rtt / 1000 / m_speed));
+    reply.due = std::chrono::steady_clock::now() + reply.delay;
+    m_replies.push_back(reply);
+    m_wake.notify_one();
+}
+
+void ReplayClient::setWork(Work&& work, bool reset)
+{
+    Work current;
+    {
+        std::lock_guard<std::mutex> lock(x_work);
+        if (!reset && m_current == work && m_current.getJobName() == work.getJobName()) {
+            return;
+        }
+        m_current = std::move(work);
+        current = m_current;
+    }
+    if (reset && m_onResetWork) {
+        m_onResetWork();
+    }
+    if (m_onWorkReceived) {
+        m_onWorkReceived(current);
+    }
+}
+
+void ReplayClient::setExtraNonce(std::string enonce)
+{
+    m_extraNonceHexSize = enonce.length();
+    enonce.append(16 - std::min<size_t>(16, enonce.length()), '0');
+    m_extraNonce = enonce;
+}
+
+// Same handling as StratumClient, without the session management
+void ReplayClient::processStratum(const Message& message)
+{
+    StratumMessage parsed;
+    StratumJob job;
+    const char* begin = message.json.data();
+    if (StratumParser::parse(begin, begin + message.json.size(), parsed)) {
+        if (parsed.kind == StratumMessage::Kind::SetDifficulty) {
+            m_nextWorkTarget = StratumParser::difficultyToTarget(std::max(parsed.difficulty, 0.0001));
+            std::lock_guard<std::mutex> lock(x_work);
+            m_current.reset();
+            return;
+        }
+        if (parsed.kind != StratumMessage::Kind::Notify) {
+            return;
+        }
+        job = parsed.job;
+    } else {
+        Json::Value json;
+        Json::Reader reader;
+        if (!reader.parse(message.json, json)) {
+            return;
+        }
+        const std::string method = json.get("method", "").asString();
+        const Json::Value params = json.get("params", Json::Value::null);
+        const Json::Value id = json.get("id", Json::Value::null);
+        if (method.empty() && id.isConvertibleTo(Json::uintValue) && id.asUInt() == 1) {
+            const Json::Value result = json.get("result", Json::Value::null);
+            if (result.isArray()) {
+                setExtraNonce(result.get((Json::Value::ArrayIndex)1, "").asString());
+            }
+            return;
+        }
+        if (method == "mining.set_extranonce" && params.isArray()) {
+            setExtraNonce(params.get((Json::Value::ArrayIndex)0, "").asString());
+            return;
+        }
+        if (method == "mining.set_difficulty" && params.isArray()) {
+            m_nextWorkTarget = StratumParser::difficultyToTarget(
+                std::max(params.get((Json::Value::ArrayIndex)0, 1).asDouble(), 0.0001));
+            std::lock_guard<std::mutex> lock(x_work);
+            m_current.reset();
+            return;
+        }
+        if (method != "mining.notify" || !params.isArray()
+            || params.get((Json::Value::ArrayIndex)2, "").asString().empty()
+            || params.get((Json::Value::ArrayIndex)3, "").asString().empty()) {
+            return;
+        }
+        job = StratumJob::fromJson(params);
+    }
+
+    Work work(job, m_extraNonce);
+    work.setTarget(m_nextWorkTarget);
+    work.exSizeBits = m_extraNonceHexSize * 4;
+    setWork(std::move(work), !job.clean);
+}
+
+void ReplayClient::processGetwork(const Message& message)
+{
+    Json::Value json;
+    Json::Reader reader;
+    if (!reader.parse(message.json, json) || json.get("method", "").asString() != "getblocktemplate") {
+        return;
+    }
+    try {
+        setWork(Work(json["result"], m_coinbase), false);
+    } catch (const WorkException& e) {
+        cwarn << "Recorded template at " << message.time / 1000 << " ms is unusable: " << e.what();
+    }
+}
+
+void ReplayClient::deliver(const Message& message, const std::chrono::steady_clock::time_point& due)
+{
+    Work before;
+    {
+        std::lock_guard<std::mutex> lock(x_work);
+        before = m_current;
+    }
+    if (m_protocol == "stratum") {
+        processStratum(message);
+    } else {
+        processGetwork(message);
+    }
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(x_work);
+    // Only messages that handed the plant a new job count as a switch
+    if (m_current.isValid() && (m_current != before || m_current.getJobName() != before.getJobName())) {
+        m_jobSwitchUs.push_back(std::chrono::duration_cast<std::chrono::microseconds>(now - due).count());
+    }
+}
+
+void ReplayClient::answer(const std::chrono::steady_clock::time_point& now)
+{
+    while (true) {
+        Reply reply;
+        {
+            std::lock_guard<std::mutex> lock(x_work);
+            if (m_replies.empty() || m_replies.front().due > now) {
+                return;
+            }
+            reply = m_replies.front();
+            m_replies.pop_front();
+            auto const findToAck = std::chrono::duration_cast<std::chrono::milliseconds>(now - reply.found);
+            m_findToAckMs.push_back(findToAck.count());
+            if (!reply.valid) {
+                ++m_rejected;
+            } else if (reply.stale) {
+                ++m_stale;
+            } else {
+                ++m_accepted;
+            }
+        }
+        auto const findToAck = std::chrono::duration_cast<std::chrono::milliseconds>(now - reply.found);
+        if (reply.valid) {
+            if (m_onSolutionAccepted) {
+                m_onSolutionAccepted(reply.stale, reply.delay, findToAck);
+            }
+        } else if (m_onSolutionRejected) {
+            m_onSolutionRejected(reply.stale, reply.delay, findToAck);
+        }
+    }
+}
+
+void ReplayClient::report(bool final)
+{
+    std::lock_guard<std::mutex> lock(x_work);
+    const uint64_t total = m_accepted + m_stale + m_rejected;
+    cnote << (final ? "Replay finished: " : "Replay: ") << m_jobSwitchUs.size() << " jobs, switch "
+          << distribution(m_jobSwitchUs) << " us, shares " << m_accepted << "/" << m_stale << "/" << m_rejected
+          << " accepted/stale/rejected, " << std::fixed << std::setprecision(2)
+          << (total ? 100.0 * m_stale / total : 0.0) << "% stale, find to ack " << distribution(m_findToAckMs) << " ms";
+}
+
+void ReplayClient::trun()
+{
+    using namespace std::chrono;
+    setThreadName("replay");
+    m_started = m_lastReport = steady_clock::now();
+    auto dueOf = [this](const Message& message) {
+        return m_started + duration_cast<steady_clock::duration>(microseconds(message.time) / m_speed);
+    };
+    size_t next = 0;
+    bool finished = false;
+    while (!shouldStop()) {
+        auto now = steady_clock::now();
+        if (m_connected.load(std::memory_order_relaxed)) {
+            while (next < m_messages.size() && dueOf(m_messages[next]) <= now) {
+                deliver(m_messages[next], dueOf(m_messages[next]));
+                ++next;
+            }
+            answer(now);
+            if (now - m_lastReport >= seconds(c_reportSeconds)) {
+                m_lastReport = now;
+                report(false);
+            }
+        }
+        std::unique_lock<std::mutex> lock(x_work);
+        if (!finished && next == m_messages.size() && m_replies.empty()) {
+            // The pool manager moves on to the exit connection once this one is gone
+            finished = true;
+            lock.unlock();
+            report(true);
+            m_conn->MarkUnrecoverable();
+            disconnect();
+            continue;
+        }
+        auto wake = now + milliseconds(100);
+        if (next < m_messages.size()) {
+            wake = std::min(wake, dueOf(m_messages[next]));
+        }
+        if (!m_replies.empty()) {
+            wake = std::min(wake, m_replies.front().due);
+        }
+        m_wake.wait_until(lock, wake);
+    }
+}
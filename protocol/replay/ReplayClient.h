@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <primitives/worker.h>
+
+#include "../PoolClient.h"
+
+/**
+ * @brief Plays a SessionRecorder log back into the plant instead of a pool.
+ *        Messages from the pool arrive at their recorded times divided by
+ *        speed, solutions are verified locally and answered after the pool's
+ *        recorded submit round trips. Job switch latency, stale share rate
+ *        and round trip distributions are reported, so changes to the work
+ *        handling can be compared on the same session offline.
+ */
+class ReplayClient : public PoolClient, energi::Worker
+{
+public:
+    ReplayClient(const std::string& file, double speed);
+    ~ReplayClient();
+
+    //! Reads the log, false if it is missing or not a session log
+    bool load();
+
+    void connect() override;
+    void disconnect() override;
+
+    bool isConnected() override { return m_connected; }
+    bool isPendingState() override { return false; }
+    std::string ActiveEndPoint() override { return " [replay]"; }
+
+    void submitHashrate(const std::string& rate) override;
+    void submitSolution(const energi::Solution& solution) override;
+
+private:
+    struct Message
+    {
+        uint64_t    time;   // microseconds since the start of the session
+        std::string json;
+    };
+
+    struct Reply
+    {
+        std::chrono::steady_clock::time_point due;
+        std::chrono::steady_clock::time_point found;
+        std::chrono::milliseconds             delay;
+        bool                                  valid;
+        bool                                  stale;
+    };
+
+    void trun() override;
+    void deliver(const Message& message, const std::chrono::steady_clock::time_point& due);
+    void processStratum(const Message& message);
+    void processGetwork(const Message& message);
+    void setWork(energi::Work&& work, bool reset);
+    void setExtraNonce(std::string enonce);
+    void answer(const std::chrono::steady_clock::time_point& now);
+    void report(bool final);
+
+    static const unsigned c_reportSeconds = 60;
+
+    const std::string m_file;
+    const double      m_speed;
+
+    std::string m_protocol;
+    std::string m_coinbase;
+    std::vector<Message> m_messages;      // pool to miner, in recorded order
+    std::vector<uint64_t> m_recordedRtt;  // submit round trips of the pool, us
+    uint64_t m_recordedSubmits = 0;
+    uint64_t m_recordedRejects = 0;
+
+    // Stratum session state, as StratumClient keeps it
+    std::string   m_extraNonce;
+    int           m_extraNonceHexSize = 0;
+    arith_uint256 m_nextWorkTarget = arith_uint256("0xffff000000000000000000000000000000000000000000000000000000000000");
+
+    std::mutex              x_work;
+    energi::Work            m_current;
+    std::condition_variable m_wake;
+    std::deque<Reply>       m_replies;
+    size_t                  m_nextRtt = 0;
+
+    std::chrono::steady_clock::time_point m_started;
+    std::chrono::steady_clock::time_point m_lastReport;
+    std::vector<uint64_t> m_jobSwitchUs;     // scheduled arrival to plant updated
+    std::vector<uint64_t> m_findToAckMs;
+    uint64_t m_accepted = 0;
+    uint64_t m_stale = 0;
+    uint64_t m_rejected = 0;
+};
@@ -0,0 +1,71 @@
+#include "SessionRecorder.h"
+
+#include <common/Log.h>
+
+using namespace energi;
+
+const char* const SessionRecorder::c_magic = "# energiminer session 1";
+
+std::atomic<bool> SessionRecorder::s_active = { false };
+std::mutex SessionRecorder::x_log;
+std::ofstream SessionRecorder::s_log;
+std::chrono::steady_clock::time_point SessionRecorder::s_last;
+std::chrono::steady_clock::time_point SessionRecorder::s_lastFlush;
+
+bool SessionRecorder::open(const std::string& path, const std::string& protocol, const std::string& coinbase)
+{
+    std::lock_guard<std::mutex> lock(x_log);
+    s_log.open(path, std::ios::out | std::ios::trunc);
+    if (!s_log) {
+        cwarn << "Cannot open session log " << path;
+        return false;
+    }
+    s_log << c_magic << ' ' << protocol;
+    if (!coinbase.empty()) {
+        s_log << ' ' << coinbase;
+    }
+    s_log << '\n';
+    s_last = s_lastFlush = std::chrono::steady_clock::now();
+    s_active.store(true, std::memory_order_relaxed);
+    cnote << "Recording the " << protocol << " session to " << path;
+    return true;
+}
+
+void SessionRecorder::close()
+{
+    std::lock_guard<std::mutex> lock(x_log);
+    s_active.store(false, std::memory_order_relaxed);
+    if (s_log.is_open()) {
+        s_log.close();
+    }
+}
+
+void SessionRecorder::record(Direction direction, const char* begin, const char* end)
+{
+    while (end != begin && (*(end - 1) == '\n' || *(end - 1) == '\r')) {
+        --end;
+    }
+    auto const now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(x_log);
+    if (!s_active.load(std::memory_order_relaxed)) {
+        return;
+    }
+    // Deltas keep the timestamps short, the clock is monotonic so they never go negative
+    s_log << std::chrono::duration_cast<std::chrono::microseconds>(now - s_last).count()
+          << ' ' << static_cast<char>(direction) << ' ';
+    s_log.write(begin, end - begin);
+    s_log << '\n';
+    s_last = now;
+    // A killed miner still leaves all but the last second behind
+    if (now - s_lastFlush >= std::chrono::seconds(1)) {
+        s_log.flush();
+        s_lastFlush = now;
+    }
+}
+
+void SessionRecorder::record(Direction direction, const Json::Value& message)
+{
+    Json::FastWriter writer;
+    const std::string line = writer.write(message);
+    record(direction, line.data(), line.data() + line.size());
+}
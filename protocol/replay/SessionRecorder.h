@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include <json/json.h>
+
+/**
+ * @brief Captures every message exchanged with the pool to a text log, one
+ *        per line as "<microseconds since previous line> <direction> <json>",
+ *        with '<' from the pool and '>' to the pool. The first line names the
+ *        protocol, ReplayClient plays such a log back without a pool.
+ */
+class SessionRecorder
+{
+public:
+    enum class Direction : char
+    {
+        Inbound = '<',
+        Outbound = '>'
+    };
+
+    //! Starts the capture, coinbase is needed to rebuild getwork templates on replay
+    static bool open(const std::string& path, const std::string& protocol, const std::string& coinbase);
+    static void close();
+
+    static bool active()
+    {
+        return s_active.load(std::memory_order_relaxed);
+    }
+
+    //! One message without its line terminator
+    static void record(Direction direction, const char* begin, const char* end);
+    static void record(Direction direction, const Json::Value& message);
+
+    static const char* const c_magic;
+
+private:
+    static std::atomic<bool> s_active;
+    static std::mutex x_log;
+    static std::ofstream s_log;
+    static std::chrono::steady_clock::time_point s_last;
+    static std::chrono::steady_clock::time_point s_lastFlush;
+};
@@ -1,4 +1,7 @@
 #include "StratumClient.h"
+#include "../replay/SessionRecorder.h"
+
+#include <common/utilstrencodings.h>
 
 #include <energiminer/buildinfo.h>
 
@@ -8,32 +11,27 @@
 
 #define BOOST_ASIO_ENABLE_CANCELIO
 
-namespace {
+using boost::asio::ip::tcp;
 
-void diffToTarget(uint32_t *target, double diff)
-{
-    uint32_t target2[8];
-    uint64_t m;
-    int k;
-
-    for (k = 6; k > 0 && diff > 1.0; k--)
-        diff /= 4294967296.0;
-    m = (uint64_t)(4294901760.0 / diff);
-    if (m == 0 && k == 6)
-        memset(target2, 0xff, 32);
-    else {
-        memset(target2, 0, 32);
-        target2[k] = (uint32_t)m;
-        target2[k + 1] = (uint32_t)(m >> 32);
-    }
+const size_t StratumClient::c_sendPoolSize;
+const size_t StratumClient::c_sendBufferCapacity;
 
-    for (int i = 0; i < 32; i++)
-        ((uint8_t*)target)[i] = ((uint8_t*)target2)[i];
-}
+namespace {
+
+// Fixed width fields at the start of a submit's body, extranonce and time, patched in place
+const char c_submitFixed[] = "00000000\",\"00000000\",\"";
+const size_t c_submitTimeOffset = 11;
 
+void writeHex32(char* out, uint32_t value)
+{
+    const unsigned char bytes[4] = {
+        static_cast<unsigned char>(value >> 24), static_cast<unsigned char>(value >> 16),
+        static_cast<unsigned char>(value >> 8), static_cast<unsigned char>(value)
+    };
+    HexEncode(bytes, sizeof(bytes), out);
 }
 
-using boost::asio::ip::tcp;
+} //! anonymous namespace
 
 StratumClient::StratumClient(boost::asio::io_service & io_service,
                              int worktimeout,
@@ -462,7 +460,12 @@ void StratumClient::connect_handler(const boost::system::error_code& ec)
     if (m_conn->SecLevel() != SecureLevel::NONE) {
         boost::system::error_code hec;
         m_securesocket->lowest_layer().set_option(boost::asio::socket_base::keep_alive(true));
-        m_securesocket->lowest_layer().set_option(tcp::no_delay(true));
+        // Shares are small writes, they must not wait for the previous one to be acknowledged
+        m_securesocket->lowest_layer().set_option(tcp::no_delay(true), hec);
+        if (hec) {
+            cwarn << "Could not disable Nagle's algorithm: " << hec.message();
+            hec.clear();
+        }
 
         m_securesocket->handshake(boost::asio::ssl::stream_base::client, hec);
 
@@ -495,14 +498,18 @@ void StratumClient::connect_handler(const boost::system::error_code& ec)
         }
     } else {
         m_nonsecuresocket->set_option(boost::asio::socket_base::keep_alive(true));
-        m_nonsecuresocket->set_option(tcp::no_delay(true));
+        boost::system::error_code nec;
+        m_nonsecuresocket->set_option(tcp::no_delay(true), nec);
+        if (nec) {
+            cwarn << "Could not disable Nagle's algorithm: " << nec.message();
+        }
     }
 
     // Here is where we're properly connected
     m_connected.store(true, std::memory_order_relaxed);
 
     // Clean buffer from any previous stale data
-    m_sendBuffer.consume(4096);
+    clearSendQueue();
     clear_response_pleas();
 
     // Trigger event handlers and begin counting for the next job
@@ -520,6 +527,18 @@ void StratumClient::connect_handler(const boost::system::error_code& ec)
     } else {
         m_user = m_conn->User();
     }
+    {
+        // Closes every submit of this connection
+        std::string tail = "\"]";
+        if (m_worker.length()) {
+            tail += ",\"worker\":" + Json::valueToQuotedString(m_worker.c_str());
+        }
+        tail += "}\n";
+        std::lock_guard<std::mutex> lock(x_send);
+        m_submitTail = std::make_shared<const std::string>(std::move(tail));
+        m_submitHead.reset();
+        m_submitJob.clear();
+    }
 
     /*
        If connection has been set-up with a specific scheme then
@@ -831,28 +850,13 @@ void StratumClient::processResponse(Json::Value& responseObject)
             }
             break;
         case 4:
-            response_delay_ms = dequeue_response_plea();
             // Response to solution submission mining.submit  (https://en.bitcoin.it/wiki/Stratum_mining_protocol#mining.submit)
             // Result should be boolean, some pools also throw an error, so _isSuccess can be false
             // Due to this reevaluate _isSucess
             if (_isSuccess && jResult.isBool()) {
                 _isSuccess = jResult.asBool();
             }
-            {
-                dequeue_response_plea();
-                if (_isSuccess) {
-                    if (m_onSolutionAccepted) {
-                        m_onSolutionAccepted(false, response_delay_ms);
-                    }
-                } else {
-                    if (m_onSolutionRejected) {
-                        if (!_errReason.empty()) {
-                            cwarn << "Reject reason: " << (_errReason.empty() ? "Unspecified" : _errReason);
-                        }
-                        m_onSolutionRejected(true, response_delay_ms);
-                    }
-                }
-            }
+            processSubmitResponse(_isSuccess, _errReason);
             break;
         case 5:
 
@@ -909,31 +913,13 @@ void StratumClient::processResponse(Json::Value& responseObject)
             if (jPrm.isArray()) {
                 if (!jPrm.get((Json::Value::ArrayIndex)2, "").asString().empty() &&
                     !jPrm.get((Json::Value::ArrayIndex)3, "").asString().empty()) {
-
-                    bool resetJob = !jPrm.get((Json::Value::ArrayIndex)8, "").asBool();
-
-                    auto work = energi::Work(jPrm, m_extraNonce, true);
-                    if (resetJob || m_current != work) {
-                        if (resetJob && m_onResetWork) {
-                            m_onResetWork();
-                        }
-                        m_current = work;
-                        m_current.hashTarget = m_nextWorkTarget;
-                        m_current.exSizeBits = m_extraNonceHexSize * 4;
-                        m_current_timestamp = std::chrono::steady_clock::now();
-                        if (m_onWorkReceived) {
-                            m_onWorkReceived(m_current);
-                        }
-                    }
+                    processNotify(energi::StratumJob::fromJson(jPrm));
                 }
             }
         } else if (_method == "mining.set_difficulty") {
             jPrm = responseObject.get("params", Json::Value::null);
             if (jPrm.isArray()) {
-                double nextWorkDifficulty = std::max(jPrm.get((Json::Value::ArrayIndex)0, 1).asDouble(), 0.0001);
-                cnote << "Difficulty set to: "  << nextWorkDifficulty;
-                diffToTarget((uint32_t*)m_nextWorkTarget.data(), nextWorkDifficulty);
-                m_current.reset();
+                processSetDifficulty(jPrm.get((Json::Value::ArrayIndex)0, 1).asDouble());
             }
         } else if (_method == "mining.set_extranonce") {
             jPrm = responseObject.get("params", Json::Value::null);
@@ -964,6 +950,74 @@ void StratumClient::processResponse(Json::Value& responseObject)
     }
 }
 
+void StratumClient::processNotify(const energi::StratumJob& job)
+{
+    bool resetJob = !job.clean;
+
+    auto work = energi::Work(job, m_extraNonce);
+    if (resetJob || m_current != work) {
+        if (resetJob && m_onResetWork) {
+            m_onResetWork();
+        }
+        m_current = std::move(work);
+        m_current.setTarget(m_nextWorkTarget);
+        m_current.exSizeBits = m_extraNonceHexSize * 4;
+        m_current_timestamp = std::chrono::steady_clock::now();
+        if (m_onWorkReceived) {
+            m_onWorkReceived(m_current);
+        }
+    }
+}
+
+void StratumClient::processSetDifficulty(double difficulty)
+{
+    double nextWorkDifficulty = std::max(difficulty, 0.0001);
+    cnote << "Difficulty set to: "  << nextWorkDifficulty;
+    m_nextWorkTarget = StratumParser::difficultyToTarget(nextWorkDifficulty);
+    m_current.reset();
+}
+
+void StratumClient::processSubmitResponse(bool success, const std::string& errReason)
+{
+    auto response_delay_ms = dequeue_response_plea();
+    auto find_to_ack_ms = untrackSolution();
+    if (success) {
+        if (m_onSolutionAccepted) {
+            m_onSolutionAccepted(false, response_delay_ms, find_to_ack_ms);
+        }
+    } else {
+        if (m_onSolutionRejected) {
+            if (!errReason.empty()) {
+                cwarn << "Reject reason: " << errReason;
+            }
+            m_onSolutionRejected(true, response_delay_ms, find_to_ack_ms);
+        }
+    }
+}
+
+// Messages parsed by StratumParser, everything else goes to processResponse
+void StratumClient::processMessage(const StratumMessage& message)
+{
+    setThreadName("stratum");
+    switch (message.kind) {
+    case StratumMessage::Kind::Notify:
+        if (m_conn->StratumModeConfirmed()) {
+            processNotify(message.job);
+        }
+        break;
+    case StratumMessage::Kind::SetDifficulty:
+        if (m_conn->StratumModeConfirmed()) {
+            processSetDifficulty(message.difficulty);
+        }
+        break;
+    case StratumMessage::Kind::SubmitResponse:
+        processSubmitResponse(message.result, std::string());
+        break;
+    default:
+        break;
+    }
+}
+
 void StratumClient::submitHashrate(const std::string& rate)
 {
     if(rate.empty()) {
@@ -988,24 +1042,62 @@ void StratumClient::submitSolution(const Solution& solution)
         return;
     }
 
-    Json::Value jReq;
-    jReq["id"] = unsigned(4);
-    jReq["method"] = "mining.submit";
-    jReq["params"] = Json::Value(Json::arrayValue);
-
-    jReq["jsonrpc"] = "2.0";
-    jReq["params"].append(m_conn->User());
-    jReq["params"].append(solution.getJobName());
-    jReq["params"].append(solution.getExtraNonce());
-    jReq["params"].append(solution.getTime());
-    jReq["params"].append(std::to_string(solution.getNonce()));
-    jReq["params"].append(solution.getHashMix().GetHex());
-    jReq["params"].append(solution.getBlockTransaction());
-    if (m_worker.length()) {
-        jReq["worker"] = m_worker;
+    // Same line as a mining.submit request written by Json::FastWriter
+    OutgoingLine line;
+    line.head = submitHead(solution.getJobName());
+    {
+        std::lock_guard<std::mutex> lock(x_send);
+        line.tail = m_submitTail;
+    }
+    if (!line.tail) {
+        return;
     }
+    line.body = acquireSendBuffer();
+    formatSubmit(solution, *line.body);
+    line.share = true;
+    line.found = solution.getFoundTime();
+    trackSolution(solution);
     enqueue_response_plea();
-    sendSocketData(jReq);
+    sendLine(std::move(line));
+}
+
+std::shared_ptr<const std::string> StratumClient::submitHead(const std::string& jobName)
+{
+    std::lock_guard<std::mutex> lock(x_send);
+    if (!m_submitHead || m_submitJob != jobName) {
+        std::string head = "{\"id\":4,\"jsonrpc\":\"2.0\",\"method\":\"mining.submit\",\"params\":[";
+        head += Json::valueToQuotedString(m_conn->User().c_str());
+        head += ',';
+        head += Json::valueToQuotedString(jobName.c_str());
+        head += ",\"";
+        m_submitHead = std::make_shared<const std::string>(std::move(head));
+        m_submitJob = jobName;
+    }
+    return m_submitHead;
+}
+
+void StratumClient::formatSubmit(const Solution& solution, std::string& body) const
+{
+    body.assign(c_submitFixed, sizeof(c_submitFixed) - 1);
+    writeHex32(&body[0], solution.getExtraNonceValue());
+    writeHex32(&body[c_submitTimeOffset], solution.getWork().nTime);
+
+    char digits[20];
+    char* const end = digits + sizeof(digits);
+    char* begin = end;
+    uint64_t nonce = solution.getNonce();
+    do {
+        *--begin = static_cast<char>('0' + nonce % 10);
+        nonce /= 10;
+    } while (nonce);
+    body.append(begin, end);
+    body.append("\",\"");
+
+    const size_t mix = body.size();
+    body.resize(mix + 64);
+    solution.getHashMix().GetHex(&body[mix]);
+    body.append("\",\"");
+    solution.getWork().appendBlockTransaction(body);
 }
 
 void StratumClient::recvSocketData()
@@ -1027,22 +1119,32 @@ void StratumClient::onRecvSocketDataCompleted(const boost::system::error_code& e
     // before triggering all stack of calls
     setThreadName("stratum");
     if (!ec && bytes_transferred > 0) {
-        // Extract received message
-        std::istream is(&m_recvBuffer);
-        std::string message;
-        getline(is, message);
-        if (isConnected()) {
-            if (!message.empty()) {
-                // Test validity of chunk and process
-                Json::Value jMsg;
-                Json::Reader jRdr;
-                if (jRdr.parse(message, jMsg)) {
-                    m_io_service.post(boost::bind(&StratumClient::processResponse, this, jMsg));
-                } else {
-                    if (g_logVerbosity >= 6)
-                        cwarn << "Got invalid Json message: " + jRdr.getFormattedErrorMessages();
-                }
+        // Process every complete line in place, a partial one stays for the next read
+        StratumLineFramer framer(m_recvBuffer);
+        const char* begin;
+        const char* end;
+        while (framer.next(begin, end)) {
+            if (!isConnected() || begin == end) {
+                continue;
             }
+            if (SessionRecorder::active()) {
+                SessionRecorder::record(SessionRecorder::Direction::Inbound, begin, end);
+            }
+            if (StratumParser::parse(begin, end, m_recvMessage)) {
+                processMessage(m_recvMessage);
+                continue;
+            }
+            // Test validity of chunk and process
+            Json::Value jMsg;
+            if (m_jRdr.parse(begin, end, jMsg)) {
+                processResponse(jMsg);
+            } else {
+                if (g_logVerbosity >= 6)
+                    cwarn << "Got invalid Json message: " + m_jRdr.getFormattedErrorMessages();
+            }
+        }
+        framer.consume();
+        if (isConnected()) {
             // Eventually keep reading from socket
             recvSocketData();
         }
@@ -1069,34 +1171,147 @@ void StratumClient::onRecvSocketDataCompleted(const boost::system::error_code& e
 }
 
 void StratumClient::sendSocketData(Json::Value const & jReq)
+{
+    OutgoingLine line;
+    line.body = acquireSendBuffer();
+    line.body->assign(m_jWriter.write(jReq));	// Do not add lf. It's added by writer.
+    sendLine(std::move(line));
+}
+
+// Callable from any thread, the write itself is started on the strand
+void StratumClient::sendLine(OutgoingLine&& line)
 {
     if (!isConnected()) {
+        releaseSendBuffer(std::move(line.body));
+        return;
+    }
+    if (SessionRecorder::active()) {
+        std::string text;
+        text.reserve((line.head ? line.head->size() : 0) + line.body->size() + (line.tail ? line.tail->size() : 0));
+        if (line.head) {
+            text += *line.head;
+        }
+        text += *line.body;
+        if (line.tail) {
+            text += *line.tail;
+        }
+        SessionRecorder::record(SessionRecorder::Direction::Outbound, text.data(), text.data() + text.size());
+    }
+    bool start = false;
+    {
+        std::lock_guard<std::mutex> lock(x_send);
+        m_sendQueue.push_back(std::move(line));
+        start = !m_writing;
+        m_writing = true;
+    }
+    if (start) {
+        m_io_service.post(m_io_strand.wrap(boost::bind(&StratumClient::writeQueuedLines, this)));
+    }
+}
+
+void StratumClient::writeQueuedLines()
+{
+    {
+        std::lock_guard<std::mutex> lock(x_send);
+        if (m_sendQueue.empty()) {
+            m_writing = false;
+            return;
+        }
+        // Everything queued goes out with a single gathered write
+        while (!m_sendQueue.empty()) {
+            m_sending.push_back(std::move(m_sendQueue.front()));
+            m_sendQueue.pop_front();
+        }
+    }
+    m_sendBuffers.clear();
+    for (const auto& line : m_sending) {
+        if (line.head) {
+            m_sendBuffers.push_back(boost::asio::buffer(*line.head));
+        }
+        m_sendBuffers.push_back(boost::asio::buffer(*line.body));
+        if (line.tail) {
+            m_sendBuffers.push_back(boost::asio::buffer(*line.tail));
+        }
+    }
+    if (!isConnected() || !m_socket) {
+        onSendSocketDataCompleted(boost::asio::error::not_connected);
         return;
     }
-    std::ostream os(&m_sendBuffer);
-    os << m_jWriter.write(jReq);		// Do not add lf. It's added by writer.
     if (m_conn->SecLevel() != SecureLevel::NONE) {
-        async_write(*m_securesocket, m_sendBuffer,
+        async_write(*m_securesocket, m_sendBuffers,
                 m_io_strand.wrap(boost::bind(&StratumClient::onSendSocketDataCompleted, this, boost::asio::placeholders::error)));
     } else {
-        async_write(*m_nonsecuresocket, m_sendBuffer,
+        async_write(*m_nonsecuresocket, m_sendBuffers,
                 m_io_strand.wrap(boost::bind(&StratumClient::onSendSocketDataCompleted, this, boost::asio::placeholders::error)));
     }
 }
 
 void StratumClient::onSendSocketDataCompleted(const boost::system::error_code& ec)
 {
+    const auto sent = std::chrono::steady_clock::now();
+    for (auto& line : m_sending) {
+        if (!ec && line.share && m_onSolutionSent) {
+            m_onSolutionSent(std::chrono::duration_cast<std::chrono::microseconds>(sent - line.found));
+        }
+        releaseSendBuffer(std::move(line.body));
+    }
+    m_sending.clear();
+
     if (ec) {
+        // Whatever is queued would fail the same way
+        clearSendQueue();
         if ((ec.category() == boost::asio::error::get_ssl_category()) && (SSL_R_PROTOCOL_IS_SHUTDOWN == ERR_GET_REASON(ec.value()))) {
             cnote << "SSL Stream error: " << ec.message();
-            m_io_strand.wrap(boost::bind(&StratumClient::disconnect, this));
-        }
-        if (isConnected()) {
+            m_io_service.post(m_io_strand.wrap(boost::bind(&StratumClient::disconnect, this)));
+        } else if (isConnected()) {
             setThreadName("stratum");
             cwarn << "Socket write failed: " + ec.message();
-            m_io_strand.wrap(boost::bind(&StratumClient::disconnect, this));
+            m_io_service.post(m_io_strand.wrap(boost::bind(&StratumClient::disconnect, this)));
+        }
+        return;
+    }
+    writeQueuedLines();
+}
+
+void StratumClient::clearSendQueue()
+{
+    std::lock_guard<std::mutex> lock(x_send);
+    for (auto& line : m_sendQueue) {
+        if (m_sendPool.size() < c_sendPoolSize) {
+            line.body->clear();
+            m_sendPool.push_back(std::move(line.body));
         }
     }
+    m_sendQueue.clear();
+    // A write still in flight finds the queue empty and ends
+    m_writing = !m_sending.empty();
+}
+
+std::unique_ptr<std::string> StratumClient::acquireSendBuffer()
+{
+    {
+        std::lock_guard<std::mutex> lock(x_send);
+        if (!m_sendPool.empty()) {
+            std::unique_ptr<std::string> buffer = std::move(m_sendPool.back());
+            m_sendPool.pop_back();
+            return buffer;
+        }
+    }
+    std::unique_ptr<std::string> buffer(new std::string());
+    buffer->reserve(c_sendBufferCapacity);
+    return buffer;
+}
+
+void StratumClient::releaseSendBuffer(std::unique_ptr<std::string>&& buffer)
+{
+    if (!buffer) {
+        return;
+    }
+    buffer->clear();
+    std::lock_guard<std::mutex> lock(x_send);
+    if (m_sendPool.size() < c_sendPoolSize) {
+        m_sendPool.push_back(std::move(buffer));
+    }
 }
 void StratumClient::onSSLShutdownCompleted(const boost::system::error_code& ec)
 {
@@ -1144,4 +1359,5 @@ void StratumClient::clear_response_pleas()
     };
     m_response_plea_older.store(((steady_clock::time_point)steady_clock::now()).time_since_epoch(),
             std::memory_order_relaxed);
+    clearTrackedSolutions();
 }
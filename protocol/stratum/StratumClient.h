@@ -1,6 +1,10 @@
 #pragma once
 
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <boost/array.hpp>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
@@ -10,6 +14,7 @@
 #include <nrgcore/mineplant.h>
 #include <nrgcore/miner.h>
 #include "../PoolClient.h"
+#include "StratumParser.h"
 #include <boost/lockfree/queue.hpp>
 
 using namespace energi;
@@ -55,13 +60,38 @@ private:
     void workloop_timer_elapsed(const boost::system::error_code& ec);
 
     void processResponse(Json::Value& responseObject);
+    void processMessage(const StratumMessage& message);
+    void processNotify(const energi::StratumJob& job);
+    void processSetDifficulty(double difficulty);
+    void processSubmitResponse(bool success, const std::string& errReason);
     std::string processError(Json::Value& erroresponseObject);
     void processExtranonce(std::string& enonce);
 
     void recvSocketData();
     void onRecvSocketDataCompleted(const boost::system::error_code& ec, std::size_t bytes_transferred);
+    /**
+     * @brief A line to the pool, sent as head, body and tail by one gathered
+     *        write. Only the body is formatted per message, into a pooled
+     *        buffer, head and tail are preformatted and shared.
+     */
+    struct OutgoingLine
+    {
+        std::shared_ptr<const std::string>    head;
+        std::unique_ptr<std::string>          body;
+        std::shared_ptr<const std::string>    tail;
+        bool                                  share = false;
+        std::chrono::steady_clock::time_point found;   // of a share, for the find to wire time
+    };
+
     void sendSocketData(Json::Value const & jReq);
+    void sendLine(OutgoingLine&& line);
+    void writeQueuedLines();
     void onSendSocketDataCompleted(const boost::system::error_code& ec);
+    void clearSendQueue();
+    std::unique_ptr<std::string> acquireSendBuffer();
+    void releaseSendBuffer(std::unique_ptr<std::string>&& buffer);
+    std::shared_ptr<const std::string> submitHead(const std::string& jobName);
+    void formatSubmit(const energi::Solution& solution, std::string& body) const;
 
     void onSSLShutdownCompleted(const boost::system::error_code& ec);
 
@@ -95,9 +125,23 @@ private:
     std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>  m_securesocket;
     std::shared_ptr<boost::asio::ip::tcp::socket> m_nonsecuresocket;
 
-    boost::asio::streambuf m_sendBuffer;
+    // Lines wait here while a write is in flight and go out together with the next one
+    static const size_t c_sendPoolSize = 16;
+    static const size_t c_sendBufferCapacity = 1024;
+    std::mutex x_send;
+    std::vector<std::unique_ptr<std::string>> m_sendPool;
+    std::deque<OutgoingLine> m_sendQueue;
+    std::vector<OutgoingLine> m_sending;            // lines of the write in flight, strand only
+    std::vector<boost::asio::const_buffer> m_sendBuffers;
+    bool m_writing = false;                         // a write is posted or in flight
+    std::string m_submitJob;                        // job of m_submitHead
+    std::shared_ptr<const std::string> m_submitHead;
+    std::shared_ptr<const std::string> m_submitTail;
+
     boost::asio::streambuf m_recvBuffer;
     Json::FastWriter m_jWriter;
+    Json::Reader m_jRdr;
+    StratumMessage m_recvMessage;  // reused so job strings keep their capacity
 
     boost::asio::deadline_timer m_workloop_timer;
 
@@ -0,0 +1,530 @@
+#include "StratumParser.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+const unsigned c_maxDepth = 32;
+
+struct Span
+{
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    bool empty() const { return begin == nullptr; }
+};
+
+bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+//! -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+bool isJsonNumber(const char* p)
+{
+    if (*p == '-') {
+        ++p;
+    }
+    if (*p == '0') {
+        ++p;
+    } else if (isDigit(*p)) {
+        while (isDigit(*p)) {
+            ++p;
+        }
+    } else {
+        return false;
+    }
+    if (*p == '.') {
+        if (!isDigit(*++p)) {
+            return false;
+        }
+        while (isDigit(*p)) {
+            ++p;
+        }
+    }
+    if (*p == 'e' || *p == 'E') {
+        ++p;
+        if (*p == '+' || *p == '-') {
+            ++p;
+        }
+        if (!isDigit(*p)) {
+            return false;
+        }
+        while (isDigit(*p)) {
+            ++p;
+        }
+    }
+    return *p == 0;
+}
+
+class Scanner
+{
+public:
+    Scanner(const char* begin, const char* end)
+        : m_p(begin)
+        , m_end(end)
+    {}
+
+    bool atEnd()
+    {
+        skipWs();
+        return m_p == m_end;
+    }
+
+    bool expect(char c)
+    {
+        skipWs();
+        if (m_p == m_end || *m_p != c) {
+            return false;
+        }
+        ++m_p;
+        return true;
+    }
+
+    bool peek(char c)
+    {
+        skipWs();
+        return m_p != m_end && *m_p == c;
+    }
+
+    bool string(std::string& out)
+    {
+        skipWs();
+        if (m_p == m_end || *m_p != '"') {
+            return false;
+        }
+        ++m_p;
+        out.clear();
+        const char* run = m_p;
+        while (m_p != m_end) {
+            char c = *m_p;
+            if (c == '"') {
+                out.append(run, m_p);
+                ++m_p;
+                return true;
+            }
+            if (c != '\\') {
+                ++m_p;
+                continue;
+            }
+            out.append(run, m_p);
+            if (++m_p == m_end) {
+                return false;
+            }
+            switch (*m_p) {
+            case '"':  out.push_back('"');  break;
+            case '\\': out.push_back('\\'); break;
+            case '/':  out.push_back('/');  break;
+            case 'b':  out.push_back('\b'); break;
+            case 'f':  out.push_back('\f'); break;
+            case 'n':  out.push_back('\n'); break;
+            case 'r':  out.push_back('\r'); break;
+            case 't':  out.push_back('\t'); break;
+            case 'u':
+                // Pools only send hex and ascii, no need to transcode
+                if (m_end - m_p < 5) {
+                    return false;
+                }
+                m_p += 4;
+                out.push_back('?');
+                break;
+            default:
+                return false;
+            }
+            run = ++m_p;
+        }
+        return false;
+    }
+
+    //! Compares the next string with key without unescaping it
+    bool key(const char*& begin, const char*& end)
+    {
+        skipWs();
+        if (m_p == m_end || *m_p != '"') {
+            return false;
+        }
+        begin = ++m_p;
+        while (m_p != m_end && *m_p != '"') {
+            if (*m_p == '\\') {
+                return false;
+            }
+            ++m_p;
+        }
+        if (m_p == m_end) {
+            return false;
+        }
+        end = m_p++;
+        return expect(':');
+    }
+
+    bool number(double& value)
+    {
+        skipWs();
+        char buf[64];
+        size_t n = 0;
+        while (m_p != m_end && n < sizeof(buf) - 1 &&
+               (std::strchr("+-.eE", *m_p) || (*m_p >= '0' && *m_p <= '9'))) {
+            buf[n++] = *m_p++;
+        }
+        if (!n) {
+            return false;
+        }
+        buf[n] = 0;
+        // strtod also takes forms JSON does not, like ".5", "+1", "01" or "1."
+        if (!isJsonNumber(buf)) {
+            return false;
+        }
+        char* parsed = nullptr;
+        value = std::strtod(buf, &parsed);
+        return parsed == buf + n;
+    }
+
+    bool boolean(bool& value)
+    {
+        skipWs();
+        if (literal("true")) {
+            value = true;
+            return true;
+        }
+        if (literal("false")) {
+            value = false;
+            return true;
+        }
+        return false;
+    }
+
+    bool null()
+    {
+        skipWs();
+        return literal("null");
+    }
+
+    bool value(Span& span, unsigned depth = 0)
+    {
+        skipWs();
+        span.begin = m_p;
+        if (!skip(depth)) {
+            return false;
+        }
+        span.end = m_p;
+        return true;
+    }
+
+private:
+    bool skip(unsigned depth)
+    {
+        if (depth > c_maxDepth || m_p == m_end) {
+            return false;
+        }
+        std::string ignored;
+        double number_;
+        switch (*m_p) {
+        case '"':
+            return string(ignored);
+        case '{':
+            ++m_p;
+            if (expect('}')) {
+                return true;
+            }
+            do {
+                if (!string(ignored) || !expect(':')) {
+                    return false;
+                }
+                skipWs();
+                if (!skip(depth + 1)) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect('}');
+        case '[':
+            ++m_p;
+            if (expect(']')) {
+                return true;
+            }
+            do {
+                skipWs();
+                if (!skip(depth + 1)) {
+                    return false;
+                }
+            } while (expect(','));
+            return expect(']');
+        case 't':
+            return literal("true");
+        case 'f':
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+            return number(number_);
+        }
+    }
+
+    bool literal(const char* word)
+    {
+        size_t len = std::strlen(word);
+        if (static_cast<size_t>(m_end - m_p) < len || std::memcmp(m_p, word, len) != 0) {
+            return false;
+        }
+        m_p += len;
+        return true;
+    }
+
+    void skipWs()
+    {
+        while (m_p != m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\r' || *m_p == '\n')) {
+            ++m_p;
+        }
+    }
+
+    const char* m_p;
+    const char* m_end;
+};
+
+bool keyIs(const char* begin, const char* end, const char* key)
+{
+    size_t len = std::strlen(key);
+    return static_cast<size_t>(end - begin) == len && std::memcmp(begin, key, len) == 0;
+}
+
+bool hex32(const std::string& str, uint32_t& value)
+{
+    if (str.empty() || str.size() > 8) {
+        return false;
+    }
+    char* parsed = nullptr;
+    value = static_cast<uint32_t>(std::strtoul(str.c_str(), &parsed, 16));
+    return *parsed == 0;
+}
+
+// [jobName, prevHash, coinbase1, coinbase2, [{"data": tx}, ...], version, bits, time, clean, height]
+bool parseNotify(const Span& params, energi::StratumJob& job)
+{
+    Scanner s(params.begin, params.end);
+    if (!s.expect('[')) {
+        return false;
+    }
+    std::string version, bits, time;
+    std::string* strings[] = { &job.jobName, &job.prevHash, &job.coinbase1, &job.coinbase2,
+                               nullptr, &version, &bits, &time };
+    for (unsigned i = 0; i < 8; ++i) {
+        if (i && !s.expect(',')) {
+            return false;
+        }
+        if (strings[i]) {
+            if (!s.string(*strings[i])) {
+                return false;
+            }
+            continue;
+        }
+        job.transactions.clear();
+        if (!s.expect('[')) {
+            return false;
+        }
+        if (s.expect(']')) {
+            continue;
+        }
+        do {
+            std::string data;
+            if (s.peek('"')) {
+                if (!s.string(data)) {
+                    return false;
+                }
+            } else {
+                if (!s.expect('{')) {
+                    return false;
+                }
+                if (!s.peek('}')) {
+                    do {
+                        const char *kb, *ke;
+                        if (!s.key(kb, ke)) {
+                            return false;
+                        }
+                        if (keyIs(kb, ke, "data")) {
+                            if (!s.string(data)) {
+                                return false;
+                            }
+                        } else {
+                            Span ignored;
+                            if (!s.value(ignored)) {
+                                return false;
+                            }
+                        }
+                    } while (s.expect(','));
+                }
+                if (!s.expect('}')) {
+                    return false;
+                }
+            }
+            job.transactions.push_back(std::move(data));
+        } while (s.expect(','));
+        if (!s.expect(']')) {
+            return false;
+        }
+    }
+    double height = 0;
+    if (!s.expect(',') || !s.boolean(job.clean) ||
+        !s.expect(',') || !s.number(height) || height < 0) {
+        return false;
+    }
+    job.height = static_cast<uint32_t>(height);
+    // extra trailing parameters are ignored as by the generic path
+    return hex32(version, job.version) && hex32(bits, job.bits) && hex32(time, job.time)
+           && !job.coinbase1.empty() && !job.coinbase2.empty();
+}
+
+} //! anonymous namespace
+
+StratumLineFramer::StratumLineFramer(boost::asio::streambuf& buffer)
+    : m_buffer(buffer)
+    , m_data(boost::asio::buffer_cast<const char*>(buffer.data()))
+    , m_size(buffer.size())
+{
+}
+
+bool StratumLineFramer::next(const char*& begin, const char*& end)
+{
+    if (m_offset >= m_size) {
+        return false;
+    }
+    const char* start = m_data + m_offset;
+    const char* lf = static_cast<const char*>(std::memchr(start, '\n', m_size - m_offset));
+    if (!lf) {
+        return false;
+    }
+    m_offset = lf - m_data + 1;
+    begin = start;
+    end = lf;
+    if (end != begin && *(end - 1) == '\r') {
+        --end;
+    }
+    return true;
+}
+
+void StratumLineFramer::consume()
+{
+    m_buffer.consume(m_offset);
+    m_data = boost::asio::buffer_cast<const char*>(m_buffer.data());
+    m_size = m_buffer.size();
+    m_offset = 0;
+}
+
+bool StratumParser::parse(const char* begin, const char* end, StratumMessage& message)
+{
+    message.kind = StratumMessage::Kind::Other;
+    Scanner s(begin, end);
+    if (!s.expect('{')) {
+        return false;
+    }
+    bool hasId = false;
+    double id = 0;
+    std::string method;
+    Span params, result, error;
+    if (!s.peek('}')) {
+        do {
+            const char *kb, *ke;
+            if (!s.key(kb, ke)) {
+                return false;
+            }
+            if (keyIs(kb, ke, "id")) {
+                if (s.null()) {
+                    id = 0;
+                } else if (!s.number(id) || id < 0) {
+                    return false;
+                }
+                hasId = true;
+            } else if (keyIs(kb, ke, "method")) {
+                if (!s.string(method)) {
+                    return false;
+                }
+            } else if (keyIs(kb, ke, "jsonrpc")) {
+                std::string version;
+                if (!s.string(version) || version != "2.0") {
+                    return false; // let the generic path complain
+                }
+            } else if (keyIs(kb, ke, "params")) {
+                if (!s.value(params)) {
+                    return false;
+                }
+            } else if (keyIs(kb, ke, "result")) {
+                if (!s.value(result)) {
+                    return false;
+                }
+            } else if (keyIs(kb, ke, "error")) {
+                if (!s.value(error)) {
+                    return false;
+                }
+            } else {
+                Span ignored;
+                if (!s.value(ignored)) {
+                    return false;
+                }
+            }
+        } while (s.expect(','));
+    }
+    if (!s.expect('}') || !s.atEnd()) {
+        return false;
+    }
+    message.id = hasId ? static_cast<unsigned>(id) : 0;
+
+    if (method == "mining.notify") {
+        if (params.empty() || !parseNotify(params, message.job)) {
+            return false;
+        }
+        message.kind = StratumMessage::Kind::Notify;
+        return true;
+    }
+    if (method == "mining.set_difficulty") {
+        Scanner p(params.begin, params.end);
+        if (params.empty() || !p.expect('[') || !p.number(message.difficulty)) {
+            return false;
+        }
+        message.kind = StratumMessage::Kind::SetDifficulty;
+        return true;
+    }
+    if (method.empty() && message.id == 4) {
+        // Errors carry a reason which the generic path knows how to print
+        if (!error.empty()) {
+            Scanner e(error.begin, error.end);
+            if (!e.null()) {
+                return false;
+            }
+        }
+        message.result = true;
+        if (!result.empty()) {
+            Scanner r(result.begin, result.end);
+            bool value = true;
+            if (r.boolean(value)) {
+                message.result = value;
+            }
+        }
+        message.kind = StratumMessage::Kind::SubmitResponse;
+        return true;
+    }
+    return false;
+}
+
+arith_uint256 StratumParser::difficultyToTarget(double diff)
+{
+    uint32_t target[8];
+    uint64_t m;
+    int k;
+
+    for (k = 6; k > 0 && diff > 1.0; k--)
+        diff /= 4294967296.0;
+    m = (uint64_t)(4294901760.0 / diff);
+    if (m == 0 && k == 6)
+        memset(target, 0xff, 32);
+    else {
+        memset(target, 0, 32);
+        target[k] = (uint32_t)m;
+        target[k + 1] = (uint32_t)(m >> 32);
+    }
+
+    arith_uint256 result;
+    for (int i = 7; i >= 0; --i) {
+        result <<= 32;
+        result |= target[i];
+    }
+    return result;
+}
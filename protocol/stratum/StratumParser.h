@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <boost/asio/streambuf.hpp>
+#include <primitives/arith_uint256.h>
+#include <primitives/block.h>
+
+/**
+ * @brief Hands out complete lines of a streambuf without copying them.
+ *        Lines stay valid until consume() is called.
+ */
+class StratumLineFramer
+{
+public:
+    explicit StratumLineFramer(boost::asio::streambuf& buffer);
+
+    //! Next complete line without its terminator, false when only a partial line is left
+    bool next(const char*& begin, const char*& end);
+    //! Releases the lines handed out so far, a trailing partial line is kept
+    void consume();
+
+private:
+    boost::asio::streambuf& m_buffer;
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset = 0;
+};
+
+struct StratumMessage
+{
+    enum class Kind
+    {
+        Other,          // anything else, goes through the generic Json path
+        Notify,         // mining.notify
+        SetDifficulty,  // mining.set_difficulty
+        SubmitResponse  // error free response to mining.submit
+    };
+
+    Kind kind = Kind::Other;
+    unsigned id = 0;
+    bool result = false;
+    double difficulty = 0;
+    energi::StratumJob job;
+};
+
+/**
+ * @brief Parses the few messages seen on every job or share straight into
+ *        their fields. Anything it does not recognise, or that is not well
+ *        formed, is reported as Kind::Other and left to the Json::Reader path.
+ */
+class StratumParser
+{
+public:
+    static bool parse(const char* begin, const char* end, StratumMessage& message);
+
+    //! Share target of a mining.set_difficulty
+    static arith_uint256 difficultyToTarget(double difficulty);
+};
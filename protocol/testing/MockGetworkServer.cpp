@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <boost/bind.hpp>
+
+#include <common/Log.h>
+
+#include "MockGetworkServer.h"
+
+using boost::asio::ip::tcp;
+
+MockGetworkServer::MockGetworkServer(boost::asio::io_service& io_service, const Options& options,
+                                     const Json::Value& base)
+    : m_options(options)
+    , m_base(base)
+    , m_io_service(io_service)
+    , m_io_strand(io_service)
+    , m_acceptor(io_service)
+    , m_blockTimer(io_service)
+    , m_height(options.height)
+{
+}
+
+bool MockGetworkServer::start()
+{
+    boost::system::error_code ec;
+    const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), m_options.port);
+    m_acceptor.open(endpoint.protocol(), ec);
+    if (!ec) {
+        m_acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec) {
+        m_acceptor.bind(endpoint, ec);
+    }
+    if (!ec) {
+        m_acceptor.listen(boost::asio::socket_base::max_connections, ec);
+    }
+    if (!ec) {
+        m_port = m_acceptor.local_endpoint(ec).port();
+    }
+    if (ec) {
+        cwarn << "Mock node can't listen on 127.0.0.1:" << m_options.port << ": " << ec.message();
+        boost::system::error_code ignored;
+        m_acceptor.close(ignored);
+        return false;
+    }
+    m_up = true;
+    nextTemplate();
+    cnote << "Mock node listening on 127.0.0.1:" << m_port << ", " << m_options.latencyMs << " ms latency"
+          << (m_options.longpoll ? ", longpoll" : "")
+          << (m_options.blockSeconds ? ", a block every " + std::to_string(m_options.blockSeconds) + " s" : "");
+    m_io_service.post(m_io_strand.wrap([this]() {
+        accept();
+        if (m_options.blockSeconds) {
+            m_blockTimer.expires_from_now(boost::posix_time::seconds(m_options.blockSeconds));
+            m_blockTimer.async_wait(m_io_strand.wrap(boost::bind(&MockGetworkServer::onBlockTimer, this, boost::asio::placeholders::error)));
+        }
+    }));
+    return true;
+}
+
+void MockGetworkServer::stop()
+{
+    m_io_service.post(m_io_strand.wrap([this]() {
+        m_up = false;
+        boost::system::error_code ec;
+        m_acceptor.close(ec);
+        m_blockTimer.cancel();
+        m_held.clear();
+        auto peers = m_peers;
+        for (auto& peer : peers) {
+            drop(peer);
+        }
+    }));
+}
+
+void MockGetworkServer::newBlock()
+{
+    m_io_service.post(m_io_strand.wrap([this]() { announce(); }));
+}
+
+void MockGetworkServer::accept()
+{
+    auto peer = std::make_shared<Peer>(m_io_service);
+    m_acceptor.async_accept(peer->socket,
+            m_io_strand.wrap(boost::bind(&MockGetworkServer::onAccept, this, peer, boost::asio::placeholders::error)));
+}
+
+void MockGetworkServer::onAccept(PeerPtr peer, const boost::system::error_code& ec)
+{
+    if (ec || !m_up) {
+        return;
+    }
+    boost::system::error_code ignored;
+    peer->socket.set_option(tcp::no_delay(true), ignored);
+    m_peers.insert(peer);
+    read(peer);
+    accept();
+}
+
+void MockGetworkServer::read(PeerPtr peer)
+{
+    boost::asio::async_read_until(peer->socket, peer->buffer, "\r\n\r\n",
+            m_io_strand.wrap(boost::bind(&MockGetworkServer::onHeaders, this, peer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+}
+
+void MockGetworkServer::onHeaders(PeerPtr peer, const boost::system::error_code& ec, std::size_t bytes)
+{
+    if (ec) {
+        drop(peer);
+        return;
+    }
+    std::string headers(boost::asio::buffers_begin(peer->buffer.data()),
+                        boost::asio::buffers_begin(peer->buffer.data()) + bytes);
+    peer->buffer.consume(bytes);
+    std::transform(headers.begin(), headers.end(), headers.begin(), ::tolower);
+
+    // The client always sends a body with its POST
+    const std::string field = "\r\ncontent-length:";
+    const size_t pos = headers.find(field);
+    const size_t length = pos == std::string::npos ? 0 : std::strtoul(headers.c_str() + pos + field.size(), nullptr, 10);
+    if (!length || length > (1u << 20)) {
+        cwarn << "Mock node got a request without a usable body, dropping the client";
+        drop(peer);
+        return;
+    }
+    if (peer->buffer.size() >= length) {
+        onBody(peer, boost::system::error_code(), length);
+        return;
+    }
+    boost::asio::async_read(peer->socket, peer->buffer, boost::asio::transfer_exactly(length - peer->buffer.size()),
+            m_io_strand.wrap(boost::bind(&MockGetworkServer::onBody, this, peer, boost::asio::placeholders::error, length)));
+}
+
+void MockGetworkServer::onBody(PeerPtr peer, const boost::system::error_code& ec, std::size_t length)
+{
+    if (ec) {
+        drop(peer);
+        return;
+    }
+    std::string body(boost::asio::buffers_begin(peer->buffer.data()),
+                     boost::asio::buffers_begin(peer->buffer.data()) + length);
+    peer->buffer.consume(length);
+
+    Json::Value request;
+    Json::Reader reader;
+    if (!reader.parse(body, request, false) || !request.isObject()) {
+        cwarn << "Mock node got a malformed request, dropping the client";
+        drop(peer);
+        return;
+    }
+    handle(peer, request);
+}
+
+void MockGetworkServer::handle(PeerPtr peer, const Json::Value& request)
+{
+    const Json::Value id = request.get("id", Json::Value::null);
+    const std::string method = request.get("method", "").asString();
+
+    if (method == "getblocktemplate") {
+        const Json::Value& params = request.get("params", Json::Value::null);
+        const Json::Value& query = params.isArray() ? params.get((Json::Value::ArrayIndex)0, Json::Value::null) : params;
+        const std::string longpollid = query.isObject() ? query.get("longpollid", "").asString() : std::string();
+        if (m_options.longpoll && !longpollid.empty() && longpollid == m_template["longpollid"].asString()) {
+            // Answered by the next block
+            peer->heldId = id;
+            m_held.push_back(peer);
+            return;
+        }
+        respond(peer, reply(id, m_template, Json::Value::null));
+    } else if (method == "submitblock") {
+        // null is an accepted block
+        respond(peer, reply(id, Json::Value::null, Json::Value::null));
+    } else {
+        Json::Value error;
+        error["code"] = -32601;
+        error["message"] = "Method not found";
+        respond(peer, reply(id, Json::Value::null, error));
+    }
+}
+
+std::string MockGetworkServer::reply(const Json::Value& id, const Json::Value& result, const Json::Value& error)
+{
+    Json::Value message;
+    message["id"] = id;
+    message["result"] = result;
+    message["error"] = error;
+    Json::FastWriter writer;
+    return writer.write(message);
+}
+
+void MockGetworkServer::respond(PeerPtr peer, const std::string& body)
+{
+    auto response = std::make_shared<std::string>(
+        "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: " + std::to_string(body.size())
+        + "\r\nConnection: keep-alive\r\n\r\n" + body);
+    auto send = [this, peer, response]() {
+        if (!peer->socket.is_open()) {
+            return;
+        }
+        boost::asio::async_write(peer->socket, boost::asio::buffer(*response),
+                m_io_strand.wrap([this, peer, response](const boost::system::error_code& ec, std::size_t) {
+                    if (ec) {
+                        drop(peer);
+                        return;
+                    }
+                    read(peer);
+                }));
+    };
+    if (!m_options.latencyMs) {
+        send();
+        return;
+    }
+    auto timer = std::make_shared<boost::asio::deadline_timer>(m_io_service, boost::posix_time::milliseconds(m_options.latencyMs));
+    timer->async_wait(m_io_strand.wrap([timer, send](const boost::system::error_code& ec) {
+        if (!ec) {
+            send();
+        }
+    }));
+}
+
+void MockGetworkServer::drop(PeerPtr peer)
+{
+    boost::system::error_code ec;
+    peer->socket.shutdown(tcp::socket::shutdown_both, ec);
+    peer->socket.close(ec);
+    m_held.erase(std::remove(m_held.begin(), m_held.end(), peer), m_held.end());
+    m_peers.erase(peer);
+}
+
+void MockGetworkServer::announce()
+{
+    if (!m_up) {
+        return;
+    }
+    ++m_height;
+    nextTemplate();
+    std::vector<PeerPtr> held;
+    held.swap(m_held);
+    for (auto& peer : held) {
+        respond(peer, reply(peer->heldId, m_template, Json::Value::null));
+    }
+}
+
+void MockGetworkServer::nextTemplate()
+{
+    m_template = m_base.isObject() ? m_base : Json::Value(Json::objectValue);
+    if (!m_template.isMember("transactions")) {
+        m_template["transactions"] = Json::Value(Json::arrayValue);
+    }
+    if (!m_template.isMember("version")) {
+        m_template["version"] = 0x20000000;
+    }
+    if (!m_template.isMember("bits")) {
+        m_template["bits"] = "1e0ffff0";
+    }
+    // Only the chain tip moves, which is enough for the client to take it as a new block
+    std::stringstream prevHash;
+    prevHash << std::setw(64) << std::setfill('0') << std::hex << m_height;
+    m_template["previousblockhash"] = prevHash.str();
+    m_template["height"] = m_height;
+    m_template["curtime"] = static_cast<Json::UInt>(std::time(nullptr));
+    if (m_options.longpoll) {
+        m_template["longpollid"] = prevHash.str() + std::to_string(m_height);
+    } else {
+        m_template.removeMember("longpollid");
+    }
+}
+
+void MockGetworkServer::onBlockTimer(const boost::system::error_code& ec)
+{
+    if (ec || !m_up) {
+        return;
+    }
+    announce();
+    m_blockTimer.expires_from_now(boost::posix_time::seconds(m_options.blockSeconds));
+    m_blockTimer.async_wait(m_io_strand.wrap(boost::bind(&MockGetworkServer::onBlockTimer, this, boost::asio::placeholders::error)));
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <json/json.h>
+
+/**
+ * @brief Node stand-in on a loopback port answering getblocktemplate and
+ *        submitblock over HTTP JSON-RPC, so the getwork client's path from a
+ *        new block to fresh work can be timed on one machine. A request
+ *        carrying the current longpollid is held until the next block, every
+ *        other request is answered after a fixed latency. Blocks come from
+ *        newBlock(), or from a timer when blockSeconds is set.
+ */
+class MockGetworkServer
+{
+public:
+    struct Options
+    {
+        unsigned short port = 0;        // 0 picks a free port, see port()
+        unsigned latencyMs = 0;
+        unsigned blockSeconds = 0;      // 0 leaves the blocks to newBlock()
+        bool     longpoll = true;       // false leaves the client to its fallback poll
+        uint32_t height = 1;
+    };
+
+    //! base is the getblocktemplate result every template is made from, a template without transactions if null
+    MockGetworkServer(boost::asio::io_service& io_service, const Options& options,
+                      const Json::Value& base = Json::Value());
+    MockGetworkServer(MockGetworkServer const&) = delete;
+    MockGetworkServer& operator=(MockGetworkServer const&) = delete;
+
+    //! Listens on 127.0.0.1, false if the port is taken
+    bool start();
+    void stop();
+    //! Port listened on once started
+    unsigned short port() const { return m_port; }
+
+    //! Moves the chain on by one block, held longpolls get the new template at once
+    void newBlock();
+
+private:
+    struct Peer
+    {
+        explicit Peer(boost::asio::io_service& io_service) : socket(io_service) {}
+
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::streambuf       buffer;
+        Json::Value                  heldId;    // id of the held longpoll
+    };
+    using PeerPtr = std::shared_ptr<Peer>;
+
+    void accept();
+    void onAccept(PeerPtr peer, const boost::system::error_code& ec);
+    void read(PeerPtr peer);
+    void onHeaders(PeerPtr peer, const boost::system::error_code& ec, std::size_t bytes);
+    void onBody(PeerPtr peer, const boost::system::error_code& ec, std::size_t length);
+    void handle(PeerPtr peer, const Json::Value& request);
+    //! Sends the body as an HTTP response after the configured latency, then reads the next request
+    void respond(PeerPtr peer, const std::string& body);
+    void drop(PeerPtr peer);
+
+    void announce();
+    void nextTemplate();
+    void onBlockTimer(const boost::system::error_code& ec);
+
+    static std::string reply(const Json::Value& id, const Json::Value& result, const Json::Value& error);
+
+    const Options m_options;
+    const Json::Value m_base;
+    boost::asio::io_service& m_io_service;
+    boost::asio::io_service::strand m_io_strand;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    boost::asio::deadline_timer m_blockTimer;
+    unsigned short m_port = 0;
+
+    std::set<PeerPtr> m_peers;
+    std::vector<PeerPtr> m_held;        // longpolls waiting for the next block
+    bool m_up = false;
+    uint32_t m_height;
+    Json::Value m_template;             // current getblocktemplate result
+};
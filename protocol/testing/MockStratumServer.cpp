@@ -0,0 +1,349 @@
+#include <cstdio>
+#include <ctime>
+#include <iomanip>
+#include <sstream>
+#include <boost/bind.hpp>
+
+#include <common/Log.h>
+
+#include "MockStratumServer.h"
+
+using boost::asio::ip::tcp;
+
+const unsigned MockStratumServer::c_jobSeconds;
+
+namespace {
+
+//! value as little endian hex of bytes bytes
+std::string hexLE(uint64_t value, unsigned bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned i = 0; i < bytes; ++i, value >>= 8) {
+        hex += digits[(value >> 4) & 0xf];
+        hex += digits[value & 0xf];
+    }
+    return hex;
+}
+
+std::string hex32(uint32_t value)
+{
+    char hex[9];
+    std::snprintf(hex, sizeof(hex), "%08x", value);
+    return hex;
+}
+
+} //! anonymous namespace
+
+MockStratumServer::MockStratumServer(boost::asio::io_service& io_service, const Options& options)
+    : m_options(options)
+    , m_io_service(io_service)
+    , m_io_strand(io_service)
+    , m_acceptor(io_service)
+    , m_jobTimer(io_service)
+    , m_outageTimer(io_service)
+{
+}
+
+bool MockStratumServer::start()
+{
+    if (!listen()) {
+        return false;
+    }
+    cnote << "Mock pool listening on 127.0.0.1:" << m_port << ", " << m_options.latencyMs << " ms latency, "
+          << m_options.rejectPercent << "% rejected"
+          << (m_options.outageSeconds ? ", down every other " + std::to_string(m_options.outageSeconds) + " s" : "");
+    m_io_service.post(m_io_strand.wrap([this]() {
+        newJob();
+        accept();
+        if (m_options.outageSeconds) {
+            m_outageTimer.expires_from_now(boost::posix_time::seconds(m_options.outageSeconds));
+            m_outageTimer.async_wait(m_io_strand.wrap(boost::bind(&MockStratumServer::onOutageTimer, this, boost::asio::placeholders::error)));
+        }
+    }));
+    return true;
+}
+
+void MockStratumServer::stop()
+{
+    m_io_service.post(m_io_strand.wrap([this]() {
+        m_up = false;
+        boost::system::error_code ec;
+        m_acceptor.close(ec);
+        m_jobTimer.cancel();
+        m_outageTimer.cancel();
+        auto peers = m_peers;
+        for (auto& peer : peers) {
+            drop(peer);
+        }
+    }));
+}
+
+bool MockStratumServer::listen()
+{
+    boost::system::error_code ec;
+    // The port picked for a 0 is kept across outages
+    const tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), m_port ? m_port : m_options.port);
+    m_acceptor.open(endpoint.protocol(), ec);
+    if (!ec) {
+        m_acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+    }
+    if (!ec) {
+        m_acceptor.bind(endpoint, ec);
+    }
+    if (!ec) {
+        m_acceptor.listen(boost::asio::socket_base::max_connections, ec);
+    }
+    if (!ec) {
+        m_port = m_acceptor.local_endpoint(ec).port();
+    }
+    if (ec) {
+        cwarn << "Mock pool can't listen on 127.0.0.1:" << (m_port ? m_port : m_options.port) << ": " << ec.message();
+        boost::system::error_code ignored;
+        m_acceptor.close(ignored);
+        return false;
+    }
+    m_up = true;
+    return true;
+}
+
+void MockStratumServer::accept()
+{
+    auto peer = std::make_shared<Peer>(m_io_service);
+    m_acceptor.async_accept(peer->socket,
+            m_io_strand.wrap(boost::bind(&MockStratumServer::onAccept, this, peer, boost::asio::placeholders::error)));
+}
+
+void MockStratumServer::onAccept(PeerPtr peer, const boost::system::error_code& ec)
+{
+    if (ec || !m_up) {
+        // The acceptor was closed for an outage or on stop
+        return;
+    }
+    peer->extranonce = hex32(++m_nextExtranonce);
+    m_peers.insert(peer);
+    read(peer);
+    accept();
+}
+
+void MockStratumServer::read(PeerPtr peer)
+{
+    boost::asio::async_read_until(peer->socket, peer->buffer, "\n",
+            m_io_strand.wrap(boost::bind(&MockStratumServer::onRead, this, peer, boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+}
+
+void MockStratumServer::onRead(PeerPtr peer, const boost::system::error_code& ec, std::size_t bytes)
+{
+    if (ec) {
+        drop(peer);
+        return;
+    }
+    std::string line(boost::asio::buffers_begin(peer->buffer.data()),
+                     boost::asio::buffers_begin(peer->buffer.data()) + bytes);
+    peer->buffer.consume(bytes);
+
+    Json::Value request;
+    Json::Reader reader;
+    if (!reader.parse(line, request, false) || !request.isObject()) {
+        cwarn << "Mock pool :" << m_port << " got a malformed line, dropping the miner";
+        drop(peer);
+        return;
+    }
+    handle(peer, request);
+    read(peer);
+}
+
+void MockStratumServer::handle(PeerPtr peer, const Json::Value& request)
+{
+    const Json::Value id = request.get("id", Json::Value::null);
+    const std::string method = request.get("method", "").asString();
+
+    if (method == "mining.subscribe") {
+        Json::Value subscription(Json::arrayValue);
+        subscription.append("mining.notify");
+        subscription.append(hex32(m_nextExtranonce) + hex32(m_port));
+        subscription.append("EnergiStratum/2.0.0");
+        Json::Value result(Json::arrayValue);
+        result.append(subscription);
+        result.append(peer->extranonce);
+        respond(peer, { reply(id, result, Json::Value::null) });
+    } else if (method == "mining.authorize") {
+        // The miner learns its difficulty and first job right after the authorization
+        peer->authorized = true;
+        std::vector<std::string> lines = { reply(id, true, Json::Value::null) };
+        for (auto& line : jobLines()) {
+            lines.push_back(line);
+        }
+        respond(peer, lines);
+    } else if (method == "mining.submit") {
+        m_rejectCredit += m_options.rejectPercent;
+        if (m_rejectCredit >= 100) {
+            m_rejectCredit -= 100;
+            Json::Value error(Json::arrayValue);
+            error.append(23);
+            error.append("Rejected by mock pool");
+            error.append(Json::Value::null);
+            respond(peer, { reply(id, Json::Value::null, error) });
+        } else {
+            respond(peer, { reply(id, true, Json::Value::null) });
+        }
+    } else if (method == "mining.extranonce.subscribe" || method == "eth_submitHashrate") {
+        respond(peer, { reply(id, true, Json::Value::null) });
+    } else if (!method.empty()) {
+        respond(peer, { reply(id, Json::Value::null, "Method not found") });
+    }
+}
+
+std::string MockStratumServer::reply(const Json::Value& id, const Json::Value& result, const Json::Value& error)
+{
+    Json::Value message;
+    message["id"] = id;
+    message["result"] = result;
+    message["error"] = error;
+    Json::FastWriter writer;
+    return writer.write(message);
+}
+
+void MockStratumServer::respond(PeerPtr peer, std::vector<std::string> lines)
+{
+    if (!m_options.latencyMs) {
+        for (auto& line : lines) {
+            send(peer, line);
+        }
+        return;
+    }
+    auto timer = std::make_shared<boost::asio::deadline_timer>(m_io_service, boost::posix_time::milliseconds(m_options.latencyMs));
+    timer->async_wait(m_io_strand.wrap([this, peer, timer, lines](const boost::system::error_code& ec) {
+        if (!ec) {
+            for (auto& line : lines) {
+                send(peer, line);
+            }
+        }
+    }));
+}
+
+void MockStratumServer::send(PeerPtr peer, const std::string& line)
+{
+    if (!peer->socket.is_open()) {
+        return;
+    }
+    peer->outbox.push_back(line);
+    if (peer->outbox.size() == 1) {
+        write(peer);
+    }
+}
+
+void MockStratumServer::write(PeerPtr peer)
+{
+    boost::asio::async_write(peer->socket, boost::asio::buffer(peer->outbox.front()),
+            m_io_strand.wrap(boost::bind(&MockStratumServer::onWrite, this, peer, boost::asio::placeholders::error)));
+}
+
+void MockStratumServer::onWrite(PeerPtr peer, const boost::system::error_code& ec)
+{
+    if (ec) {
+        drop(peer);
+        return;
+    }
+    peer->outbox.pop_front();
+    if (!peer->outbox.empty()) {
+        write(peer);
+    }
+}
+
+void MockStratumServer::drop(PeerPtr peer)
+{
+    boost::system::error_code ec;
+    peer->socket.shutdown(tcp::socket::shutdown_both, ec);
+    peer->socket.close(ec);
+    peer->outbox.clear();
+    m_peers.erase(peer);
+}
+
+void MockStratumServer::newJob()
+{
+    // A coinbase with the height and the miner's 8 extranonce bytes as its script,
+    // paying nothing to an empty key hash, the miner inserts the extranonce in between
+    const std::string coinbase1 = "01000000" "01" + std::string(64, '0') + "ffffffff" "0c" "03"
+        + hexLE(m_options.height, 3);
+    const std::string coinbase2 = "ffffffff" "01" + hexLE(0, 8) + "19" "76a914" + std::string(40, '0')
+        + "88ac" "00000000";
+
+    // Every mock pool is on the same chain, only the job names differ
+    std::stringstream prevHash;
+    prevHash << std::setw(64) << std::setfill('0') << std::hex << m_options.height;
+
+    m_job = Json::Value(Json::arrayValue);
+    m_job.append(hex32(m_port) + hex32(++m_jobId));
+    m_job.append(prevHash.str());
+    m_job.append(coinbase1);
+    m_job.append(coinbase2);
+    m_job.append(Json::Value(Json::arrayValue));
+    m_job.append("20000000");
+    m_job.append("1e0ffff0");
+    m_job.append(hex32(static_cast<uint32_t>(std::time(nullptr))));
+    m_job.append(true);
+    m_job.append(m_options.height);
+
+    m_jobTimer.expires_from_now(boost::posix_time::seconds(c_jobSeconds));
+    m_jobTimer.async_wait(m_io_strand.wrap(boost::bind(&MockStratumServer::onJobTimer, this, boost::asio::placeholders::error)));
+}
+
+std::vector<std::string> MockStratumServer::jobLines() const
+{
+    Json::FastWriter writer;
+    Json::Value difficulty;
+    difficulty["id"] = Json::Value::null;
+    difficulty["method"] = "mining.set_difficulty";
+    difficulty["params"] = Json::Value(Json::arrayValue);
+    difficulty["params"].append(m_options.difficulty);
+    Json::Value notify;
+    notify["id"] = Json::Value::null;
+    notify["method"] = "mining.notify";
+    notify["params"] = m_job;
+    return { writer.write(difficulty), writer.write(notify) };
+}
+
+void MockStratumServer::onJobTimer(const boost::system::error_code& ec)
+{
+    if (ec || !m_up) {
+        return;
+    }
+    newJob();
+    const auto lines = jobLines();
+    for (auto& peer : m_peers) {
+        if (peer->authorized) {
+            respond(peer, { lines[1] });
+        }
+    }
+}
+
+void MockStratumServer::onOutageTimer(const boost::system::error_code& ec)
+{
+    if (ec) {
+        return;
+    }
+    if (m_up) {
+        cnote << "Mock pool :" << m_port << " going down for " << m_options.outageSeconds << " s";
+        m_up = false;
+        boost::system::error_code ignored;
+        m_acceptor.close(ignored);
+        m_jobTimer.cancel();
+        auto peers = m_peers;
+        for (auto& peer : peers) {
+            drop(peer);
+        }
+        if (m_onOutage) {
+            m_onOutage(false);
+        }
+    } else if (listen()) {
+        cnote << "Mock pool :" << m_port << " is back";
+        newJob();
+        accept();
+        if (m_onOutage) {
+            m_onOutage(true);
+        }
+    }
+    m_outageTimer.expires_from_now(boost::posix_time::seconds(m_options.outageSeconds));
+    m_outageTimer.async_wait(m_io_strand.wrap(boost::bind(&MockStratumServer::onOutageTimer, this, boost::asio::placeholders::error)));
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <json/json.h>
+
+/**
+ * @brief Stratum pool stand-in on a loopback port, so failover and the pool
+ *        health scoring can be exercised on one machine. Speaks the
+ *        EnergiStratum dialect, gives every miner the same job with its own
+ *        extranonce, answers every request after a fixed latency and rejects
+ *        a fixed share of the solutions without checking them. With an outage
+ *        period the server drops its miners and refuses connections every
+ *        other period.
+ */
+class MockStratumServer
+{
+public:
+    struct Options
+    {
+        unsigned short port = 0;        // 0 picks a free port, see port()
+        unsigned latencyMs = 0;
+        unsigned rejectPercent = 0;
+        unsigned outageSeconds = 0;     // 0 keeps the server up
+        double   difficulty = 0.001;
+        uint32_t height = 1;
+    };
+
+    //! Told on the server's strand when an outage starts (false) and ends (true)
+    using Outage = std::function<void(bool up)>;
+
+    MockStratumServer(boost::asio::io_service& io_service, const Options& options);
+    MockStratumServer(MockStratumServer const&) = delete;
+    MockStratumServer& operator=(MockStratumServer const&) = delete;
+
+    //! Listens on 127.0.0.1, false if the port is taken
+    bool start();
+    void stop();
+    //! Port listened on once started
+    unsigned short port() const { return m_port; }
+
+    //! Set before start()
+    void onOutage(const Outage& handler) { m_onOutage = handler; }
+
+private:
+    struct Peer
+    {
+        explicit Peer(boost::asio::io_service& io_service) : socket(io_service) {}
+
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::streambuf       buffer;
+        std::deque<std::string>      outbox;
+        std::string                  extranonce;
+        bool                         authorized = false;
+    };
+    using PeerPtr = std::shared_ptr<Peer>;
+
+    bool listen();
+    void accept();
+    void onAccept(PeerPtr peer, const boost::system::error_code& ec);
+    void read(PeerPtr peer);
+    void onRead(PeerPtr peer, const boost::system::error_code& ec, std::size_t bytes);
+    void handle(PeerPtr peer, const Json::Value& request);
+    //! Sends the lines after the configured latency, in order
+    void respond(PeerPtr peer, std::vector<std::string> lines);
+    void send(PeerPtr peer, const std::string& line);
+    void write(PeerPtr peer);
+    void onWrite(PeerPtr peer, const boost::system::error_code& ec);
+    void drop(PeerPtr peer);
+
+    void newJob();
+    void onJobTimer(const boost::system::error_code& ec);
+    void onOutageTimer(const boost::system::error_code& ec);
+    std::vector<std::string> jobLines() const;
+
+    static std::string reply(const Json::Value& id, const Json::Value& result, const Json::Value& error);
+
+    /// A fresh job is announced this often
+    static const unsigned c_jobSeconds = 30;
+
+    const Options m_options;
+    boost::asio::io_service& m_io_service;
+    boost::asio::io_service::strand m_io_strand;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    boost::asio::deadline_timer m_jobTimer;
+    boost::asio::deadline_timer m_outageTimer;
+    unsigned short m_port = 0;
+    Outage m_onOutage;
+
+    std::set<PeerPtr> m_peers;
+    bool m_up = false;
+    uint32_t m_nextExtranonce = 0;
+    unsigned m_jobId = 0;
+    Json::Value m_job;                  // params of the current mining.notify
+    unsigned m_rejectCredit = 0;        // percent owed, a share is rejected for every hundred
+};
@@ -1,25 +1,52 @@
+#include <algorithm>
 #include <chrono>
+#include <ctime>
+#include <iomanip>
 
 #include "SimulateClient.h"
 
 using namespace energi;
 
-SimulateClient::SimulateClient(const unsigned* difficulty, const unsigned& block)
+const uint64_t SimulateClient::c_initialDifficulty;
+const uint64_t SimulateClient::c_maxDifficulty;
+const unsigned SimulateClient::c_maxRetargetFactor;
+const unsigned SimulateClient::c_reportSeconds;
+
+SimulateClient::SimulateClient(unsigned block, unsigned shareInterval)
     : PoolClient()
     , Worker("simulator")
-    , m_difficulty(difficulty - 1)
-    , m_block(block)
+    , m_block(std::max(1u, block))
+    , m_shareInterval(std::max(1u, shareInterval))
+    , m_rng(std::random_device{}())
 {
 }
 
 SimulateClient::~SimulateClient()
 {
+    stopWorking();
+}
+
+Work SimulateClient::makeWork(uint32_t height, uint64_t difficulty, std::mt19937_64& rng)
+{
+    Work work;
+    for (auto it = work.hashPrevBlock.begin(); it != work.hashPrevBlock.end(); ++it) {
+        *it = static_cast<uint8_t>(rng());
+    }
+    work.nVersion = 1;
+    work.nHeight = height;
+    work.nTime = static_cast<uint32_t>(std::time(nullptr));
+    work.setTarget(~arith_uint256(0) / arith_uint256(std::max<uint64_t>(1, difficulty)));
+    work.nBits = work.hashTarget.GetCompact();
+    return work;
 }
 
 void SimulateClient::connect()
 {
     m_connected.store(true, std::memory_order_relaxed);
-    m_uppDifficulty = false;
+    {
+        std::lock_guard<std::mutex> lock(x_work);
+        m_started = m_lastReport = m_windowStart = std::chrono::steady_clock::now();
+    }
 
     if (m_onConnected) {
         m_onConnected();
@@ -39,69 +66,114 @@ void SimulateClient::disconnect()
 void SimulateClient::submitHashrate(const std::string& rate)
 {
     (void)rate;
-
-    auto sec = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - m_time);
-    cnote << "On difficulty" << m_difficulty << " for " << sec.count() << " seconds";
 }
 
 void SimulateClient::submitSolution(const Solution& solution)
 {
-    m_uppDifficulty = true;
-    cnote << "Difficulty: " << m_difficulty;
+    auto const start = std::chrono::steady_clock::now();
+
+    // GetPOWHash overwrites the mix hash, compare against the one the miner sent
+    Work work = solution.getWork();
+    const uint256 mixHash = work.hashMix;
+    const uint256 hash = Miner::GetPOWHash(work);
+    const bool valid = work.meetsTarget(hash) && work.hashMix == mixHash;
+
+    auto const now = std::chrono::steady_clock::now();
+    auto const verifyMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - start);
+    auto const findToVerifyMs = std::chrono::duration_cast<std::chrono::milliseconds>(now - solution.getFoundTime());
+    bool stale = false;
+    {
+        std::lock_guard<std::mutex> lock(x_work);
+        stale = work.hashPrevBlock != m_current.hashPrevBlock;
+        if (!valid) {
+            ++m_rejected;
+        } else if (stale) {
+            ++m_stale;
+        } else {
+            ++m_accepted;
+            ++m_windowShares;
+        }
+        const uint64_t ms = static_cast<uint64_t>(std::max<std::chrono::milliseconds::rep>(0, findToVerifyMs.count()));
+        m_findToVerifyTotalMs += ms;
+        m_findToVerifyMaxMs = std::max(m_findToVerifyMaxMs, ms);
+    }
 
-    const auto& work = solution.getWork();
-    auto hash = Miner::GetPOWHash(work);
-    if(UintToArith256 <= work.hashTarget) {
+    if (valid) {
         if (m_onSolutionAccepted) {
-            m_onSolutionAccepted(false);
-        }
-    } else {
-        if (m_onSolutionRejected) {
-            m_onSolutionRejected(false);
+            m_onSolutionAccepted(stale, verifyMs, findToVerifyMs);
         }
+    } else if (m_onSolutionRejected) {
+        m_onSolutionRejected(stale, verifyMs, findToVerifyMs);
     }
 }
 
+void SimulateClient::issueWork()
+{
+    Work work;
+    uint64_t difficulty;
+    {
+        std::lock_guard<std::mutex> lock(x_work);
+        m_current = makeWork(m_block, m_difficulty, m_rng);
+        work = m_current;
+        difficulty = m_difficulty;
+    }
+    cnote << "Simulated work at block #" << m_block << ", difficulty " << difficulty;
+    if (m_onWorkReceived) {
+        m_onWorkReceived(work);
+    }
+}
+
+void SimulateClient::retarget(const std::chrono::steady_clock::time_point& now)
+{
+    std::unique_lock<std::mutex> lock(x_work);
+    const double window = std::chrono::duration<double>(now - m_windowStart).count();
+    // Enough shares for a rate, or a long quiet spell
+    if (m_windowShares < 8 && window < 4.0 * m_shareInterval) {
+        return;
+    }
+    const double expected = window / m_shareInterval;
+    double factor = m_windowShares ? m_windowShares / expected : 0.25;
+    factor = std::min<double>(c_maxRetargetFactor, std::max(1.0 / c_maxRetargetFactor, factor));
+    const double next = std::min<double>(c_maxDifficulty, std::max(1.0, m_difficulty * factor));
+    m_windowShares = 0;
+    m_windowStart = now;
+    // Small corrections are not worth restarting the miners
+    if (factor > 0.8 && factor < 1.25) {
+        return;
+    }
+    m_difficulty = static_cast<uint64_t>(next);
+    lock.unlock();
+    issueWork();
+}
+
+void SimulateClient::report(const std::chrono::steady_clock::time_point& now)
+{
+    std::lock_guard<std::mutex> lock(x_work);
+    if (now - m_lastReport < std::chrono::seconds(c_reportSeconds)) {
+        return;
+    }
+    m_lastReport = now;
+    const double minutes = std::chrono::duration<double>(now - m_started).count() / 60.0;
+    const uint64_t shares = m_accepted + m_stale;
+    const uint64_t total = shares + m_rejected;
+    cnote << "Simulation: " << std::fixed << std::setprecision(2)
+          << (minutes > 0 ? shares / minutes : 0.0) << " shares/min, "
+          << (total ? 100.0 * m_rejected / total : 0.0) << "% rejected, "
+          << m_stale << " stale, find to verify "
+          << (total ? m_findToVerifyTotalMs / total : 0) << "/" << m_findToVerifyMaxMs << " ms, difficulty "
+          << m_difficulty;
+}
+
 void SimulateClient::trun()
 {
-    cnote << "Preparing DAG for block #" << m_block;
-    BlockHeader genesis;
-    genesis.setNumber(m_block);
-    WorkPackage current = WorkPackage(genesis);
-    m_time = std::chrono::steady_clock::now();
-    while (true) {
+    cnote << "Simulating a pool at block #" << m_block << ", one share every " << m_shareInterval << " s";
+    issueWork();
+    while (!shouldStop()) {
         if (m_connected.load(std::memory_order_relaxed)) {
-            if (m_uppDifficulty) {
-                m_uppDifficulty = false;
-
-                auto sec = duration_cast<seconds>(steady_clock::now() - m_time);
-                cnote << "Took" << sec.count() << "seconds at" << m_difficulty
-                    << "difficulty to find solution";
-
-                if (sec.count() < 12) {
-                    ++m_difficulty;
-                }
-                if (sec.count() > 18) {
-                    --m_difficulty;
-                }
-
-                cnote << "Now using difficulty " << m_difficulty;
-                m_time = std::chrono::steady_clock::now();
-                if (m_onWorkReceived) {
-                    genesis.setDifficulty(u256(1) << m_difficulty);
-                    genesis.noteDirty();
-
-                    current.header = h256::random();
-                    current.boundary = genesis.boundary();
-
-                    m_onWorkReceived(current);
-                }
-            } else {
-                this_thread::sleep_for(chrono::milliseconds(100));
-            }
-        } else {
-            this_thread::sleep_for(chrono::seconds(5));
+            auto const now = std::chrono::steady_clock::now();
+            retarget(now);
+            report(now);
         }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 }
-
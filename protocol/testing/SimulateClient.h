@@ -1,14 +1,23 @@
 #pragma once
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <random>
 #include <primitives/worker.h>
 
 #include "../PoolClient.h"
 
+/**
+ * @brief Pool stand-in for offline throughput tests. Hands out locally made
+ *        work, verifies every solution with nrghash and retargets the share
+ *        difficulty so that shares arrive about every shareInterval seconds.
+ */
 class SimulateClient : public PoolClient, energi::Worker
 {
 public:
-    SimulateClient(const unsigned& difficulty, const unsigned& block);
+    SimulateClient(unsigned block, unsigned shareInterval);
     ~SimulateClient();
 
     void connect() override;
@@ -19,13 +28,41 @@ public:
     std::string ActiveEndPoint() override { return "";}
 
     void submitHashrate(const std::string& rate) override;
-	void submitSolution(const energi::Solution& solution) override;
+    void submitSolution(const energi::Solution& solution) override;
+
+    //! Work at height with a random previous block, a share needs about difficulty hashes
+    static energi::Work makeWork(uint32_t height, uint64_t difficulty, std::mt19937_64& rng);
 
 private:
     void trun() override;
-    bool m_uppDifficulty = false;
-    unsigned m_difficulty;
-    unsigned m_block;
-    std::chrono::steady_clock::time_point m_time;
+    void issueWork();
+    void retarget(const std::chrono::steady_clock::time_point& now);
+    void report(const std::chrono::steady_clock::time_point& now);
+
+    /// Starting difficulty, a few shares per second on a CPU
+    static const uint64_t c_initialDifficulty = 1ull << 20;
+    /// Keeps the upper 64 bits of the target non zero
+    static const uint64_t c_maxDifficulty = 1ull << 62;
+    /// Largest change of the difficulty at a single retarget
+    static const unsigned c_maxRetargetFactor = 16;
+    static const unsigned c_reportSeconds = 60;
+
+    const uint32_t m_block;
+    const unsigned m_shareInterval;
+    std::mt19937_64 m_rng;
+
+    std::mutex        x_work;
+    energi::Work      m_current;
+    uint64_t          m_difficulty = c_initialDifficulty;
+    unsigned          m_windowShares = 0;   // shares since the last retarget
+    std::chrono::steady_clock::time_point m_windowStart;
 
+    // Totals of the run, reported every c_reportSeconds
+    std::chrono::steady_clock::time_point m_started;
+    std::chrono::steady_clock::time_point m_lastReport;
+    uint64_t m_accepted = 0;
+    uint64_t m_stale = 0;
+    uint64_t m_rejected = 0;
+    uint64_t m_findToVerifyTotalMs = 0;
+    uint64_t m_findToVerifyMaxMs = 0;
 };